@@ -1,13 +1,49 @@
+// Calls such as clock_gettime are left out by strict C modes unless asked for before the first header
+#if defined(SWGL_THREADS) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "swgl.h"
 
 #include <memory.h> // Comment this line out for freestanding, you'll have to include your header files though that should allow malloc, memcpy, memset, and free.
 
+#ifdef SWGL_THREADS
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#ifdef __linux__
+#include <stdio.h> // Reading NUMA node CPU lists
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h> // Used by the multisample resolve and the vertex fetch, which have scalar fallbacks
+#endif
+
 /*
 * HELPER CONSTANTS
 */
 
 #define SWGL_BIGNUM 0x7FFFFFFF
 
+#ifdef _MSC_VER
+#define SWGL_THREAD_LOCAL __declspec(thread)
+#else
+#define SWGL_THREAD_LOCAL _Thread_local
+#endif
+
+// Define SWGL_THREADS to render on a pool of SWGL_THREAD_COUNT threads by default, counting the caller
+#ifdef SWGL_THREADS
+#ifndef SWGL_THREAD_COUNT
+#define SWGL_THREAD_COUNT 4
+#endif
+#else
+#undef SWGL_THREAD_COUNT
+#define SWGL_THREAD_COUNT 1
+#endif
+
 /*
 * HELPER FUNCS AND STRUCTS
 */
@@ -106,6 +142,17 @@ float swgl_tan(float x)
 	return swgl_sin(x) / swgl_cos(x);
 }
 
+float swgl_log2(float x)
+{
+	union { float f; uint32_t i; } Bits = { x };
+
+	// Exponent plus a quadratic fit of log2 over the [1, 2) mantissa, good to about 0.005
+	float Exponent = (float)(int)((Bits.i >> 23) & 0xFF) - 128.0f;
+	Bits.i = (Bits.i & 0x007FFFFF) | 0x3F800000;
+
+	return Exponent + (-0.34484843f * Bits.f + 2.02466578f) * Bits.f - 0.67487759f;
+}
+
 typedef struct
 {
 	void* Data;
@@ -302,6 +349,9 @@ typedef enum
 	GLSL_TOK_TAN,
 	GLSL_TOK_MIN,
 	GLSL_TOK_MAX,
+	GLSL_TOK_DFDX,
+	GLSL_TOK_DFDY,
+	GLSL_TOK_FWIDTH,
 
 	GLSL_TOK_FLOAT_CONSTRUCT,
 	GLSL_TOK_VEC2_CONSTRUCT,
@@ -407,12 +457,6 @@ typedef struct
 	int Location;
 } glslLayout;
 
-typedef struct
-{
-	void* Data;
-	uint8_t Alloc;
-} glslValue;
-
 typedef struct _glslVariable
 {
 	_SwglString* Name;
@@ -426,274 +470,109 @@ typedef struct _glslVariable
 
 	glslLayout* Layout;
 
-	glslValue Value;
+	// Byte offset of the value, into the program's uniform block for uniforms and into the invocation's frame otherwise
+	int Slot;
 } glslVariable;
 
-typedef struct
-{
-	glslExValue first;
-	glslVariable* second;
-} _ExVarPair;
-
 typedef struct
 {
 	glslVariable* first;
 	glslVariable* second;
 } _VarPair;
 
-uint8_t GLSLIsDigit(char c)
-{
-	return (c >= '0' && c <= '9') || c == '-';
-}
-
+// Everything one invocation of a shader writes. Programs are immutable after linking, so any number of
+// contexts can run the same program at once, each on one thread at a time
 typedef struct
 {
-	glslVec4 Verts[3];
-	_SwglVector TriangleVertexData[3];
-} Triangle;
-
-glslVec4 IntersectNearPlane(glslVec4 a, glslVec4 b, float* t)
-{
-	*t = (a.z + a.w) / (a.w - b.w + a.z - b.z);
-
-	glslVec4 result;
-	result.x = a.x + *t * (b.x - a.x);
-	result.y = a.y + *t * (b.y - a.y);
-	result.z = a.z + *t * (b.z - a.z);
-	result.w = a.w + *t * (b.w - a.w);
+	uint8_t* Frame; // Every non-uniform variable, at its Slot
+	uint8_t* Uniforms; // The shader's part of the program's uniform block, shared and only read while shading
 
-	return result;
-}
+	// Results of the texture and derivative tokens by QuadIndex while the context is a lane of ExecuteGLSLQuad, otherwise 0
+	glslExValue* QuadResults;
+} glslContext;
 
-glslExValue InterpolateExValue(glslExValue Val0, glslExValue Val1, float t)
+void* GLSLVarData(glslContext* Context, glslVariable* Var)
 {
-	glslExValue Out;
-	if (Val0.Type == GLSL_FLOAT)
-	{
-		glslExValue Val = { GLSL_FLOAT, Val0.x + t * (Val1.x - Val0.x) };
-		Out = Val;
-	}
-	else if (Val0.Type == GLSL_VEC2)
-	{
-		glslExValue Val = { GLSL_VEC2, Val0.x + t * (Val1.x - Val0.x), Val0.y + t * (Val1.y - Val0.y) };
-		Out = Val;
-	}
-	else if (Val0.Type == GLSL_VEC3)
-	{
-		glslExValue Val = { GLSL_VEC3, Val0.x + t * (Val1.x - Val0.x), Val0.y + t * (Val1.y - Val0.y), Val0.z + t * (Val1.z - Val0.z) };
-		Out = Val;
-	}
-	else if (Val0.Type == GLSL_VEC4)
-	{
-		glslExValue Val = { GLSL_VEC4, Val0.x + t * (Val1.x - Val0.x), Val0.y + t * (Val1.y - Val0.y), Val0.z + t * (Val1.z - Val0.z), Val0.w + t * (Val1.w - Val0.w) };
-		Out = Val;
-	}
-	else if (Val0.Type == GLSL_INT)
-	{
-		glslExValue Val = { GLSL_INT, 0.0f, 0.0f, 0.0f, 0.0f, (int)(Val0.i + t * (Val1.i - Val0.i)) };
-		Out = Val;
-	}
-	return Out;
+	return (Var->isUniform ? Context->Uniforms : Context->Frame) + Var->Slot;
 }
 
-int ClipTriangleAgainstNearPlane(Triangle* tri, Triangle* outTri)
+uint8_t GLSLIsDigit(char c)
 {
+	return (c >= '0' && c <= '9') || c == '-';
+}
 
-	for (int i = 0; i < 3; i++)
-	{
-		outTri[0].Verts[i] = tri->Verts[i];
-		outTri[1].Verts[i] = tri->Verts[i];
-		outTri[0].TriangleVertexData[i] = swglNewVector(sizeof(_ExVarPair));
-		outTri[1].TriangleVertexData[i] = swglNewVector(sizeof(_ExVarPair));
-		for (int j = 0; j < tri->TriangleVertexData[i].Size; j++)
-		{
-			_ExVarPair Pair;
-
-			swglVectorRead(&tri->TriangleVertexData[i], &Pair, j);
-
-			swglVectorPushBack(&outTri[0].TriangleVertexData[i], &Pair);
-			swglVectorPushBack(&outTri[1].TriangleVertexData[i], &Pair);
-		}
-	}
-
-	glslVec4* InsidePoints[3];  int nInsidePointCount = 0;
-	_SwglVector InExValues[3];
-	glslVec4* OutsidePoints[3]; int nOutsidePointCount = 0;
-	_SwglVector OutExValues[3];
-
-	InExValues[0] = swglNewVector(sizeof(_ExVarPair));
-	InExValues[1] = swglNewVector(sizeof(_ExVarPair));
-	InExValues[2] = swglNewVector(sizeof(_ExVarPair));
-
-	OutExValues[0] = swglNewVector(sizeof(_ExVarPair));
-	OutExValues[1] = swglNewVector(sizeof(_ExVarPair));
-	OutExValues[2] = swglNewVector(sizeof(_ExVarPair));
-
-	if (tri->Verts[0].z >= -tri->Verts[0].w)
-	{
-		swglVectorCopy(&InExValues[nInsidePointCount], &tri->TriangleVertexData[0]);
-		InsidePoints[nInsidePointCount++] = &tri->Verts[0];
-	}
-	else
-	{
-		swglVectorCopy(&OutExValues[nOutsidePointCount], &tri->TriangleVertexData[0]);
-		OutsidePoints[nOutsidePointCount++] = &tri->Verts[0];
-	}
-	if (tri->Verts[1].z >= -tri->Verts[1].w)
-	{
-		swglVectorCopy(&InExValues[nInsidePointCount], &tri->TriangleVertexData[1]);
-		InsidePoints[nInsidePointCount++] = &tri->Verts[1];
-	}
-	else
-	{
-		swglVectorCopy(&OutExValues[nOutsidePointCount], &tri->TriangleVertexData[1]);
-		OutsidePoints[nOutsidePointCount++] = &tri->Verts[1];
-	}
-	if (tri->Verts[2].z >= -tri->Verts[2].w)
-	{
-		swglVectorCopy(&InExValues[nInsidePointCount], &tri->TriangleVertexData[2]);
-		InsidePoints[nInsidePointCount++] = &tri->Verts[2];
-	}
-	else
-	{
-		swglVectorCopy(&OutExValues[nOutsidePointCount], &tri->TriangleVertexData[2]);
-		OutsidePoints[nOutsidePointCount++] = &tri->Verts[2];
-	}
-
-	if (nInsidePointCount == 0)
-	{
-		swglVectorFree(&InExValues[0]);
-		swglVectorFree(&InExValues[1]);
-		swglVectorFree(&InExValues[2]);
-
-		swglVectorFree(&OutExValues[0]);
-		swglVectorFree(&OutExValues[1]);
-		swglVectorFree(&OutExValues[2]);
-
-		swglVectorFree(&outTri[0].TriangleVertexData[0]);
-		swglVectorFree(&outTri[0].TriangleVertexData[1]);
-		swglVectorFree(&outTri[0].TriangleVertexData[2]);
-
-		swglVectorFree(&outTri[1].TriangleVertexData[0]);
-		swglVectorFree(&outTri[1].TriangleVertexData[1]);
-		swglVectorFree(&outTri[1].TriangleVertexData[2]);
-
-		return 0;
-	}
-
-	if (nInsidePointCount == 3)
-	{
-		swglVectorFree(&outTri[0].TriangleVertexData[0]);
-		swglVectorFree(&outTri[0].TriangleVertexData[1]);
-		swglVectorFree(&outTri[0].TriangleVertexData[2]);
-
-		swglVectorFree(&outTri[1].TriangleVertexData[0]);
-		swglVectorFree(&outTri[1].TriangleVertexData[1]);
-		swglVectorFree(&outTri[1].TriangleVertexData[2]);
-
-		outTri[0] = *tri;
-
-		swglVectorFree(&InExValues[0]);
-		swglVectorFree(&InExValues[1]);
-		swglVectorFree(&InExValues[2]);
-
-		swglVectorFree(&OutExValues[0]);
-		swglVectorFree(&OutExValues[1]);
-		swglVectorFree(&OutExValues[2]);
-
-
-
-		return 1;
-	}
-
-	if (nInsidePointCount == 1 && nOutsidePointCount == 2)
-	{
-		outTri[0].Verts[0] = *InsidePoints[0];
-		swglVectorCopy(&outTri[0].TriangleVertexData[0], &InExValues[0]);
-
-		float t;
-		outTri[0].Verts[1] = IntersectNearPlane(*InsidePoints[0], *OutsidePoints[0], &t);
-		for (int i = 0; i < tri->TriangleVertexData[1].Size; i++)
-		{
-			_ExVarPair Pair0, Pair1;
-			swglVectorRead(&InExValues[0], &Pair0, i);
-			swglVectorRead(&OutExValues[0], &Pair1, i);
-			glslExValue FirstExVal, SecondExVal;
-			Pair0.first = InterpolateExValue(Pair0.first, Pair1.first, t);
-			swglVectorWrite(&outTri[0].TriangleVertexData[1], &Pair0, i);
-		}
-
-		outTri[0].Verts[2] = IntersectNearPlane(*InsidePoints[0], *OutsidePoints[1], &t);
-		for (int i = 0; i < tri->TriangleVertexData[2].Size; i++)
-		{
-			_ExVarPair Pair0, Pair1;
-			swglVectorRead(&InExValues[0], &Pair0, i);
-			swglVectorRead(&OutExValues[1], &Pair1, i);
-			glslExValue FirstExVal, SecondExVal;
-			Pair0.first = InterpolateExValue(Pair0.first, Pair1.first, t);
-			swglVectorWrite(&outTri[0].TriangleVertexData[2], &Pair0, i);
-		}
+/*
+* Clip codes, one bit per plane a clip-space vertex lies outside of.
+* Triangles fully outside a frustum plane are rejected, triangles that
+* only leave the viewport are rasterized as is, and geometric clipping
+* is only done against near, far and the guard band.
+*/
 
-		swglVectorFree(&InExValues[0]);
-		swglVectorFree(&InExValues[1]);
-		swglVectorFree(&InExValues[2]);
+#define SWGL_CLIP_LEFT 0x001
+#define SWGL_CLIP_RIGHT 0x002
+#define SWGL_CLIP_BOTTOM 0x004
+#define SWGL_CLIP_TOP 0x008
+#define SWGL_CLIP_NEAR 0x010
+#define SWGL_CLIP_FAR 0x020
 
-		swglVectorFree(&OutExValues[0]);
-		swglVectorFree(&OutExValues[1]);
-		swglVectorFree(&OutExValues[2]);
+#define SWGL_CLIP_GUARD_LEFT 0x040
+#define SWGL_CLIP_GUARD_RIGHT 0x080
+#define SWGL_CLIP_GUARD_BOTTOM 0x100
+#define SWGL_CLIP_GUARD_TOP 0x200
 
-		swglVectorFree(&outTri[1].TriangleVertexData[0]);
-		swglVectorFree(&outTri[1].TriangleVertexData[1]);
-		swglVectorFree(&outTri[1].TriangleVertexData[2]);
+#define SWGL_CLIP_FRUSTUM (SWGL_CLIP_LEFT | SWGL_CLIP_RIGHT | SWGL_CLIP_BOTTOM | SWGL_CLIP_TOP | SWGL_CLIP_NEAR | SWGL_CLIP_FAR)
+#define SWGL_CLIP_GEOMETRIC (SWGL_CLIP_NEAR | SWGL_CLIP_FAR | SWGL_CLIP_GUARD_LEFT | SWGL_CLIP_GUARD_RIGHT | SWGL_CLIP_GUARD_BOTTOM | SWGL_CLIP_GUARD_TOP)
 
+// Guard band extent in NDC units, so 8.0 allows vertices up to 8 viewport half-widths off center
+#define SWGL_GUARD_BAND 8.0f
 
-		return 1;
-	}
+// 3 input vertices plus at most one more per clipped plane
+#define SWGL_MAX_CLIP_VERTS 9
 
-	if (nInsidePointCount == 2 && nOutsidePointCount == 1)
-	{
-		outTri[0].Verts[0] = *InsidePoints[0];
-		swglVectorCopy(&outTri[0].TriangleVertexData[0], &InExValues[0]);
-		outTri[0].Verts[1] = *InsidePoints[1];
-		swglVectorCopy(&outTri[0].TriangleVertexData[1], &InExValues[1]);
+uint32_t ComputeClipCode(glslVec4 v)
+{
+	uint32_t Code = 0;
+	float GuardW = SWGL_GUARD_BAND * v.w;
 
-		float t;
-		outTri[0].Verts[2] = IntersectNearPlane(*InsidePoints[0], *OutsidePoints[0], &t);
-		for (int i = 0; i < tri->TriangleVertexData[2].Size; i++)
-		{
-			_ExVarPair Pair0, Pair1;
-			swglVectorRead(&InExValues[0], &Pair0, i);
-			swglVectorRead(&OutExValues[0], &Pair1, i);
-			glslExValue FirstExVal, SecondExVal;
-			Pair0.first = InterpolateExValue(Pair0.first, Pair1.first, t);
-			swglVectorWrite(&outTri[0].TriangleVertexData[2], &Pair0, i);
-		}
+	if (v.x < -v.w) Code |= SWGL_CLIP_LEFT;
+	if (v.x > v.w) Code |= SWGL_CLIP_RIGHT;
+	if (v.y < -v.w) Code |= SWGL_CLIP_BOTTOM;
+	if (v.y > v.w) Code |= SWGL_CLIP_TOP;
+	if (v.z < -v.w) Code |= SWGL_CLIP_NEAR;
+	if (v.z > v.w) Code |= SWGL_CLIP_FAR;
 
-		outTri[1].Verts[0] = *InsidePoints[1];
-		swglVectorCopy(&outTri[1].TriangleVertexData[0], &InExValues[1]);
-		outTri[1].Verts[1] = outTri[0].Verts[2];
-		swglVectorCopy(&outTri[1].TriangleVertexData[1], &outTri[0].TriangleVertexData[2]);
-		outTri[1].Verts[2] = IntersectNearPlane(*InsidePoints[1], *OutsidePoints[0], &t);
-		for (int i = 0; i < tri->TriangleVertexData[2].Size; i++)
-		{
-			_ExVarPair Pair0, Pair1;
-			swglVectorRead(&InExValues[1], &Pair0, i);
-			swglVectorRead(&OutExValues[0], &Pair1, i);
-			glslExValue FirstExVal, SecondExVal;
-			Pair0.first = InterpolateExValue(Pair0.first, Pair1.first, t);
-			swglVectorWrite(&outTri[1].TriangleVertexData[2], &Pair0, i);
-		}
+	if (v.x < -GuardW) Code |= SWGL_CLIP_GUARD_LEFT;
+	if (v.x > GuardW) Code |= SWGL_CLIP_GUARD_RIGHT;
+	if (v.y < -GuardW) Code |= SWGL_CLIP_GUARD_BOTTOM;
+	if (v.y > GuardW) Code |= SWGL_CLIP_GUARD_TOP;
 
-		swglVectorFree(&InExValues[0]);
-		swglVectorFree(&InExValues[1]);
-		swglVectorFree(&InExValues[2]);
+	return Code;
+}
 
-		swglVectorFree(&OutExValues[0]);
-		swglVectorFree(&OutExValues[1]);
-		swglVectorFree(&OutExValues[2]);
+// Signed distance to a clip plane, inside when >= 0
+float ClipPlaneDistance(glslVec4 v, uint32_t Plane)
+{
+	if (Plane == SWGL_CLIP_LEFT) return v.x + v.w;
+	if (Plane == SWGL_CLIP_RIGHT) return v.w - v.x;
+	if (Plane == SWGL_CLIP_BOTTOM) return v.y + v.w;
+	if (Plane == SWGL_CLIP_TOP) return v.w - v.y;
+	if (Plane == SWGL_CLIP_NEAR) return v.z + v.w;
+	if (Plane == SWGL_CLIP_FAR) return v.w - v.z;
+	if (Plane == SWGL_CLIP_GUARD_LEFT) return v.x + SWGL_GUARD_BAND * v.w;
+	if (Plane == SWGL_CLIP_GUARD_RIGHT) return SWGL_GUARD_BAND * v.w - v.x;
+	if (Plane == SWGL_CLIP_GUARD_BOTTOM) return v.y + SWGL_GUARD_BAND * v.w;
+	if (Plane == SWGL_CLIP_GUARD_TOP) return SWGL_GUARD_BAND * v.w - v.y;
+	return 0.0f;
+}
 
-		return 2;
-	}
+glslVec4 InterpolateVec4(glslVec4 a, glslVec4 b, float t)
+{
+	glslVec4 result;
+	result.x = a.x + t * (b.x - a.x);
+	result.y = a.y + t * (b.y - a.y);
+	result.z = a.z + t * (b.z - a.z);
+	result.w = a.w + t * (b.w - a.w);
+	return result;
 }
 
 glslMat4 MatMulMat4(glslMat4* a, glslMat4* b)
@@ -818,6 +697,10 @@ typedef struct _glslToken
 	_SwglVector Swizzle;
 
 	_SwglVector Args;
+
+	// Texture and derivative tokens are evaluated for all four lanes of a 2x2 quad up front,
+	// while a line executes each lane then reads its own result from its context at this index
+	int QuadIndex;
 } glslToken;
 
 typedef struct _glslScope
@@ -825,6 +708,10 @@ typedef struct _glslScope
 	_SwglVector Variables;
 	struct _glslScope* ParentScope;
 	_SwglVector Lines;
+
+	// One _SwglVector of glslToken* per line, the quad tokens of that line with inner tokens first
+	_SwglVector LineQuadTokens;
+	uint8_t UsesQuadTokens;
 } glslScope;
 
 typedef struct
@@ -840,6 +727,11 @@ typedef struct
 {
 	_SwglVector Funcs;
 	_SwglVector GlobalVars;
+
+	int FrameSize;
+	int UniformSize;
+	int QuadTokenCount;
+	uint8_t UsesQuadTokens;
 } glslTokenized;
 
 typedef struct
@@ -847,6 +739,7 @@ typedef struct
 	int At;
 	_SwglString* Code;
 	_SwglVector GlobalVars;
+	int QuadTokenCount;
 } glslTokenizer;
 
 int GLSLTellNext(glslTokenizer* Tokenizer, char c)
@@ -1204,7 +1097,8 @@ glslToken* GLSLTokenizeSubExpr(glslTokenizer* Tokenizer, glslScope* Scope, int E
 		Tokenizer->At = EndAt + 1;
 		return OutTok;
 	}
-	if (swglStringEquals(ParenStr, "texture") || swglStringEquals(ParenStr, "cos") || swglStringEquals(ParenStr, "sin") || swglStringEquals(ParenStr, "tan") || swglStringEquals(ParenStr, "min") || swglStringEquals(ParenStr, "max"))
+	if (swglStringEquals(ParenStr, "texture") || swglStringEquals(ParenStr, "cos") || swglStringEquals(ParenStr, "sin") || swglStringEquals(ParenStr, "tan") || swglStringEquals(ParenStr, "min") || swglStringEquals(ParenStr, "max") ||
+		swglStringEquals(ParenStr, "dFdx") || swglStringEquals(ParenStr, "dFdy") || swglStringEquals(ParenStr, "fwidth"))
 	{
 		Tokenizer->At = NextBeginParen;
 
@@ -1219,6 +1113,9 @@ glslToken* GLSLTokenizeSubExpr(glslTokenizer* Tokenizer, glslScope* Scope, int E
 		if (swglStringEquals(ParenStr, "tan")) OutTok->Type = GLSL_TOK_TAN;
 		if (swglStringEquals(ParenStr, "min")) OutTok->Type = GLSL_TOK_MIN;
 		if (swglStringEquals(ParenStr, "max")) OutTok->Type = GLSL_TOK_MAX;
+		if (swglStringEquals(ParenStr, "dFdx")) OutTok->Type = GLSL_TOK_DFDX;
+		if (swglStringEquals(ParenStr, "dFdy")) OutTok->Type = GLSL_TOK_DFDY;
+		if (swglStringEquals(ParenStr, "fwidth")) OutTok->Type = GLSL_TOK_FWIDTH;
 		if (Swizzle != -1)
 		{
 			glslToken* SwizzleTok = (glslToken*)malloc(sizeof(glslToken));
@@ -1319,7 +1216,6 @@ glslToken* GLSLTokenizeSubExpr(glslTokenizer* Tokenizer, glslScope* Scope, int E
 
 			VarTok->Type = GLSL_TOK_VAR;
 			VarTok->Var = ProbeVar;
-			ProbeVar->Value.Alloc = 0;
 
 			if (Swizzle != -1)
 			{
@@ -1469,7 +1365,7 @@ glslToken* GLSLTokenizeLine(glslTokenizer* Tokenizer, glslScope* Scope)
 	DeclVar->isLayout = 0;
 	DeclVar->isUniform = 0;
 
-	DeclVar->Value.Alloc = 0;
+	DeclVar->Slot = 0;
 
 	swglVectorPushBack(&Scope->Variables, &DeclVar);
 
@@ -1487,6 +1383,43 @@ glslToken* GLSLTokenizeLine(glslTokenizer* Tokenizer, glslScope* Scope)
 	return OutToken;
 }
 
+uint8_t GLSLIsQuadToken(glslToken* Token)
+{
+	return Token->Type == GLSL_TOK_TEXTURE || Token->Type == GLSL_TOK_DFDX || Token->Type == GLSL_TOK_DFDY || Token->Type == GLSL_TOK_FWIDTH;
+}
+
+// Post-order, so a quad token nested in the arguments of another one is resolved first
+void GLSLCollectQuadTokens(glslToken* Token, _SwglVector* Out)
+{
+	if (!Token) return;
+
+	if (Token->Type == GLSL_TOK_ADD || Token->Type == GLSL_TOK_SUB || Token->Type == GLSL_TOK_MUL || Token->Type == GLSL_TOK_DIV ||
+		Token->Type == GLSL_TOK_LT || Token->Type == GLSL_TOK_GT || Token->Type == GLSL_TOK_EQ || Token->Type == GLSL_TOK_ASSIGN)
+	{
+		GLSLCollectQuadTokens(Token->First, Out);
+		GLSLCollectQuadTokens(Token->Second, Out);
+	}
+	else if (Token->Type == GLSL_TOK_VAR_DECL)
+	{
+		GLSLCollectQuadTokens(Token->Second, Out);
+	}
+	else if (Token->Type == GLSL_TOK_SWIZZLE)
+	{
+		GLSLCollectQuadTokens(Token->First, Out);
+	}
+	else if (Token->Type != GLSL_TOK_VAR && Token->Type != GLSL_TOK_CONST)
+	{
+		for (int i = 0; i < Token->Args.Size; i++)
+		{
+			glslToken* Arg;
+			swglVectorRead(&Token->Args, &Arg, i);
+			GLSLCollectQuadTokens(Arg, Out);
+		}
+	}
+
+	if (GLSLIsQuadToken(Token)) swglVectorPushBack(Out, &Token);
+}
+
 glslFunction* GLSLTokenizeFunction(glslTokenizer* Tokenizer)
 {
 	while (swglStringGet(Tokenizer->Code, Tokenizer->At) == ' ') Tokenizer->At++;
@@ -1542,7 +1475,7 @@ glslFunction* GLSLTokenizeFunction(glslTokenizer* Tokenizer)
 		Param->isOut = 0;
 		Param->isLayout = 0;
 		Param->isUniform = 0;
-		Param->Value.Alloc = 0;
+		Param->Slot = 0;
 		swglVectorPushBack(&MyFunc->RootScope->Variables, &Param);
 		MyFunc->ParamCount++;
 
@@ -1568,6 +1501,26 @@ glslFunction* GLSLTokenizeFunction(glslTokenizer* Tokenizer)
 		swglVectorPushBack(&MyFunc->RootScope->Lines, &LineTok);
 	}
 
+	MyFunc->RootScope->LineQuadTokens = swglNewVector(sizeof(_SwglVector));
+	MyFunc->RootScope->UsesQuadTokens = 0;
+
+	for (int i = 0; i < MyFunc->RootScope->Lines.Size; i++)
+	{
+		glslToken* LineTok;
+		swglVectorRead(&MyFunc->RootScope->Lines, &LineTok, i);
+
+		_SwglVector QuadTokens = swglNewVector(sizeof(glslToken*));
+		GLSLCollectQuadTokens(LineTok, &QuadTokens);
+		if (QuadTokens.Size > 0) MyFunc->RootScope->UsesQuadTokens = 1;
+
+		for (int j = 0; j < QuadTokens.Size; j++)
+		{
+			((glslToken**)QuadTokens.Data)[j]->QuadIndex = Tokenizer->QuadTokenCount++;
+		}
+
+		swglVectorPushBack(&MyFunc->RootScope->LineQuadTokens, &QuadTokens);
+	}
+
 	Tokenizer->At = NextCodeBlockEnd + 1;
 
 	while (swglStringGet(Tokenizer->Code, Tokenizer->At) == ' ') Tokenizer->At++;
@@ -1609,7 +1562,7 @@ void GLSLTokenizeUniform(glslTokenizer* Tokenizer)
 	Uniform->isOut = 0;
 	Uniform->isLayout = 0;
 
-	Uniform->Value.Alloc = 0;
+	Uniform->Slot = 0;
 
 	Uniform->isUniform = 1;
 
@@ -1644,7 +1597,7 @@ void GLSLTokenizeOut(glslTokenizer* Tokenizer)
 
 	_SwglString* OutName = GLSLTellStringUntilNWS(Tokenizer, NextSemi);
 
-	glslVariable* Out = (glslVariable*)malloc(sizeof(glslVariable*));
+	glslVariable* Out = (glslVariable*)malloc(sizeof(glslVariable));
 
 	Out->Type = OutType;
 	Out->Name = OutName;
@@ -1653,7 +1606,7 @@ void GLSLTokenizeOut(glslTokenizer* Tokenizer)
 	Out->isLayout = 0;
 	Out->isUniform = 0;
 
-	Out->Value.Alloc = 0;
+	Out->Slot = 0;
 
 	Out->isOut = 1;
 
@@ -1697,7 +1650,7 @@ void GLSLTokenizeIn(glslTokenizer* Tokenizer)
 	In->isLayout = 0;
 	In->isUniform = 0;
 
-	In->Value.Alloc = 0;
+	In->Slot = 0;
 
 	In->isIn = 1;
 
@@ -1779,7 +1732,7 @@ void GLSLTokenizeLayout(glslTokenizer* Tokenizer)
 	Variable->isLayout = 1;
 	Variable->Layout = (glslLayout*)malloc(sizeof(glslLayout));
 	Variable->Layout->Location = ParamVal;
-	Variable->Value.Alloc = 0;
+	Variable->Slot = 0;
 	swglVectorPushBack(&Tokenizer->GlobalVars, &Variable);
 
 	Tokenizer->At = NextSemi + 1;
@@ -1826,6 +1779,41 @@ glslFunction* GLSLDispatchTokenize(glslTokenizer* Tokenizer)
 	return GLSLTokenizeFunction(Tokenizer);
 }
 
+int GLSLTypeSize(glslType Type)
+{
+	if (Type == GLSL_FLOAT) return sizeof(float);
+	if (Type == GLSL_VEC2) return sizeof(float) * 2;
+	if (Type == GLSL_VEC3) return sizeof(float) * 3;
+	if (Type == GLSL_VEC4) return sizeof(float) * 4;
+	if (Type == GLSL_INT || Type == GLSL_SAMPLER2D) return sizeof(int);
+	if (Type == GLSL_MAT2) return sizeof(float) * 4;
+	if (Type == GLSL_MAT3) return sizeof(float) * 9;
+	if (Type == GLSL_MAT4) return sizeof(float) * 16;
+	return 0;
+}
+
+void GLSLAssignSlot(glslVariable* Var, glslTokenized* Tokenized)
+{
+	int* Size = Var->isUniform ? &Tokenized->UniformSize : &Tokenized->FrameSize;
+	Var->Slot = *Size;
+	*Size += GLSLTypeSize(Var->Type);
+}
+
+glslVariable* NewBuiltinVariable(const char* Name, glslType Type)
+{
+	glslVariable* Var = (glslVariable*)malloc(sizeof(glslVariable));
+	Var->Name = swglCString2String(Name);
+	Var->Type = Type;
+	Var->isIn = 0;
+	Var->isOut = 0;
+	Var->isLayout = 0;
+	Var->isUniform = 0;
+
+	Var->Slot = 0;
+
+	return Var;
+}
+
 glslTokenized GLSLTokenize(_SwglString* ToTokenize)
 {
 	glslTokenizer* Tokenizer = (glslTokenizer*)malloc(sizeof(glslTokenizer));
@@ -1833,6 +1821,7 @@ glslTokenized GLSLTokenize(_SwglString* ToTokenize)
 	Tokenizer->At = 0;
 	Tokenizer->Code = swglNewString();
 	Tokenizer->GlobalVars = swglNewVector(sizeof(glslVariable*));
+	Tokenizer->QuadTokenCount = 0;
 
 	_SwglVector OutFuncs = swglNewVector(sizeof(glslFunction*));
 
@@ -1841,17 +1830,11 @@ glslTokenized GLSLTokenize(_SwglString* ToTokenize)
 		char CurChar = swglStringGet(ToTokenize, i);
 		if (CurChar != '\n' && CurChar != '\t') swglStringPush(Tokenizer->Code, CurChar);
 	}
-	glslVariable* PositionVariable = (glslVariable*)malloc(sizeof(glslVariable));
-	PositionVariable->Name = swglCString2String("gl_Position");
-	PositionVariable->Type = GLSL_VEC4;
-	PositionVariable->isIn = 0;
-	PositionVariable->isOut = 0;
-	PositionVariable->isLayout = 0;
-	PositionVariable->isUniform = 0;
-
-	PositionVariable->Value.Alloc = 0;
+	glslVariable* PositionVariable = NewBuiltinVariable("gl_Position", GLSL_VEC4);
+	glslVariable* InstanceIDVariable = NewBuiltinVariable("gl_InstanceID", GLSL_INT);
 
 	swglVectorPushBack(&Tokenizer->GlobalVars, &PositionVariable);
+	swglVectorPushBack(&Tokenizer->GlobalVars, &InstanceIDVariable);
 
 	while (Tokenizer->At < Tokenizer->Code->Size - 2)
 	{
@@ -1862,155 +1845,51 @@ glslTokenized GLSLTokenize(_SwglString* ToTokenize)
 	glslTokenized OutputTokenized;
 	OutputTokenized.Funcs = OutFuncs;
 	OutputTokenized.GlobalVars = Tokenizer->GlobalVars;
+	OutputTokenized.FrameSize = 0;
+	OutputTokenized.UniformSize = 0;
+	OutputTokenized.QuadTokenCount = Tokenizer->QuadTokenCount;
+	OutputTokenized.UsesQuadTokens = 0;
 
-	return OutputTokenized;
-}
-
-typedef struct
-{
-	GLenum Type;
-
-	_SwglString* MyCode;
-	uint8_t Compiled;
-	glslTokenized CompiledData;
-} RawShader;
-
-_SwglVector GlobalShaders;
-
-void VerifyVar(glslVariable* Var)
-{
-	if (Var->Value.Alloc == 1) return;
-	if (Var->Type == GLSL_FLOAT) Var->Value.Data = malloc(sizeof(float));
-	else if (Var->Type == GLSL_VEC2) Var->Value.Data = malloc(sizeof(float) * 2);
-	else if (Var->Type == GLSL_VEC3) Var->Value.Data = malloc(sizeof(float) * 3);
-	else if (Var->Type == GLSL_VEC4) Var->Value.Data = malloc(sizeof(float) * 4);
-	else if (Var->Type == GLSL_INT || Var->Type == GLSL_SAMPLER2D) Var->Value.Data = malloc(sizeof(int));
-	else if (Var->Type == GLSL_MAT2) Var->Value.Data = malloc(sizeof(float) * 4);
-	else if (Var->Type == GLSL_MAT3) Var->Value.Data = malloc(sizeof(float) * 9);
-	else if (Var->Type == GLSL_MAT4) Var->Value.Data = malloc(sizeof(float) * 16);
-	Var->Value.Alloc = 1;
-}
-
-void AssignToExVal(glslVariable* AssignTo, glslExValue Val)
-{
-	VerifyVar(AssignTo);
-
-	if (AssignTo->Type != Val.Type && !(AssignTo->Type == GLSL_SAMPLER2D && Val.Type == GLSL_INT))
-	{
-		return;
-	}
-
-	if (Val.Type == GLSL_FLOAT)
-	{
-		((float*)AssignTo->Value.Data)[0] = Val.x;
-	}
-
-	else if (Val.Type == GLSL_VEC2)
-	{
-		((float*)AssignTo->Value.Data)[0] = Val.x;
-		((float*)AssignTo->Value.Data)[1] = Val.y;
-	}
-
-	else if (Val.Type == GLSL_VEC3)
-	{
-		((float*)AssignTo->Value.Data)[0] = Val.x;
-		((float*)AssignTo->Value.Data)[1] = Val.y;
-		((float*)AssignTo->Value.Data)[2] = Val.z;
-	}
-
-	else if (Val.Type == GLSL_VEC4)
+	// Lay out every variable, uniforms in the shader's part of the uniform block and the rest in the frame
+	for (int i = 0; i < OutputTokenized.GlobalVars.Size; i++)
 	{
-		((float*)AssignTo->Value.Data)[0] = Val.x;
-		((float*)AssignTo->Value.Data)[1] = Val.y;
-		((float*)AssignTo->Value.Data)[2] = Val.z;
-		((float*)AssignTo->Value.Data)[3] = Val.w;
+		glslVariable* Var;
+		swglVectorRead(&OutputTokenized.GlobalVars, &Var, i);
+		GLSLAssignSlot(Var, &OutputTokenized);
 	}
 
-	else if (Val.Type == GLSL_INT)
+	for (int i = 0; i < OutputTokenized.Funcs.Size; i++)
 	{
-		((int*)AssignTo->Value.Data)[0] = Val.i;
-	}
+		glslFunction* Func;
+		swglVectorRead(&OutputTokenized.Funcs, &Func, i);
 
-	else if (Val.Type == GLSL_MAT2)
-	{
-		((float*)AssignTo->Value.Data)[0] = Val.Mat2.m00;
-		((float*)AssignTo->Value.Data)[1] = Val.Mat2.m01;
-		((float*)AssignTo->Value.Data)[2] = Val.Mat2.m10;
-		((float*)AssignTo->Value.Data)[3] = Val.Mat2.m11;
-	}
+		if (Func->RootScope->UsesQuadTokens) OutputTokenized.UsesQuadTokens = 1;
 
-	else if (Val.Type == GLSL_MAT3)
-	{
-		((float*)AssignTo->Value.Data)[0] = Val.Mat3.m00;
-		((float*)AssignTo->Value.Data)[1] = Val.Mat3.m01;
-		((float*)AssignTo->Value.Data)[2] = Val.Mat3.m02;
-		((float*)AssignTo->Value.Data)[3] = Val.Mat3.m10;
-		((float*)AssignTo->Value.Data)[4] = Val.Mat3.m11;
-		((float*)AssignTo->Value.Data)[5] = Val.Mat3.m12;
-		((float*)AssignTo->Value.Data)[6] = Val.Mat3.m20;
-		((float*)AssignTo->Value.Data)[7] = Val.Mat3.m21;
-		((float*)AssignTo->Value.Data)[8] = Val.Mat3.m22;
+		for (int j = 0; j < Func->RootScope->Variables.Size; j++)
+		{
+			glslVariable* Var;
+			swglVectorRead(&Func->RootScope->Variables, &Var, j);
+			GLSLAssignSlot(Var, &OutputTokenized);
+		}
 	}
 
-	else if (Val.Type == GLSL_MAT4)
-	{
-		((float*)AssignTo->Value.Data)[0] = Val.Mat4.m00;
-		((float*)AssignTo->Value.Data)[1] = Val.Mat4.m01;
-		((float*)AssignTo->Value.Data)[2] = Val.Mat4.m02;
-		((float*)AssignTo->Value.Data)[3] = Val.Mat4.m03;
-		((float*)AssignTo->Value.Data)[4] = Val.Mat4.m10;
-		((float*)AssignTo->Value.Data)[5] = Val.Mat4.m11;
-		((float*)AssignTo->Value.Data)[6] = Val.Mat4.m12;
-		((float*)AssignTo->Value.Data)[7] = Val.Mat4.m13;
-		((float*)AssignTo->Value.Data)[8] = Val.Mat4.m20;
-		((float*)AssignTo->Value.Data)[9] = Val.Mat4.m21;
-		((float*)AssignTo->Value.Data)[10] = Val.Mat4.m22;
-		((float*)AssignTo->Value.Data)[11] = Val.Mat4.m23;
-		((float*)AssignTo->Value.Data)[12] = Val.Mat4.m30;
-		((float*)AssignTo->Value.Data)[13] = Val.Mat4.m31;
-		((float*)AssignTo->Value.Data)[14] = Val.Mat4.m32;
-		((float*)AssignTo->Value.Data)[15] = Val.Mat4.m33;
-	}
+	return OutputTokenized;
 }
 
-glslExValue VarToExVal(glslVariable* Var)
-{
-	glslExValue Out;
-	Out.Type = Var->Type;
-
-	if (Var->Type == GLSL_FLOAT)
-	{
-		Out.x = ((float*)Var->Value.Data)[0];
-	}
-
-	else if (Var->Type == GLSL_VEC2)
-	{
-		Out.x = ((float*)Var->Value.Data)[0];
-		Out.y = ((float*)Var->Value.Data)[1];
-	}
-
-	else if (Var->Type == GLSL_VEC3)
-	{
-		Out.x = ((float*)Var->Value.Data)[0];
-		Out.y = ((float*)Var->Value.Data)[1];
-		Out.z = ((float*)Var->Value.Data)[2];
-	}
-
-	else if (Var->Type == GLSL_VEC4)
-	{
-		Out.x = ((float*)Var->Value.Data)[0];
-		Out.y = ((float*)Var->Value.Data)[1];
-		Out.z = ((float*)Var->Value.Data)[2];
-		Out.w = ((float*)Var->Value.Data)[3];
-	}
+/*
+* CONTEXTS
+* Every object and piece of state GL calls use belongs to a context. Each thread renders with the
+* context it made current, so threads with separate contexts share nothing and take no locks
+*/
 
-	else if (Var->Type == GLSL_INT)
-	{
-		Out.i = ((int*)Var->Value.Data)[0];
-	}
+typedef struct
+{
+	GLenum Type;
 
-	return Out;
-}
+	_SwglString* MyCode;
+	uint8_t Compiled;
+	glslTokenized CompiledData;
+} RawShader;
 
 typedef struct
 {
@@ -2030,1721 +1909,5864 @@ typedef struct
 	GLenum TRepeat;
 } Texture2D;
 
-_SwglVector GlobalTextures;
-Texture2D* ActiveTexture2D;
-Texture2D* TextureUnits[8];
-int ActiveTextureUnit;
-
-void glGenTextures(GLsizei n, GLuint* textures)
-{
-	Texture2D* Texture = (Texture2D*)malloc(sizeof(Texture2D));
-	Texture->Data = 0;
-	Texture->FloatsPerPixel = 3;
-	Texture->Width = 0;
-	Texture->Height = 0;
-	Texture->SRepeat = GL_REPEAT;
-	Texture->TRepeat = GL_REPEAT;
-	Texture->MipMaps = swglNewVector(sizeof(MipMap2D));
-	swglVectorPushBack(&GlobalTextures, &Texture);
-	*textures = GlobalTextures.Size;
-}
-void glBindTexture(GLenum target, GLuint texture)
+typedef struct
 {
-	if (target == GL_TEXTURE_2D)
-	{
+	uint8_t Linked;
+	int LinkCount; // Fetch plans built for an earlier link are rebuilt
+	_SwglVector VertexFragInOut;
+	_SwglVector Uniforms;
+	_SwglVector Layouts;
 
-		if (texture == 0)
-		{
-			ActiveTexture2D = 0;
-		}
-		else
-		{
-			swglVectorRead(&GlobalTextures, &ActiveTexture2D, texture - 1);
-			swglVectorRead(&GlobalTextures, &TextureUnits[ActiveTextureUnit], texture - 1);
+	uint8_t HasVertex;
+	uint8_t HasFrag;
+	glslTokenized VertexShader;
+	glslTokenized FragmentShader;
+
+	// Values of Uniforms, the vertex shader's part first. Only glUniform* writes it
+	uint8_t* UniformBlock;
+	int VertexUniformCount;
+
+	glslVariable* PositionVar;
+	glslVariable* InstanceIDVar; // 0 when the vertex shader does not read it
+	glslVariable* FragmentOut;
+
+	// Transform feedback, the names given to glTransformFeedbackVaryings and the outputs linking found for them
+	_SwglVector FeedbackNames; // _SwglString*
+	_SwglVector FeedbackVars;
+	int FeedbackFloats; // Per captured vertex, 0 when the program captures nothing
+} Program;
+
+typedef struct
+{
+	void* data;
+	GLsizeiptr size;
+	uint8_t mapped;
+	uint8_t external; // data belongs to the application, see swglBufferStorageExternal
+} Buffer;
+
+// Buffer storage and Buffer structs are aligned to this for the vertex fetch's vector loads
+#define SWGL_BUFFER_ALIGN 64
+
+// Size classes of the buffer pool, powers of two from SWGL_BUFFER_ALIGN bytes up. Larger storage is allocated on its own
+#define SWGL_BUFFER_CLASSES 11
+
+// Bytes the pool takes from malloc at once, split into blocks of one class
+#define SWGL_BUFFER_SLAB_SIZE (256 * 1024)
+
+// Free blocks of each size class, linked through their first bytes. Blocks go back to the pool, not to malloc,
+// until the context is destroyed
+typedef struct
+{
+	void* FreeBlocks[SWGL_BUFFER_CLASSES];
+	_SwglVector Slabs; // void*, as malloc returned them
+} BufferPool;
+
+typedef struct
+{
+	GLsizei stride;
+	GLboolean normalized;
+	GLenum type;
+	GLint size;
+	GLuint index;
+	GLuint divisor; // Instances per attribute element, 0 to advance per vertex
+
+	int offset;
+} VertexArrayAttrib;
+
+// How one attribute reaches its vertex shader input
+typedef struct
+{
+	int Offset;
+	int Stride;
+	GLuint Divisor;
+	GLenum Type;
+	GLboolean Normalized;
+	int Components; // Read from the buffer, the input's other components get their defaults
+
+	// Normalized integers are divided by their largest value, Range for x, y and z and RangeW for w, otherwise by 1.
+	// Signed ones are clamped to -1, their most negative value is one past -Range
+	float Range;
+	float RangeW;
+	uint8_t SignedNormalized;
+
+	int Slot; // Of the input in the frame
+	int InputFloats;
+	uint8_t IntegerInput;
+	int StagedOffset; // Floats into a staged vertex
+} AttributeFetch;
+
+// The attribute fetches of a vertex array for one linked program, built by the first draw using both
+typedef struct
+{
+	Program* BuiltFor; // 0 when the attributes changed since it was built
+	int LinkCount;
+	_SwglVector Fetches; // AttributeFetch
+	int StagedFloats;
+} FetchPlan;
+
+// The buffers are the bound buffer objects, so data given to them later is seen by the vertex array
+typedef struct
+{
+	_SwglVector Attribs;
+	Buffer* VertexBuffer;
+	Buffer* ElementBuffer;
+	FetchPlan Plan;
+} VertexArray;
+
+typedef struct
+{
+	GLsizei Width;
+	GLsizei Height;
+
+	GLenum ColorFormat;
+	uint32_t* ColorAttachment;
+
+	GLenum DepthFormat;
+	void* DepthAttachment;
+
+	// Samples per pixel are stored next to each other. Single sampled framebuffers alias the attachments,
+	// multisampled ones are resolved into ColorAttachment by glGetFramePtr
+	GLsizei Samples;
+	uint32_t* SampleColor;
+	void* SampleDepth;
+} Framebuffer;
+
+// Color and depth buffers a context can render to in turn
+#define SWGL_MAX_SWAP_BUFFERS 3
+
+// Vertex batches whose tiles may still be rasterizing while the next ones are shaded and binned
+#if SWGL_THREAD_COUNT > 1
+#define SWGL_PIPELINE_DEPTH 4
+#else
+#define SWGL_PIPELINE_DEPTH 1
+#endif
+
+// Defined with the tiled rasterizer
+typedef struct RasterBatch RasterBatch;
+typedef struct RasterCell RasterCell;
+void FinishRasterBatches();
+
+// Defined with vertex shading
+typedef struct VertexCache VertexCache;
+
+struct swglContext
+{
+	_SwglVector Shaders;
+	_SwglVector Programs;
+	_SwglVector VertexArrays;
+	_SwglVector Buffers; // Deleted buffers leave 0 behind
+	_SwglVector Textures;
+
+	BufferPool BufferPool; // Buffer structs and storage
+	_SwglVector FreeBufferNames; // Deleted, given out again by glGenBuffers
+
+	Program* ActiveProgram;
+	VertexArray* ActiveVertexArray;
+	Buffer* ArrayBuffer;
+	Buffer* DrawIndirectBuffer;
+	Buffer* TransformFeedbackBuffer;
+	Texture2D* ActiveTexture2D;
+	Texture2D* TextureUnits[8];
+	int ActiveTextureUnit;
+
+	// Framebuffer is the back buffer of the swap chain, the one being rendered to
+	Framebuffer* Framebuffer;
+	Framebuffer* SwapChain[SWGL_MAX_SWAP_BUFFERS];
+	int SwapBufferCount;
+	int BackBuffer;
+
+	GLint ViewportX;
+	GLint ViewportY;
+	GLsizei ViewportWidth;
+	GLsizei ViewportHeight;
+
+	GLfloat ClearColorRed;
+	GLfloat ClearColorGreen;
+	GLfloat ClearColorBlue;
+	GLfloat ClearColorAlpha;
+
+	uint8_t MultisampleEnabled;
+	uint8_t CullFaceEnabled;
+	GLenum CullFaceMode;
+	GLenum FrontFaceMode;
+	GLfloat LineWidth;
+	uint8_t RasterizerDiscard;
+
+	// Between glBeginTransformFeedback and glEndTransformFeedback draws capture into TransformFeedbackBuffer
+	uint8_t TransformFeedbackActive;
+	int TransformFeedbackPrimitiveVerts; // Of the primitive mode it began with
+	size_t TransformFeedbackOffset; // Bytes written
+	GLsizei TransformFeedbackVertices;
+
+	swglTriangleStats TriangleStats;
+	swglVertexStats VertexStats;
+	VertexCache* VertexCache; // Allocated by the first triangle or line draw
+
+	swglThreadPool* ThreadPool; // 0 for the default pool
+
+	// Async mode, see COMMAND BUFFER and ASYNC EXECUTION
+	uint8_t AsyncEnabled;
+	_SwglVector RecordingCommands;
+	void* StagedMap; // Storage of an invalidating map made while recording, copied into the buffer when unmapped
+	GLenum StagedMapTarget;
+	GLintptr StagedMapOffset;
+	GLsizeiptr StagedMapLength;
+#ifdef SWGL_THREADS
+	pthread_t RenderThread;
+	pthread_mutex_t CommandLock;
+	pthread_cond_t CommandsSubmitted;
+	pthread_cond_t CommandsExecuted; // Also broadcast when a fence is signaled
+	_SwglVector SubmittedCommands;
+	uint64_t SubmittedCount;
+	uint64_t ExecutedCount;
+	uint8_t StopRenderThread;
+#endif
+
+	// Raster pipeline, see TILED RASTERIZATION. Batches are oldest first
+	RasterBatch* InFlightBatches[SWGL_PIPELINE_DEPTH];
+	int InFlightCount;
+	RasterCell* RasterCells;
+	int RasterCellsX;
+	int RasterCellsY;
+#ifdef SWGL_THREADS
+	pthread_mutex_t RasterLock; // Guards the queue and Running flag of every cell
+#endif
+};
+
+SWGL_THREAD_LOCAL swglContext* CurrentContext;
+
+/*
+* COMMAND BUFFER
+* In async mode the application's GL calls are recorded here and run on the render thread,
+* which is started and fed by ASYNC EXECUTION at the end of the file
+*/
+
+// Recorded calls are handed to the render thread once this many are pending, so it can start before glFlush
+#define SWGL_COMMAND_SUBMIT_SIZE 256
+
+typedef enum
+{
+	SWGL_CMD_SHADER_SOURCE,
+	SWGL_CMD_COMPILE_SHADER,
+	SWGL_CMD_ATTACH_SHADER,
+	SWGL_CMD_LINK_PROGRAM,
+	SWGL_CMD_USE_PROGRAM,
+	SWGL_CMD_BIND_VERTEX_ARRAY,
+	SWGL_CMD_VERTEX_ATTRIB_POINTER,
+	SWGL_CMD_VERTEX_ATTRIB_DIVISOR,
+	SWGL_CMD_BIND_BUFFER,
+	SWGL_CMD_BIND_BUFFER_BASE,
+	SWGL_CMD_DELETE_BUFFERS,
+	SWGL_CMD_BUFFER_DATA,
+	SWGL_CMD_BUFFER_SUB_DATA,
+	SWGL_CMD_BUFFER_STORAGE_EXTERNAL,
+	SWGL_CMD_UNMAP_BUFFER,
+	SWGL_CMD_CLEAR_COLOR,
+	SWGL_CMD_CLEAR,
+	SWGL_CMD_VIEWPORT,
+	SWGL_CMD_ENABLE,
+	SWGL_CMD_DISABLE,
+	SWGL_CMD_CULL_FACE,
+	SWGL_CMD_FRONT_FACE,
+	SWGL_CMD_LINE_WIDTH,
+	SWGL_CMD_DRAW_ARRAYS,
+	SWGL_CMD_DRAW_ELEMENTS,
+	SWGL_CMD_MULTI_DRAW_ARRAYS,
+	SWGL_CMD_MULTI_DRAW_ELEMENTS,
+	SWGL_CMD_MULTI_DRAW_ARRAYS_INDIRECT,
+	SWGL_CMD_BEGIN_TRANSFORM_FEEDBACK,
+	SWGL_CMD_END_TRANSFORM_FEEDBACK,
+	SWGL_CMD_ACTIVE_TEXTURE,
+	SWGL_CMD_BIND_TEXTURE,
+	SWGL_CMD_TEX_PARAMETERI,
+	SWGL_CMD_TEX_IMAGE_2D,
+	SWGL_CMD_GENERATE_MIPMAP,
+	SWGL_CMD_UNIFORM_F,
+	SWGL_CMD_UNIFORM_1I,
+	SWGL_CMD_UNIFORM_MATRIX,
+	SWGL_CMD_RESET_TRIANGLE_STATS,
+	SWGL_CMD_RESET_VERTEX_STATS,
+	SWGL_CMD_SET_SAMPLE_COUNT,
+	SWGL_CMD_SET_SWAP_BUFFER_COUNT,
+	SWGL_CMD_FENCE
+} CommandOp;
+
+// Arguments are captured by value when the call is recorded. Memory the call reads from the application
+// is copied into Data, memory swgl owns (buffer storage, shaders) is referenced and read at execution
+typedef struct
+{
+	CommandOp Op;
+	GLenum Enums[3];
+	GLint Ints[5];
+	GLsizeiptr Sizes[2]; // Buffer sizes and offsets, which an int would cut off past 2 GiB
+	GLfloat Floats[4];
+	void* Pointer; // Passed through as is, attribute and index offsets, external buffer storage and fences
+	void* Data; // Owned by the command, freed once it has executed
+} RecordedCommand;
+
+// Whether a GL call should be recorded instead of executed, the render thread always executes
+uint8_t IsRecording()
+{
+#ifdef SWGL_THREADS
+	return CurrentContext->AsyncEnabled && !pthread_equal(pthread_self(), CurrentContext->RenderThread);
+#else
+	return 0;
+#endif
+}
+
+RecordedCommand* RecordCommand(CommandOp Op)
+{
+	_SwglVector* Commands = &CurrentContext->RecordingCommands;
+
+	if (Commands->Size >= SWGL_COMMAND_SUBMIT_SIZE) glFlush();
+
+	RecordedCommand Command;
+	memset(&Command, 0, sizeof(Command));
+	Command.Op = Op;
+	swglVectorPushBack(Commands, &Command);
+
+	return (RecordedCommand*)Commands->Data + Commands->Size - 1;
+}
+
+void* CopyCommandData(const void* Data, size_t Size)
+{
+	if (!Data) return 0;
+
+	void* Copy = malloc(Size);
+	memcpy(Copy, Data, Size);
+	return Copy;
+}
+
+// Calls that return state run on the caller's thread once the render thread has caught up
+void FinishRecordedCommands()
+{
+#ifdef SWGL_THREADS
+	swglContext* Context = CurrentContext;
+
+	if (!IsRecording()) return;
+
+	glFlush();
+
+	pthread_mutex_lock(&Context->CommandLock);
+	while (Context->ExecutedCount < Context->SubmittedCount) pthread_cond_wait(&Context->CommandsExecuted, &Context->CommandLock);
+	pthread_mutex_unlock(&Context->CommandLock);
+#endif
+}
+
+/*
+* SCHEDULER
+* Jobs run on the worker threads of a thread pool and on any thread waiting for them. Every worker owns a deque
+* that it pushes and pops at the back, a thread out of work steals the oldest job from the front of another deque.
+* Threads that are not workers of the pool share deque 0. Contexts share a default pool of SWGL_THREAD_COUNT
+* threads unless given their own. Pools of one thread, and builds without SWGL_THREADS, run jobs as they are submitted
+*/
+
+typedef void (*JobFunction)(void* Arg);
+
+// Jobs submitted together, WaitJobGroup returns once every one of them has run
+typedef struct
+{
+	int Pending;
+	swglThreadPool* Pool; // Set by the first job, every job of a group goes to the same pool
+} JobGroup;
+
+typedef struct
+{
+	JobFunction Function;
+	void* Arg;
+	JobGroup* Group;
+	swglContext* Context; // The submitting thread's, current while the job runs
+} Job;
+
+#ifdef SWGL_THREADS
+// Threads a pool can have, counting the threads that wait on it
+#define SWGL_MAX_THREADS 64
+
+// CPUs an affinity mask can name, in the words sched_setaffinity takes
+#define SWGL_MAX_CPUS 1024
+#define SWGL_CPU_MASK_WORDS (SWGL_MAX_CPUS / (8 * sizeof(unsigned long)))
+
+typedef struct
+{
+	pthread_mutex_t Lock;
+	_SwglVector Jobs;
+	int Head; // Jobs before Head have been stolen
+
+	swglThreadPool* Pool;
+	int Index;
+} JobDeque;
+#endif
+
+struct swglThreadPool
+{
+	int ThreadCount;
+	swglSchedulerStats Stats;
+
+#ifdef SWGL_THREADS
+	// Guards QueuedJobs, Stats, StopWorkers and the Pending count of every group submitted to the pool
+	pthread_mutex_t Lock;
+	pthread_cond_t JobsQueued;
+	pthread_cond_t GroupsFinished;
+	int QueuedJobs;
+
+	JobDeque Deques[SWGL_MAX_THREADS];
+	pthread_t Workers[SWGL_MAX_THREADS];
+	uint8_t StopWorkers;
+
+	// Only changed while the workers are stopped
+	uint64_t SpinNanoseconds;
+	unsigned long* AffinityMasks; // Worker i, the thread of deque i + 1, runs on mask i % AffinityCount
+	int AffinityCount;
+#endif
+};
+
+#ifdef SWGL_THREADS
+swglThreadPool* DefaultPool;
+pthread_once_t DefaultPoolCreated = PTHREAD_ONCE_INIT;
+
+SWGL_THREAD_LOCAL swglThreadPool* WorkerPool;
+SWGL_THREAD_LOCAL int WorkerIndex;
+
+uint64_t MonotonicNanoseconds()
+{
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint64_t)Now.tv_sec * 1000000000 + Now.tv_nsec;
+}
+
+void CreateDefaultPool()
+{
+	DefaultPool = swglCreateThreadPool(SWGL_THREAD_COUNT);
+}
+#else
+swglThreadPool DefaultPoolStorage = { .ThreadCount = 1 };
+swglThreadPool* DefaultPool = &DefaultPoolStorage;
+#endif
+
+swglThreadPool* CurrentPool()
+{
+	if (CurrentContext && CurrentContext->ThreadPool) return CurrentContext->ThreadPool;
+
+#ifdef SWGL_THREADS
+	pthread_once(&DefaultPoolCreated, CreateDefaultPool);
+#endif
+	return DefaultPool;
+}
+
+#ifdef SWGL_THREADS
+// The newest job of the calling thread's deque, or the oldest of the first other deque that has one
+uint8_t TakeJob(swglThreadPool* Pool, Job* Out)
+{
+	int Own = WorkerPool == Pool ? WorkerIndex : 0;
+	uint8_t Stolen = 0;
+	uint8_t Found = 0;
+
+	for (int i = 0; i < Pool->ThreadCount && !Found; i++)
+	{
+		JobDeque* Deque = &Pool->Deques[(Own + i) % Pool->ThreadCount];
+
+		pthread_mutex_lock(&Deque->Lock);
+		if (Deque->Jobs.Size > Deque->Head)
+		{
+			if (i == 0)
+			{
+				Deque->Jobs.Size--;
+				swglVectorRead(&Deque->Jobs, Out, Deque->Jobs.Size);
+			}
+			else
+			{
+				swglVectorRead(&Deque->Jobs, Out, Deque->Head);
+				Deque->Head++;
+				Stolen = 1;
+			}
+
+			if (Deque->Jobs.Size == Deque->Head) Deque->Jobs.Size = Deque->Head = 0;
+			Found = 1;
+		}
+		pthread_mutex_unlock(&Deque->Lock);
+	}
+
+	if (!Found) return 0;
+
+	pthread_mutex_lock(&Pool->Lock);
+	Pool->QueuedJobs--;
+	if (Stolen) Pool->Stats.Steals++;
+	pthread_mutex_unlock(&Pool->Lock);
+
+	return 1;
+}
+
+// Takes a job, looking again for up to the pool's spin time before giving up
+uint8_t SpinForJob(swglThreadPool* Pool, Job* Out)
+{
+	if (TakeJob(Pool, Out)) return 1;
+	if (!Pool->SpinNanoseconds) return 0;
+
+	uint64_t SpinEnd = MonotonicNanoseconds() + Pool->SpinNanoseconds;
+
+	while (MonotonicNanoseconds() < SpinEnd)
+	{
+		if (TakeJob(Pool, Out)) return 1;
+	}
+
+	return 0;
+}
+#endif
+
+void RunJob(Job* MyJob)
+{
+	swglContext* PreviousContext = CurrentContext;
+	CurrentContext = MyJob->Context;
+	MyJob->Function(MyJob->Arg);
+	CurrentContext = PreviousContext;
+
+	swglThreadPool* Pool = MyJob->Group->Pool;
+
+#ifdef SWGL_THREADS
+	pthread_mutex_lock(&Pool->Lock);
+	Pool->Stats.Jobs++;
+	MyJob->Group->Pending--;
+	if (!MyJob->Group->Pending) pthread_cond_broadcast(&Pool->GroupsFinished);
+	pthread_mutex_unlock(&Pool->Lock);
+#else
+	Pool->Stats.Jobs++;
+	MyJob->Group->Pending--;
+#endif
+}
+
+#ifdef SWGL_THREADS
+// Restricts the calling thread to the CPUs in Mask, Linux only
+void SetThreadAffinity(unsigned long* Mask)
+{
+#ifdef __linux__
+	syscall(SYS_sched_setaffinity, 0, sizeof(unsigned long) * SWGL_CPU_MASK_WORDS, Mask);
+#endif
+}
+
+void* WorkerMain(void* Arg)
+{
+	JobDeque* Own = (JobDeque*)Arg;
+	swglThreadPool* Pool = Own->Pool;
+
+	WorkerPool = Pool;
+	WorkerIndex = Own->Index;
+
+	// Deque 0 belongs to the threads waiting on the pool, worker i owns deque i + 1
+	int Worker = Own->Index - 1;
+	if (Pool->AffinityCount) SetThreadAffinity(Pool->AffinityMasks + Worker % Pool->AffinityCount * SWGL_CPU_MASK_WORDS);
+
+	while (1)
+	{
+		Job MyJob;
+
+		if (SpinForJob(Pool, &MyJob))
+		{
+			RunJob(&MyJob);
+			continue;
+		}
+
+		pthread_mutex_lock(&Pool->Lock);
+		uint8_t Stop = Pool->StopWorkers;
+		if (!Stop && !Pool->QueuedJobs)
+		{
+			uint64_t IdleStart = MonotonicNanoseconds();
+			pthread_cond_wait(&Pool->JobsQueued, &Pool->Lock);
+			Pool->Stats.IdleNanoseconds += MonotonicNanoseconds() - IdleStart;
+		}
+		pthread_mutex_unlock(&Pool->Lock);
+
+		if (Stop) break;
+	}
+
+	return 0;
+}
+
+void StartWorkers(swglThreadPool* Pool)
+{
+	for (int i = 1; i < Pool->ThreadCount; i++) pthread_create(&Pool->Workers[i], 0, WorkerMain, &Pool->Deques[i]);
+}
+
+// Workers finish the jobs that are queued before they exit
+void StopWorkers(swglThreadPool* Pool)
+{
+	pthread_mutex_lock(&Pool->Lock);
+	Pool->StopWorkers = 1;
+	pthread_cond_broadcast(&Pool->JobsQueued);
+	pthread_mutex_unlock(&Pool->Lock);
+
+	for (int i = 1; i < Pool->ThreadCount; i++) pthread_join(Pool->Workers[i], 0);
+
+	Pool->StopWorkers = 0;
+}
+#endif
+
+// Counts a job into its group before SubmitHeldJob queues it, for jobs that have to wait for others first
+void HoldJob(JobGroup* Group)
+{
+	if (!Group->Pool) Group->Pool = CurrentPool();
+
+#ifdef SWGL_THREADS
+	pthread_mutex_lock(&Group->Pool->Lock);
+	Group->Pending++;
+	pthread_mutex_unlock(&Group->Pool->Lock);
+#else
+	Group->Pending++;
+#endif
+}
+
+void SubmitHeldJob(JobGroup* Group, JobFunction Function, void* Arg)
+{
+	Job MyJob = { Function, Arg, Group, CurrentContext };
+
+#ifdef SWGL_THREADS
+	swglThreadPool* Pool = Group->Pool;
+
+	if (Pool->ThreadCount > 1)
+	{
+		JobDeque* Deque = &Pool->Deques[WorkerPool == Pool ? WorkerIndex : 0];
+
+		pthread_mutex_lock(&Deque->Lock);
+		swglVectorPushBack(&Deque->Jobs, &MyJob);
+		uint64_t Depth = Deque->Jobs.Size - Deque->Head;
+		pthread_mutex_unlock(&Deque->Lock);
+
+		pthread_mutex_lock(&Pool->Lock);
+		Pool->QueuedJobs++;
+		Pool->Stats.MaxQueueDepth = MAX(Pool->Stats.MaxQueueDepth, Depth);
+		pthread_cond_signal(&Pool->JobsQueued);
+		pthread_mutex_unlock(&Pool->Lock);
+		return;
+	}
+#endif
+
+	RunJob(&MyJob);
+}
+
+void SubmitJob(JobGroup* Group, JobFunction Function, void* Arg)
+{
+	// Counted before it can run, so the group cannot finish early
+	HoldJob(Group);
+	SubmitHeldJob(Group, Function, Arg);
+}
+
+// Runs queued jobs, the group's or any other, until the group has finished
+void WaitJobGroup(JobGroup* Group)
+{
+#ifdef SWGL_THREADS
+	swglThreadPool* Pool = Group->Pool;
+
+	if (!Pool) return;
+
+	while (1)
+	{
+		pthread_mutex_lock(&Pool->Lock);
+		if (!Group->Pending)
+		{
+			pthread_mutex_unlock(&Pool->Lock);
+			return;
+		}
+		pthread_mutex_unlock(&Pool->Lock);
+
+		Job MyJob;
+
+		if (SpinForJob(Pool, &MyJob))
+		{
+			RunJob(&MyJob);
+			continue;
+		}
+
+		// Its remaining jobs are running on other threads
+		pthread_mutex_lock(&Pool->Lock);
+		if (Group->Pending && !Pool->QueuedJobs) pthread_cond_wait(&Pool->GroupsFinished, &Pool->Lock);
+		pthread_mutex_unlock(&Pool->Lock);
+	}
+#endif
+}
+
+swglThreadPool* swglCreateThreadPool(GLsizei threads)
+{
+#ifdef SWGL_THREADS
+	swglThreadPool* Pool = (swglThreadPool*)malloc(sizeof(swglThreadPool));
+	memset(Pool, 0, sizeof(swglThreadPool));
+
+	Pool->ThreadCount = MIN(MAX((int)threads, 1), SWGL_MAX_THREADS);
+
+	pthread_mutex_init(&Pool->Lock, 0);
+	pthread_cond_init(&Pool->JobsQueued, 0);
+	pthread_cond_init(&Pool->GroupsFinished, 0);
+
+	for (int i = 0; i < SWGL_MAX_THREADS; i++)
+	{
+		pthread_mutex_init(&Pool->Deques[i].Lock, 0);
+		Pool->Deques[i].Jobs = swglNewVector(sizeof(Job));
+		Pool->Deques[i].Head = 0;
+		Pool->Deques[i].Pool = Pool;
+		Pool->Deques[i].Index = i;
+	}
+
+	StartWorkers(Pool);
+
+	return Pool;
+#else
+	return DefaultPool;
+#endif
+}
+
+void swglDestroyThreadPool(swglThreadPool* pool)
+{
+#ifdef SWGL_THREADS
+	if (!pool || pool == DefaultPool) return;
+
+	StopWorkers(pool);
+
+	for (int i = 0; i < SWGL_MAX_THREADS; i++)
+	{
+		pthread_mutex_destroy(&pool->Deques[i].Lock);
+		swglVectorFree(&pool->Deques[i].Jobs);
+	}
+
+	pthread_mutex_destroy(&pool->Lock);
+	pthread_cond_destroy(&pool->JobsQueued);
+	pthread_cond_destroy(&pool->GroupsFinished);
+
+	free(pool->AffinityMasks);
+	free(pool);
+#endif
+}
+
+void swglSetThreadPool(swglThreadPool* pool)
+{
+	// Batches in flight finish on the pool they were queued on
+	FinishRecordedCommands();
+	FinishRasterBatches();
+
+	CurrentContext->ThreadPool = pool;
+}
+
+// Waits for the current context, then runs Change on its pool with the workers stopped
+void ReconfigurePool(void (*Change)(swglThreadPool* Pool, const void* Arg), const void* Arg)
+{
+	FinishRecordedCommands();
+	FinishRasterBatches();
+
+#ifdef SWGL_THREADS
+	swglThreadPool* Pool = CurrentPool();
+
+	StopWorkers(Pool);
+	Change(Pool, Arg);
+	StartWorkers(Pool);
+#endif
+}
+
+#ifdef SWGL_THREADS
+void ChangeThreadCount(swglThreadPool* Pool, const void* Arg)
+{
+	Pool->ThreadCount = MIN(MAX(*(const int*)Arg, 1), SWGL_MAX_THREADS);
+}
+
+void ChangeThreadSpin(swglThreadPool* Pool, const void* Arg)
+{
+	Pool->SpinNanoseconds = *(const GLuint64*)Arg;
+}
+
+typedef struct
+{
+	const GLint* Cpus;
+	int Count;
+	GLint Node;
+} AffinityChange;
+
+// Sets every CPU of a cpulist such as "0-3,8" in Mask
+void ParseCpuList(const char* List, unsigned long* Mask)
+{
+	while (*List >= '0' && *List <= '9')
+	{
+		int First = 0;
+		while (*List >= '0' && *List <= '9') First = First * 10 + *List++ - '0';
+
+		int Last = First;
+		if (*List == '-')
+		{
+			List++;
+			Last = 0;
+			while (*List >= '0' && *List <= '9') Last = Last * 10 + *List++ - '0';
+		}
+
+		for (int Cpu = First; Cpu <= Last && Cpu < SWGL_MAX_CPUS; Cpu++) Mask[Cpu / (8 * sizeof(unsigned long))] |= 1ul << (Cpu % (8 * sizeof(unsigned long)));
+
+		if (*List == ',') List++;
+	}
+}
+
+void ChangeAffinity(swglThreadPool* Pool, const void* Arg)
+{
+	const AffinityChange* Change = (const AffinityChange*)Arg;
+	unsigned long* Masks = 0;
+	int Count = 0;
+
+	if (Change->Count > 0)
+	{
+		Masks = (unsigned long*)calloc(Change->Count * SWGL_CPU_MASK_WORDS, sizeof(unsigned long));
+		Count = Change->Count;
+
+		for (int i = 0; i < Change->Count; i++)
+		{
+			int Cpu = Change->Cpus[i];
+			if (Cpu >= 0 && Cpu < SWGL_MAX_CPUS) Masks[i * SWGL_CPU_MASK_WORDS + Cpu / (8 * sizeof(unsigned long))] |= 1ul << (Cpu % (8 * sizeof(unsigned long)));
+		}
+	}
+
+#ifdef __linux__
+	if (Change->Node >= 0)
+	{
+		char Path[64];
+		char List[1024] = { 0 };
+		snprintf(Path, sizeof(Path), "/sys/devices/system/node/node%d/cpulist", Change->Node);
+
+		// The workers keep the affinity they had if the node's CPUs cannot be read
+		FILE* File = fopen(Path, "r");
+		if (!File) return;
+		char* Read = fgets(List, sizeof(List), File);
+		fclose(File);
+		if (!Read) return;
+
+		Masks = (unsigned long*)calloc(SWGL_CPU_MASK_WORDS, sizeof(unsigned long));
+		Count = 1;
+		ParseCpuList(List, Masks);
+	}
+#endif
+
+	free(Pool->AffinityMasks);
+	Pool->AffinityMasks = Masks;
+	Pool->AffinityCount = Count;
+}
+#endif
+
+void swglSetThreadCount(GLsizei threads)
+{
+#ifdef SWGL_THREADS
+	int Count = (int)threads;
+	ReconfigurePool(ChangeThreadCount, &Count);
+#endif
+}
+
+GLsizei swglGetThreadCount()
+{
+	return CurrentPool()->ThreadCount;
+}
+
+void swglSetThreadAffinity(const GLint* cpus, GLsizei count)
+{
+#ifdef SWGL_THREADS
+	AffinityChange Change = { cpus, cpus ? (int)count : 0, -1 };
+	ReconfigurePool(ChangeAffinity, &Change);
+#endif
+}
+
+void swglSetThreadNumaNode(GLint node)
+{
+#ifdef SWGL_THREADS
+	AffinityChange Change = { 0, 0, node };
+	ReconfigurePool(ChangeAffinity, &Change);
+#endif
+}
+
+void swglSetThreadSpin(GLuint64 nanoseconds)
+{
+#ifdef SWGL_THREADS
+	ReconfigurePool(ChangeThreadSpin, &nanoseconds);
+#endif
+}
+
+void swglGetSchedulerStats(swglSchedulerStats* stats)
+{
+	swglThreadPool* Pool = CurrentPool();
+
+#ifdef SWGL_THREADS
+	pthread_mutex_lock(&Pool->Lock);
+	*stats = Pool->Stats;
+	pthread_mutex_unlock(&Pool->Lock);
+#else
+	*stats = Pool->Stats;
+#endif
+}
+
+void swglResetSchedulerStats()
+{
+	swglThreadPool* Pool = CurrentPool();
+
+#ifdef SWGL_THREADS
+	pthread_mutex_lock(&Pool->Lock);
+	memset(&Pool->Stats, 0, sizeof(Pool->Stats));
+	pthread_mutex_unlock(&Pool->Lock);
+#else
+	memset(&Pool->Stats, 0, sizeof(Pool->Stats));
+#endif
+}
+
+void StoreExVal(void* Data, glslType Type, glslExValue Val)
+{
+	if (Type != Val.Type && !(Type == GLSL_SAMPLER2D && Val.Type == GLSL_INT))
+	{
+		return;
+	}
+
+	if (Val.Type == GLSL_FLOAT)
+	{
+		((float*)Data)[0] = Val.x;
+	}
+
+	else if (Val.Type == GLSL_VEC2)
+	{
+		((float*)Data)[0] = Val.x;
+		((float*)Data)[1] = Val.y;
+	}
+
+	else if (Val.Type == GLSL_VEC3)
+	{
+		((float*)Data)[0] = Val.x;
+		((float*)Data)[1] = Val.y;
+		((float*)Data)[2] = Val.z;
+	}
+
+	else if (Val.Type == GLSL_VEC4)
+	{
+		((float*)Data)[0] = Val.x;
+		((float*)Data)[1] = Val.y;
+		((float*)Data)[2] = Val.z;
+		((float*)Data)[3] = Val.w;
+	}
+
+	else if (Val.Type == GLSL_INT)
+	{
+		((int*)Data)[0] = Val.i;
+	}
+
+	else if (Val.Type == GLSL_MAT2)
+	{
+		((float*)Data)[0] = Val.Mat2.m00;
+		((float*)Data)[1] = Val.Mat2.m01;
+		((float*)Data)[2] = Val.Mat2.m10;
+		((float*)Data)[3] = Val.Mat2.m11;
+	}
+
+	else if (Val.Type == GLSL_MAT3)
+	{
+		((float*)Data)[0] = Val.Mat3.m00;
+		((float*)Data)[1] = Val.Mat3.m01;
+		((float*)Data)[2] = Val.Mat3.m02;
+		((float*)Data)[3] = Val.Mat3.m10;
+		((float*)Data)[4] = Val.Mat3.m11;
+		((float*)Data)[5] = Val.Mat3.m12;
+		((float*)Data)[6] = Val.Mat3.m20;
+		((float*)Data)[7] = Val.Mat3.m21;
+		((float*)Data)[8] = Val.Mat3.m22;
+	}
+
+	else if (Val.Type == GLSL_MAT4)
+	{
+		((float*)Data)[0] = Val.Mat4.m00;
+		((float*)Data)[1] = Val.Mat4.m01;
+		((float*)Data)[2] = Val.Mat4.m02;
+		((float*)Data)[3] = Val.Mat4.m03;
+		((float*)Data)[4] = Val.Mat4.m10;
+		((float*)Data)[5] = Val.Mat4.m11;
+		((float*)Data)[6] = Val.Mat4.m12;
+		((float*)Data)[7] = Val.Mat4.m13;
+		((float*)Data)[8] = Val.Mat4.m20;
+		((float*)Data)[9] = Val.Mat4.m21;
+		((float*)Data)[10] = Val.Mat4.m22;
+		((float*)Data)[11] = Val.Mat4.m23;
+		((float*)Data)[12] = Val.Mat4.m30;
+		((float*)Data)[13] = Val.Mat4.m31;
+		((float*)Data)[14] = Val.Mat4.m32;
+		((float*)Data)[15] = Val.Mat4.m33;
+	}
+}
+
+// Uniforms are read only while shading
+void AssignToExVal(glslContext* Context, glslVariable* AssignTo, glslExValue Val)
+{
+	if (AssignTo->isUniform) return;
+	StoreExVal(GLSLVarData(Context, AssignTo), AssignTo->Type, Val);
+}
+
+glslExValue DataToExVal(glslType Type, void* Data)
+{
+	glslExValue Out;
+	Out.Type = Type;
+
+	if (Type == GLSL_FLOAT)
+	{
+		Out.x = ((float*)Data)[0];
+	}
+
+	else if (Type == GLSL_VEC2)
+	{
+		Out.x = ((float*)Data)[0];
+		Out.y = ((float*)Data)[1];
+	}
+
+	else if (Type == GLSL_VEC3)
+	{
+		Out.x = ((float*)Data)[0];
+		Out.y = ((float*)Data)[1];
+		Out.z = ((float*)Data)[2];
+	}
+
+	else if (Type == GLSL_VEC4)
+	{
+		Out.x = ((float*)Data)[0];
+		Out.y = ((float*)Data)[1];
+		Out.z = ((float*)Data)[2];
+		Out.w = ((float*)Data)[3];
+	}
+
+	else if (Type == GLSL_INT)
+	{
+		Out.i = ((int*)Data)[0];
+	}
+
+	return Out;
+}
+
+void glGenTextures(GLsizei n, GLuint* textures)
+{
+	FinishRecordedCommands();
+
+	Texture2D* Texture = (Texture2D*)malloc(sizeof(Texture2D));
+	Texture->Data = 0;
+	Texture->FloatsPerPixel = 3;
+	Texture->Width = 0;
+	Texture->Height = 0;
+	Texture->SRepeat = GL_REPEAT;
+	Texture->TRepeat = GL_REPEAT;
+	Texture->MipMaps = swglNewVector(sizeof(MipMap2D));
+	swglVectorPushBack(&CurrentContext->Textures, &Texture);
+	*textures = CurrentContext->Textures.Size;
+}
+void glBindTexture(GLenum target, GLuint texture)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BIND_TEXTURE);
+		Command->Enums[0] = target;
+		Command->Ints[0] = texture;
+		return;
+	}
+
+	if (target == GL_TEXTURE_2D)
+	{
+
+		if (texture == 0)
+		{
+			CurrentContext->ActiveTexture2D = 0;
+		}
+		else
+		{
+			swglVectorRead(&CurrentContext->Textures, &CurrentContext->ActiveTexture2D, texture - 1);
+			swglVectorRead(&CurrentContext->Textures, &CurrentContext->TextureUnits[CurrentContext->ActiveTextureUnit], texture - 1);
+		}
+	}
+}
+
+void glActiveTexture(GLenum target)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_ACTIVE_TEXTURE);
+		Command->Enums[0] = target;
+		return;
+	}
+
+	CurrentContext->ActiveTextureUnit = (int)target - (int)GL_TEXTURE0;
+}
+
+void glTexParameteri(GLenum target, GLenum type, GLenum mode)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_TEX_PARAMETERI);
+		Command->Enums[0] = target;
+		Command->Enums[1] = type;
+		Command->Enums[2] = mode;
+		return;
+	}
+
+	// Raster jobs may be sampling the texture
+	FinishRasterBatches();
+
+	Texture2D* Texture = CurrentContext->ActiveTexture2D;
+
+	if (target == GL_TEXTURE_2D)
+	{
+		if (!Texture) return;
+		if (type == GL_TEXTURE_WRAP_S)
+		{
+			Texture->SRepeat = mode;
+		}
+		if (type == GL_TEXTURE_WRAP_T)
+		{
+			Texture->TRepeat = mode;
+		}
+	}
+}
+
+// Bytes glTexImage2D reads from its data
+size_t TextureDataSize(GLsizei Width, GLsizei Height, GLenum Format, GLenum Type)
+{
+	int Channels = 3;
+	if (Format == GL_RGBA) Channels = 4;
+	if (Format == GL_RG) Channels = 2;
+	if (Format == GL_RED) Channels = 1;
+
+	return (size_t)Width * Height * Channels * (Type == GL_FLOAT ? sizeof(float) : sizeof(uint8_t));
+}
+
+void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* data)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_TEX_IMAGE_2D);
+		Command->Enums[0] = target;
+		Command->Enums[1] = format;
+		Command->Enums[2] = type;
+		Command->Ints[0] = level;
+		Command->Ints[1] = internalformat;
+		Command->Ints[2] = width;
+		Command->Ints[3] = height;
+		Command->Ints[4] = border;
+		Command->Data = CopyCommandData(data, TextureDataSize(width, height, format, type));
+		return;
+	}
+
+	FinishRasterBatches();
+
+	Texture2D* Texture = CurrentContext->ActiveTexture2D;
+
+	if (!data) return;
+	if (border != 0) return; // By specification, must always be 0
+
+	if (target == GL_TEXTURE_2D)
+	{
+		if (!Texture) return;
+		if (Texture->Data) free(Texture->Data);
+		if (internalformat != format) return; // Must be the same format for both output and input
+		if (internalformat == GL_RGBA) Texture->FloatsPerPixel = 4;
+		if (internalformat == GL_RGB) Texture->FloatsPerPixel = 3;
+		if (internalformat == GL_RG) Texture->FloatsPerPixel = 2;
+		if (internalformat == GL_RED) Texture->FloatsPerPixel = 1;
+
+		Texture->Width = width;
+		Texture->Height = height;
+
+		Texture->Data = (float*)malloc(Texture->FloatsPerPixel * width * height * sizeof(float));
+
+		float* StepData = Texture->Data;
+
+		for (int i = 0; i < width * height * Texture->FloatsPerPixel; i += Texture->FloatsPerPixel)
+		{
+			for (int j = 0; j < Texture->FloatsPerPixel; j++)
+			{
+				if (type == GL_FLOAT) Texture->Data[i + j] = ((float*)data)[i + j];
+				if (type == GL_UNSIGNED_BYTE) Texture->Data[i + j] = ((uint8_t*)data)[i + j] / 255.0f;
+			}
+		}
+	}
+}
+
+// Rows of a mipmap level per job
+#define SWGL_MIP_JOB_ROWS 16
+
+typedef struct
+{
+	Texture2D* Texture;
+	float* PrevPtr;
+	float* CurPtr;
+	int CurWidth;
+	int FirstRow;
+	int RowCount;
+} MipRowsJob;
+
+// Box filters rows FirstRow to FirstRow + RowCount - 1 of a level from the level above it
+void DownsampleMipRows(void* Arg)
+{
+	MipRowsJob* Job = (MipRowsJob*)Arg;
+	Texture2D* Texture = Job->Texture;
+	float* PrevPtr = Job->PrevPtr;
+	float* CurPtr = Job->CurPtr;
+	int CurWidth = Job->CurWidth;
+
+	for (int y = Job->FirstRow; y < Job->FirstRow + Job->RowCount; y++)
+	{
+		for (int x = 0; x < CurWidth; x++)
+		{
+			float* CurPixel = CurPtr + Texture->FloatsPerPixel * (x + y * CurWidth);
+			if (Texture->FloatsPerPixel >= 1) CurPixel[0] = 0.0f;
+			if (Texture->FloatsPerPixel >= 2) CurPixel[1] = 0.0f;
+			if (Texture->FloatsPerPixel >= 3) CurPixel[2] = 0.0f;
+			if (Texture->FloatsPerPixel == 4) CurPixel[3] = 0.0f;
+			for (int sY = 0; sY < 2; sY++)
+			{
+				for (int sX = 0; sX < 2; sX++)
+				{
+					float* PrevPixel = PrevPtr + Texture->FloatsPerPixel * ((x * 2 + sX) + (y * 2 + sY) * CurWidth * 2);
+					if (Texture->FloatsPerPixel >= 1) CurPixel[0] += PrevPixel[0];
+					if (Texture->FloatsPerPixel >= 2) CurPixel[1] += PrevPixel[1];
+					if (Texture->FloatsPerPixel >= 3) CurPixel[2] += PrevPixel[2];
+					if (Texture->FloatsPerPixel == 4) CurPixel[3] += PrevPixel[3];
+				}
+			}
+			if (Texture->FloatsPerPixel >= 1) CurPixel[0] /= 4.0f;
+			if (Texture->FloatsPerPixel >= 2) CurPixel[1] /= 4.0f;
+			if (Texture->FloatsPerPixel >= 3) CurPixel[2] /= 4.0f;
+			if (Texture->FloatsPerPixel == 4) CurPixel[3] /= 4.0f;
+		}
+	}
+}
+
+void glGenerateMipmap(GLenum target)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_GENERATE_MIPMAP);
+		Command->Enums[0] = target;
+		return;
+	}
+
+	FinishRasterBatches();
+
+	Texture2D* Texture = CurrentContext->ActiveTexture2D;
+
+	if (target == GL_TEXTURE_2D)
+	{
+		if (!Texture) return;
+		if (!Texture->Data) return;
+
+		int CurWidth = Texture->Width / 2;
+		int CurHeight = Texture->Height / 2;
+
+		float* PrevPtr = Texture->Data;
+
+		while (CurWidth + CurHeight > 4)
+		{
+			float* CurPtr = (float*)malloc(CurWidth * CurHeight * sizeof(float) * Texture->FloatsPerPixel);
+
+			// Each level reads the one before it, so only its row bands run in parallel
+			int JobCount = (CurHeight + SWGL_MIP_JOB_ROWS - 1) / SWGL_MIP_JOB_ROWS;
+			MipRowsJob* Jobs = (MipRowsJob*)malloc(sizeof(MipRowsJob) * MAX(JobCount, 1));
+			JobGroup Group = { 0 };
+
+			for (int i = 0; i < JobCount; i++)
+			{
+				Jobs[i].Texture = Texture;
+				Jobs[i].PrevPtr = PrevPtr;
+				Jobs[i].CurPtr = CurPtr;
+				Jobs[i].CurWidth = CurWidth;
+				Jobs[i].FirstRow = i * SWGL_MIP_JOB_ROWS;
+				Jobs[i].RowCount = MIN(SWGL_MIP_JOB_ROWS, CurHeight - Jobs[i].FirstRow);
+				SubmitJob(&Group, DownsampleMipRows, &Jobs[i]);
+			}
+
+			WaitJobGroup(&Group);
+			free(Jobs);
+
+			MipMap2D Mipmap = { CurPtr, CurWidth, CurHeight };
+			swglVectorPushBack(&Texture->MipMaps, &Mipmap);
+
+			CurWidth /= 2;
+			CurHeight /= 2;
+			PrevPtr = CurPtr;
+		}
+	}
+}
+
+// Level 0 is the base image, level n > 0 is MipMaps[n - 1]
+glslExValue SampleTexture2DLevel(Texture2D* Texture, int Level, float s, float t)
+{
+	float* TextureData = Texture->Data;
+	int TextureWidth = Texture->Width;
+	int TextureHeight = Texture->Height;
+
+	if (Level > 0)
+	{
+		MipMap2D MipMap;
+		swglVectorRead(&Texture->MipMaps, &MipMap, Level - 1);
+
+		TextureData = MipMap.Data;
+		TextureWidth = MipMap.Width;
+		TextureHeight = MipMap.Height;
+	}
+
+	int TexelX = s * TextureWidth;
+	int TexelY = t * TextureHeight;
+
+	if (Texture->SRepeat == GL_REPEAT)
+	{
+		TexelX %= TextureWidth;
+		if (TexelX < 0) TexelX += TextureWidth;
+	}
+	TexelX = MIN(MAX(TexelX, 0), TextureWidth - 1);
+
+	if (Texture->TRepeat == GL_REPEAT)
+	{
+		TexelY %= TextureHeight;
+		if (TexelY < 0) TexelY += TextureHeight;
+	}
+	TexelY = MIN(MAX(TexelY, 0), TextureHeight - 1);
+
+	float* StartData = TextureData + Texture->FloatsPerPixel * (TexelX + TexelY * TextureWidth);
+
+	glslExValue OutVal = { GLSL_VEC4 };
+	if (Texture->FloatsPerPixel >= 1) OutVal.x = StartData[0];
+	if (Texture->FloatsPerPixel >= 2) OutVal.y = StartData[1];
+	if (Texture->FloatsPerPixel >= 3) OutVal.z = StartData[2];
+	if (Texture->FloatsPerPixel == 4) OutVal.w = StartData[3];
+
+	return OutVal;
+}
+
+// Nearest texel within a level, linear between the two levels around Lod
+glslExValue SampleTexture2D(Texture2D* Texture, float s, float t, float Lod)
+{
+	int MaxLevel = Texture->MipMaps.Size;
+
+	if (Lod <= 0.0f || MaxLevel == 0) return SampleTexture2DLevel(Texture, 0, s, t);
+	if (Lod >= MaxLevel) return SampleTexture2DLevel(Texture, MaxLevel, s, t);
+
+	int Level = (int)Lod;
+	float T = Lod - Level;
+
+	glslExValue OutVal = SampleTexture2DLevel(Texture, Level, s, t);
+	glslExValue Coarser = SampleTexture2DLevel(Texture, Level + 1, s, t);
+
+	OutVal.x = OutVal.x + T * (Coarser.x - OutVal.x);
+	OutVal.y = OutVal.y + T * (Coarser.y - OutVal.y);
+	OutVal.z = OutVal.z + T * (Coarser.z - OutVal.z);
+	OutVal.w = OutVal.w + T * (Coarser.w - OutVal.w);
+
+	return OutVal;
+}
+
+glslExValue ExecuteGLSLToken(glslContext* Context, glslToken* Token)
+{
+	if (Token->Type == GLSL_TOK_VAR)
+	{
+		void* Data = GLSLVarData(Context, Token->Var);
+
+		if (Token->Var->Type == GLSL_FLOAT)
+		{
+			glslExValue ExOutput = { GLSL_FLOAT, ((float*)Data)[0] };
+			return ExOutput;
+		}
+		else if (Token->Var->Type == GLSL_VEC2)
+		{
+			glslExValue ExOutput = { GLSL_VEC2, ((float*)Data)[0], ((float*)Data)[1] };
+			return ExOutput;
+		}
+		else if (Token->Var->Type == GLSL_VEC3)
+		{
+			glslExValue ExOutput = { GLSL_VEC3, ((float*)Data)[0], ((float*)Data)[1], ((float*)Data)[2] };
+			return ExOutput;
+		}
+		else if (Token->Var->Type == GLSL_VEC4)
+		{
+			glslExValue ExOutput = { GLSL_VEC4, ((float*)Data)[0], ((float*)Data)[1], ((float*)Data)[2], ((float*)Data)[3] };
+			return ExOutput;
+		}
+		else if (Token->Var->Type == GLSL_INT)
+		{
+			glslExValue ExOutput = { GLSL_INT, 0.0f, 0.0f, 0.0f, 0.0f, ((int*)Data)[0] };
+			return ExOutput;
+		}
+		else if (Token->Var->Type == GLSL_SAMPLER2D)
+		{
+			glslExValue ExOutput = { GLSL_SAMPLER2D, 0.0f, 0.0f, 0.0f, 0.0f, ((int*)Data)[0] };
+			return ExOutput;
+		}
+		else if (Token->Var->Type == GLSL_MAT2)
+		{
+			glslMat2 MatVal = { ((float*)Data)[0], ((float*)Data)[1],
+				  ((float*)Data)[1], ((float*)Data)[2] };
+			glslExValue ExOutput = { GLSL_MAT2, 0.0f, 0.0f, 0.0f, 0.0f, 0, MatVal };
+			return ExOutput;
+		}
+		else if (Token->Var->Type == GLSL_MAT3)
+		{
+			glslMat3 MatVal = { ((float*)Data)[0], ((float*)Data)[1], ((float*)Data)[2],
+				  ((float*)Data)[3], ((float*)Data)[4],  ((float*)Data)[5],
+				  ((float*)Data)[6], ((float*)Data)[7],  ((float*)Data)[8]
+			};
+			glslExValue ExOutput = { GLSL_MAT3, 0.0f, 0.0f, 0.0f, 0.0f, 0, { 0.0f }, MatVal };
+			return ExOutput;
+		}
+		else if (Token->Var->Type == GLSL_MAT4)
+		{
+			glslMat4 MatVal = { ((float*)Data)[0], ((float*)Data)[1], ((float*)Data)[2], ((float*)Data)[3],
+				  ((float*)Data)[4], ((float*)Data)[5],  ((float*)Data)[6], ((float*)Data)[7],
+				  ((float*)Data)[8], ((float*)Data)[9],  ((float*)Data)[10],  ((float*)Data)[11],
+				  ((float*)Data)[10], ((float*)Data)[13],  ((float*)Data)[14],  ((float*)Data)[15],
+			};
+			glslExValue ExOutput = { GLSL_MAT4, 0.0f, 0.0f, 0.0f, 0.0f, 0, { 0.0f }, { 0.0f }, MatVal };
+			return ExOutput;
+		}
+	}
+	else if (Token->Type == GLSL_TOK_CONST)
+	{
+		if (Token->Const.IsFloat)
+		{
+			glslExValue ExOutput = { GLSL_FLOAT, Token->Const.Fval };
+			return ExOutput;
+		}
+		else
+		{
+			glslExValue ExOutput = { GLSL_INT, 0.0f, 0.0f, 0.0f, 0.0f, Token->Const.Ival };
+			return ExOutput;
+		}
+	}
+	else if (Token->Type == GLSL_TOK_VAR_DECL)
+	{
+		glslExValue Result = ExecuteGLSLToken(Context, Token->Second);
+
+		AssignToExVal(Context, Token->Var, Result);
+		glslExValue ExOutput = { GLSL_UNKNOWN };
+		return ExOutput;
+	}
+	else if (Token->Type == GLSL_TOK_ASSIGN)
+	{
+		glslExValue Result = ExecuteGLSLToken(Context, Token->Second);
+
+		AssignToExVal(Context, Token->First->Var, Result);
+		return Result;
+	}
+	else if (Token->Type == GLSL_TOK_ADD)
+	{
+		glslExValue FirstResult = ExecuteGLSLToken(Context, Token->First);
+		glslExValue SecondResult = ExecuteGLSLToken(Context, Token->Second);
+
+		if (FirstResult.Type != SecondResult.Type)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		FirstResult.x += SecondResult.x;
+		FirstResult.y += SecondResult.y;
+		FirstResult.z += SecondResult.z;
+		FirstResult.w += SecondResult.w;
+		FirstResult.i += SecondResult.i;
+
+		if (FirstResult.Type == GLSL_MAT2)
+		{
+			FirstResult.Mat2.m00 += SecondResult.Mat2.m00;
+			FirstResult.Mat2.m01 += SecondResult.Mat2.m01;
+
+			FirstResult.Mat2.m10 += SecondResult.Mat2.m10;
+			FirstResult.Mat2.m11 += SecondResult.Mat2.m11;
+		}
+		else if (FirstResult.Type == GLSL_MAT3)
+		{
+			FirstResult.Mat3.m00 += SecondResult.Mat3.m00;
+			FirstResult.Mat3.m01 += SecondResult.Mat3.m01;
+			FirstResult.Mat3.m02 += SecondResult.Mat3.m02;
+
+			FirstResult.Mat3.m10 += SecondResult.Mat3.m10;
+			FirstResult.Mat3.m11 += SecondResult.Mat3.m11;
+			FirstResult.Mat3.m12 += SecondResult.Mat3.m12;
+
+			FirstResult.Mat3.m20 += SecondResult.Mat3.m20;
+			FirstResult.Mat3.m21 += SecondResult.Mat3.m21;
+			FirstResult.Mat3.m22 += SecondResult.Mat3.m22;
+		}
+		else if (FirstResult.Type == GLSL_MAT4)
+		{
+			FirstResult.Mat4.m00 += SecondResult.Mat4.m00;
+			FirstResult.Mat4.m01 += SecondResult.Mat4.m01;
+			FirstResult.Mat4.m02 += SecondResult.Mat4.m02;
+			FirstResult.Mat4.m03 += SecondResult.Mat4.m02;
+
+			FirstResult.Mat4.m10 += SecondResult.Mat4.m10;
+			FirstResult.Mat4.m11 += SecondResult.Mat4.m11;
+			FirstResult.Mat4.m12 += SecondResult.Mat4.m12;
+			FirstResult.Mat4.m13 += SecondResult.Mat4.m12;
+
+			FirstResult.Mat4.m20 += SecondResult.Mat4.m20;
+			FirstResult.Mat4.m21 += SecondResult.Mat4.m21;
+			FirstResult.Mat4.m22 += SecondResult.Mat4.m22;
+			FirstResult.Mat4.m23 += SecondResult.Mat4.m22;
+
+			FirstResult.Mat4.m30 += SecondResult.Mat4.m30;
+			FirstResult.Mat4.m31 += SecondResult.Mat4.m31;
+			FirstResult.Mat4.m32 += SecondResult.Mat4.m32;
+			FirstResult.Mat4.m33 += SecondResult.Mat4.m33;
+		}
+
+		return FirstResult;
+	}
+	else if (Token->Type == GLSL_TOK_SUB)
+	{
+		glslExValue FirstResult = ExecuteGLSLToken(Context, Token->First);
+		glslExValue SecondResult = ExecuteGLSLToken(Context, Token->Second);
+
+		if (FirstResult.Type != SecondResult.Type)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		FirstResult.x -= SecondResult.x;
+		FirstResult.y -= SecondResult.y;
+		FirstResult.z -= SecondResult.z;
+		FirstResult.w -= SecondResult.w;
+		FirstResult.i -= SecondResult.i;
+
+		if (FirstResult.Type == GLSL_MAT2)
+		{
+			FirstResult.Mat2.m00 -= SecondResult.Mat2.m00;
+			FirstResult.Mat2.m01 -= SecondResult.Mat2.m01;
+
+			FirstResult.Mat2.m10 -= SecondResult.Mat2.m10;
+			FirstResult.Mat2.m11 -= SecondResult.Mat2.m11;
+		}
+		else if (FirstResult.Type == GLSL_MAT3)
+		{
+			FirstResult.Mat3.m00 -= SecondResult.Mat3.m00;
+			FirstResult.Mat3.m01 -= SecondResult.Mat3.m01;
+			FirstResult.Mat3.m02 -= SecondResult.Mat3.m02;
+
+			FirstResult.Mat3.m10 -= SecondResult.Mat3.m10;
+			FirstResult.Mat3.m11 -= SecondResult.Mat3.m11;
+			FirstResult.Mat3.m12 -= SecondResult.Mat3.m12;
+
+			FirstResult.Mat3.m20 -= SecondResult.Mat3.m20;
+			FirstResult.Mat3.m21 -= SecondResult.Mat3.m21;
+			FirstResult.Mat3.m22 -= SecondResult.Mat3.m22;
+		}
+		else if (FirstResult.Type == GLSL_MAT4)
+		{
+			FirstResult.Mat4.m00 -= SecondResult.Mat4.m00;
+			FirstResult.Mat4.m01 -= SecondResult.Mat4.m01;
+			FirstResult.Mat4.m02 -= SecondResult.Mat4.m02;
+			FirstResult.Mat4.m03 -= SecondResult.Mat4.m02;
+
+			FirstResult.Mat4.m10 -= SecondResult.Mat4.m10;
+			FirstResult.Mat4.m11 -= SecondResult.Mat4.m11;
+			FirstResult.Mat4.m12 -= SecondResult.Mat4.m12;
+			FirstResult.Mat4.m13 -= SecondResult.Mat4.m12;
+
+			FirstResult.Mat4.m20 -= SecondResult.Mat4.m20;
+			FirstResult.Mat4.m21 -= SecondResult.Mat4.m21;
+			FirstResult.Mat4.m22 -= SecondResult.Mat4.m22;
+			FirstResult.Mat4.m23 -= SecondResult.Mat4.m22;
+
+			FirstResult.Mat4.m30 -= SecondResult.Mat4.m30;
+			FirstResult.Mat4.m31 -= SecondResult.Mat4.m31;
+			FirstResult.Mat4.m32 -= SecondResult.Mat4.m32;
+			FirstResult.Mat4.m33 -= SecondResult.Mat4.m33;
+		}
+
+		return FirstResult;
+	}
+	else if (Token->Type == GLSL_TOK_MUL)
+	{
+		glslExValue FirstResult = ExecuteGLSLToken(Context, Token->First);
+		glslExValue SecondResult = ExecuteGLSLToken(Context, Token->Second);
+
+		if (FirstResult.Type != GLSL_MAT2 && FirstResult.Type != GLSL_MAT3 && FirstResult.Type != GLSL_MAT4)
+		{
+			if (FirstResult.Type != SecondResult.Type)
+			{
+				glslExValue ExOutput = { GLSL_UNKNOWN };
+				return ExOutput;
+			}
+			FirstResult.x *= SecondResult.x;
+			FirstResult.y *= SecondResult.y;
+			FirstResult.z *= SecondResult.z;
+			FirstResult.w *= SecondResult.w;
+			FirstResult.i *= SecondResult.i;
+		}
+		else
+		{
+			if (FirstResult.Type == GLSL_MAT2 && SecondResult.Type == GLSL_MAT2)
+			{
+				FirstResult.Mat2 = MatMulMat2(&FirstResult.Mat2, &SecondResult.Mat2);
+			}
+			else if (FirstResult.Type == GLSL_MAT2 && SecondResult.Type == GLSL_VEC2)
+			{
+				glslVec2 InVec2 = { SecondResult.x, SecondResult.y };
+				glslVec2 Result = MatMulMat2Vec(&FirstResult.Mat2, &InVec2);
+				FirstResult.x = Result.x;
+				FirstResult.y = Result.y;
+				FirstResult.Type = GLSL_VEC2;
+			}
+			else if (FirstResult.Type == GLSL_MAT3 && SecondResult.Type == GLSL_MAT3)
+			{
+				FirstResult.Mat3 = MatMulMat3(&FirstResult.Mat3, &SecondResult.Mat3);
+			}
+			else if (FirstResult.Type == GLSL_MAT3 && SecondResult.Type == GLSL_VEC3)
+			{
+				glslVec3 InVec3 = { SecondResult.x, SecondResult.y, SecondResult.z };
+				glslVec3 Result = MatMulMat3Vec(&FirstResult.Mat3, &InVec3);
+				FirstResult.x = Result.x;
+				FirstResult.y = Result.y;
+				FirstResult.z = Result.z;
+				FirstResult.Type = GLSL_VEC3;
+			}
+			else if (FirstResult.Type == GLSL_MAT4 && SecondResult.Type == GLSL_MAT4)
+			{
+				FirstResult.Mat4 = MatMulMat4(&FirstResult.Mat4, &SecondResult.Mat4);
+			}
+			else if (FirstResult.Type == GLSL_MAT4 && SecondResult.Type == GLSL_VEC4)
+			{
+				glslVec4 InVec4 = { SecondResult.x, SecondResult.y, SecondResult.z, SecondResult.w };
+				glslVec4 Result = MatMulMat4Vec(&FirstResult.Mat4, &InVec4);
+				FirstResult.x = Result.x;
+				FirstResult.y = Result.y;
+				FirstResult.z = Result.z;
+				FirstResult.w = Result.w;
+				FirstResult.Type = GLSL_VEC4;
+			}
+		}
+
+
+		return FirstResult;
+	}
+	else if (Token->Type == GLSL_TOK_DIV)
+	{
+		glslExValue FirstResult = ExecuteGLSLToken(Context, Token->First);
+		glslExValue SecondResult = ExecuteGLSLToken(Context, Token->Second);
+
+		if (FirstResult.Type != SecondResult.Type)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		FirstResult.x /= SecondResult.x;
+		FirstResult.y /= SecondResult.y;
+		FirstResult.z /= SecondResult.z;
+		FirstResult.w /= SecondResult.w;
+		if (SecondResult.i != 0) FirstResult.i /= SecondResult.i;
+
+		return FirstResult;
+	}
+	else if (Token->Type == GLSL_TOK_TEXTURE)
+	{
+		if (Context->QuadResults) return Context->QuadResults[Token->QuadIndex];
+
+		if (Token->Args.Size != 2)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue FirstResult = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 1);
+		glslExValue SecondResult = ExecuteGLSLToken(Context, TokArg);
+
+		if (FirstResult.Type != GLSL_SAMPLER2D)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		if (SecondResult.Type != GLSL_VEC2)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		// Outside of quad shading there are no derivatives, so sample the base level
+		return SampleTexture2D(CurrentContext->TextureUnits[FirstResult.i], SecondResult.x, SecondResult.y, 0.0f);
+	}
+	else if (Token->Type == GLSL_TOK_DFDX || Token->Type == GLSL_TOK_DFDY || Token->Type == GLSL_TOK_FWIDTH)
+	{
+		if (Context->QuadResults) return Context->QuadResults[Token->QuadIndex];
+
+		if (Token->Args.Size != 1)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		glslToken* TokArg;
+
+		// Without neighbouring lanes the value is constant, so the derivative is zero
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Result = ExecuteGLSLToken(Context, TokArg);
+		Result.x = 0.0f;
+		Result.y = 0.0f;
+		Result.z = 0.0f;
+		Result.w = 0.0f;
+		return Result;
+	}
+	else if (Token->Type == GLSL_TOK_COS)
+	{
+		if (Token->Args.Size != 1)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Result = ExecuteGLSLToken(Context, TokArg);
+		Result.x = swgl_cos(Result.x);
+		Result.y = swgl_cos(Result.y);
+		Result.z = swgl_cos(Result.z);
+		Result.w = swgl_cos(Result.w);
+		return Result;
+	}
+	else if (Token->Type == GLSL_TOK_SIN)
+	{
+		if (Token->Args.Size != 1)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Result = ExecuteGLSLToken(Context, TokArg);
+		Result.x = swgl_sin(Result.x);
+		Result.y = swgl_sin(Result.y);
+		Result.z = swgl_sin(Result.z);
+		Result.w = swgl_sin(Result.w);
+		return Result;
+	}
+	else if (Token->Type == GLSL_TOK_TAN)
+	{
+		if (Token->Args.Size != 1)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Result = ExecuteGLSLToken(Context, TokArg);
+		Result.x = swgl_tan(Result.x);
+		Result.y = swgl_tan(Result.y);
+		Result.z = swgl_tan(Result.z);
+		Result.w = swgl_tan(Result.w);
+		return Result;
+	}
+	else if (Token->Type == GLSL_TOK_MIN)
+	{
+		if (Token->Args.Size != 2)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue FirstResult = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 1);
+		glslExValue SecondResult = ExecuteGLSLToken(Context, TokArg);
+
+		FirstResult.x = MIN(FirstResult.x, SecondResult.x);
+		FirstResult.y = MIN(FirstResult.y, SecondResult.y);
+		FirstResult.z = MIN(FirstResult.z, SecondResult.z);
+		FirstResult.w = MIN(FirstResult.w, SecondResult.w);
+		return FirstResult;
+	}
+	else if (Token->Type == GLSL_TOK_MAX)
+	{
+		if (Token->Args.Size != 2)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue FirstResult = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 1);
+		glslExValue SecondResult = ExecuteGLSLToken(Context, TokArg);
+
+		FirstResult.x = MAX(FirstResult.x, SecondResult.x);
+		FirstResult.y = MAX(FirstResult.y, SecondResult.y);
+		FirstResult.z = MAX(FirstResult.z, SecondResult.z);
+		FirstResult.w = MAX(FirstResult.w, SecondResult.w);
+		return FirstResult;
+	}
+	else if (Token->Type == GLSL_TOK_SWIZZLE)
+	{
+		glslExValue Input = ExecuteGLSLToken(Context, Token->First);
+
+		glslExValue Output;
+
+		for (int i = 0; i < Token->Swizzle.Size; i++)
+		{
+			float CurVal = 0;
+			int CurSwizzle;
+
+			swglVectorRead(&Token->Swizzle, &CurSwizzle, i);
+
+			if (CurSwizzle == 0)
+			{
+				CurVal = Input.x;
+			}
+			else if (CurSwizzle == 1)
+			{
+				CurVal = Input.y;
+			}
+			else if (CurSwizzle == 2)
+			{
+				CurVal = Input.z;
+			}
+			else if (CurSwizzle == 3)
+			{
+				CurVal = Input.w;
+			}
+
+			if (i == 0)
+			{
+				Output.x = CurVal;
+			}
+			else if (i == 1)
+			{
+				Output.y = CurVal;
+			}
+			else if (i == 2)
+			{
+				Output.z = CurVal;
+			}
+			else if (i == 3)
+			{
+				Output.w = CurVal;
+			}
+		}
+
+		if (Token->Swizzle.Size == 0)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			return ExOutput;
+		}
+		else if (Token->Swizzle.Size == 1)
+		{
+			Output.Type = GLSL_FLOAT;
+		}
+		else if (Token->Swizzle.Size == 2)
+		{
+			Output.Type = GLSL_VEC2;
+		}
+		else if (Token->Swizzle.Size == 3)
+		{
+			Output.Type = GLSL_VEC3;
+		}
+		else if (Token->Swizzle.Size == 4)
+		{
+			Output.Type = GLSL_VEC4;
+		}
+		return Output;
+	}
+	else if (Token->Type == GLSL_TOK_FLOAT_CONSTRUCT)
+	{
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Arg0 = ExecuteGLSLToken(Context, TokArg);
+
+		glslExValue ExOutput = { GLSL_FLOAT, Arg0.Type != GLSL_INT ? Arg0.x : (float)Arg0.i };
+		return ExOutput;
+	}
+	else if (Token->Type == GLSL_TOK_VEC2_CONSTRUCT)
+	{
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Arg0 = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 1);
+		glslExValue Arg1 = ExecuteGLSLToken(Context, TokArg);
+
+		glslExValue ExOutput = { GLSL_VEC2,
+			Arg0.Type != GLSL_INT ? Arg0.x : (float)Arg0.i,
+			Arg1.Type != GLSL_INT ? Arg1.x : (float)Arg1.i
+		};
+		return ExOutput;
+	}
+	else if (Token->Type == GLSL_TOK_VEC3_CONSTRUCT)
+	{
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Arg0 = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 1);
+		glslExValue Arg1 = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 2);
+		glslExValue Arg2 = ExecuteGLSLToken(Context, TokArg);
+
+		glslExValue ExOutput = { GLSL_VEC3,
+			Arg0.Type != GLSL_INT ? Arg0.x : (float)Arg0.i,
+			Arg1.Type != GLSL_INT ? Arg1.x : (float)Arg1.i,
+			Arg2.Type != GLSL_INT ? Arg2.x : (float)Arg2.i
+		};
+		return ExOutput;
+	}
+	else if (Token->Type == GLSL_TOK_VEC4_CONSTRUCT)
+	{
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Arg0 = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 1);
+		glslExValue Arg1 = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 2);
+		glslExValue Arg2 = ExecuteGLSLToken(Context, TokArg);
+		swglVectorRead(&Token->Args, &TokArg, 3);
+		glslExValue Arg3 = ExecuteGLSLToken(Context, TokArg);
+
+		glslExValue ExOutput = { GLSL_VEC4,
+			Arg0.Type != GLSL_INT ? Arg0.x : (float)Arg0.i,
+			Arg1.Type != GLSL_INT ? Arg1.x : (float)Arg1.i,
+			Arg2.Type != GLSL_INT ? Arg2.x : (float)Arg2.i,
+			Arg3.Type != GLSL_INT ? Arg3.x : (float)Arg3.i
+		};
+		return ExOutput;
+	}
+	else if (Token->Type == GLSL_TOK_INT_CONSTRUCT)
+	{
+		glslToken* TokArg;
+
+		swglVectorRead(&Token->Args, &TokArg, 0);
+		glslExValue Arg0 = ExecuteGLSLToken(Context, TokArg);
+
+		glslExValue ExOutput = { GLSL_INT, 0.0f, 0.0f, 0.0f, 0.0f, Arg0.Type != GLSL_INT ? (int)Arg0.x : Arg0.i };
+		return ExOutput;
+	}
+}
+
+void ExecuteGLSLFunction(glslContext* Context, glslFunction* Func)
+{
+	for (int i = 0; i < Func->RootScope->Lines.Size; i++)
+	{
+		glslToken* LineTok;
+
+		swglVectorRead(&Func->RootScope->Lines, &LineTok, i);
+
+		if (!LineTok) continue;
+		ExecuteGLSLToken(Context, LineTok);
+	}
+}
+
+void ExecuteGLSL(glslContext* Context, glslTokenized Tokens)
+{
+	for (int i = 0; i < Tokens.Funcs.Size; i++)
+	{
+		glslFunction* Func;
+
+		swglVectorRead(&Tokens.Funcs, &Func, i);
+
+		if (swglStringEquals(Func->Name, "main"))
+		{
+			ExecuteGLSLFunction(Context, Func);
+		}
+	}
+}
+
+/*
+* EXECUTION CONTEXTS
+*/
+
+glslContext NewGLSLContext(glslTokenized* Shader, uint8_t* Uniforms)
+{
+	glslContext Context;
+	Context.Frame = (uint8_t*)malloc(MAX(Shader->FrameSize, 1));
+	Context.Uniforms = Uniforms;
+	Context.QuadResults = 0;
+
+	memset(Context.Frame, 0, MAX(Shader->FrameSize, 1));
+
+	return Context;
+}
+
+void FreeGLSLContext(glslContext* Context)
+{
+	free(Context->Frame);
+	free(Context->QuadResults);
+}
+
+/*
+* 2x2 QUAD EXECUTION
+*
+* Fragments are shaded a quad at a time so that texture and derivative tokens can read
+* their argument in the neighbouring lanes. Every lane has its own context and the lanes
+* run each line in lockstep.
+*/
+
+glslContext NewGLSLQuadLane(glslTokenized* Shader, uint8_t* Uniforms)
+{
+	glslContext Lane = NewGLSLContext(Shader, Uniforms);
+	Lane.QuadResults = (glslExValue*)malloc(sizeof(glslExValue) * MAX(Shader->QuadTokenCount, 1));
+	return Lane;
+}
+
+float GLSLAbs(float x)
+{
+	return x < 0.0f ? -x : x;
+}
+
+// Evaluates the token's arguments in all four lanes, then stores each lane's result in its context
+void GLSLResolveQuadToken(glslToken* Token, glslContext* Lanes)
+{
+	glslExValue Args[2][4];
+	int ArgCount = MIN(Token->Args.Size, 2);
+
+	for (int Lane = 0; Lane < 4; Lane++)
+	{
+		for (int i = 0; i < ArgCount; i++)
+		{
+			glslToken* TokArg;
+			swglVectorRead(&Token->Args, &TokArg, i);
+			Args[i][Lane] = ExecuteGLSLToken(&Lanes[Lane], TokArg);
+		}
+	}
+
+	for (int Lane = 0; Lane < 4; Lane++)
+	{
+		glslExValue* Result = &Lanes[Lane].QuadResults[Token->QuadIndex];
+
+		if (Token->Type == GLSL_TOK_TEXTURE)
+		{
+			if (ArgCount != 2 || Args[0][Lane].Type != GLSL_SAMPLER2D || Args[1][Lane].Type != GLSL_VEC2)
+			{
+				glslExValue ExOutput = { GLSL_UNKNOWN };
+				*Result = ExOutput;
+				continue;
+			}
+
+			Texture2D* Texture = CurrentContext->TextureUnits[Args[0][Lane].i];
+			glslExValue* Coords = Args[1];
+
+			float dsdx = (Coords[Lane | 1].x - Coords[Lane & 2].x) * Texture->Width;
+			float dtdx = (Coords[Lane | 1].y - Coords[Lane & 2].y) * Texture->Height;
+			float dsdy = (Coords[Lane | 2].x - Coords[Lane & 1].x) * Texture->Width;
+			float dtdy = (Coords[Lane | 2].y - Coords[Lane & 1].y) * Texture->Height;
+
+			// Half the log2 of the squared texel footprint is the log2 of the footprint, no sqrt needed
+			float FootprintSq = MAX(dsdx * dsdx + dtdx * dtdx, dsdy * dsdy + dtdy * dtdy);
+			float Lod = FootprintSq > 0.0f ? 0.5f * swgl_log2(FootprintSq) : 0.0f;
+
+			*Result = SampleTexture2D(Texture, Coords[Lane].x, Coords[Lane].y, Lod);
+			continue;
+		}
+
+		if (ArgCount != 1)
+		{
+			glslExValue ExOutput = { GLSL_UNKNOWN };
+			*Result = ExOutput;
+			continue;
+		}
+
+		glslExValue* Values = Args[0];
+
+		// Fine derivatives, taken along the lane's own row and column of the quad
+		glslExValue dx = Values[Lane | 1];
+		dx.x -= Values[Lane & 2].x;
+		dx.y -= Values[Lane & 2].y;
+		dx.z -= Values[Lane & 2].z;
+		dx.w -= Values[Lane & 2].w;
+
+		glslExValue dy = Values[Lane | 2];
+		dy.x -= Values[Lane & 1].x;
+		dy.y -= Values[Lane & 1].y;
+		dy.z -= Values[Lane & 1].z;
+		dy.w -= Values[Lane & 1].w;
+
+		if (Token->Type == GLSL_TOK_DFDX)
+		{
+			*Result = dx;
+		}
+		else if (Token->Type == GLSL_TOK_DFDY)
+		{
+			*Result = dy;
+		}
+		else
+		{
+			*Result = dx;
+			Result->x = GLSLAbs(dx.x) + GLSLAbs(dy.x);
+			Result->y = GLSLAbs(dx.y) + GLSLAbs(dy.y);
+			Result->z = GLSLAbs(dx.z) + GLSLAbs(dy.z);
+			Result->w = GLSLAbs(dx.w) + GLSLAbs(dy.w);
+		}
+	}
+}
+
+// Runs main in the four lane contexts at once, lane n being pixel (x + (n & 1), y + (n >> 1)) of the quad
+void ExecuteGLSLQuad(glslTokenized Tokens, glslContext* Lanes)
+{
+	for (int i = 0; i < Tokens.Funcs.Size; i++)
+	{
+		glslFunction* Func;
+
+		swglVectorRead(&Tokens.Funcs, &Func, i);
+
+		if (!swglStringEquals(Func->Name, "main")) continue;
+
+		for (int j = 0; j < Func->RootScope->Lines.Size; j++)
+		{
+			glslToken* LineTok;
+			_SwglVector QuadTokens;
+
+			swglVectorRead(&Func->RootScope->Lines, &LineTok, j);
+			swglVectorRead(&Func->RootScope->LineQuadTokens, &QuadTokens, j);
+
+			if (!LineTok) continue;
+
+			for (int k = 0; k < QuadTokens.Size; k++)
+			{
+				GLSLResolveQuadToken(((glslToken**)QuadTokens.Data)[k], Lanes);
+			}
+
+			for (int Lane = 0; Lane < 4; Lane++)
+			{
+				ExecuteGLSLToken(&Lanes[Lane], LineTok);
+			}
+		}
+	}
+}
+
+GLuint glCreateShader(GLenum type)
+{
+	FinishRecordedCommands();
+
+	RawShader* Shader = (RawShader*)malloc(sizeof(RawShader));
+	Shader->Type = type;
+	swglVectorPushBack(&CurrentContext->Shaders, &Shader);
+	return CurrentContext->Shaders.Size - 1;
+}
+
+void glShaderSource(GLuint shader, const GLchar* string)
+{
+	if (IsRecording())
+	{
+		int Length = 0;
+		while (string[Length]) Length++;
+
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_SHADER_SOURCE);
+		Command->Ints[0] = shader;
+		Command->Data = CopyCommandData(string, Length + 1);
+		return;
+	}
+
+	_SwglString* ShaderCode = swglCString2String((const char*)string);
+
+	RawShader* TargetShader = ((RawShader**)CurrentContext->Shaders.Data)[shader];
+
+	TargetShader->MyCode = ShaderCode;
+}
+
+void glCompileShader(GLuint shader)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_COMPILE_SHADER);
+		Command->Ints[0] = shader;
+		return;
+	}
+
+	RawShader* TargetShader = ((RawShader**)CurrentContext->Shaders.Data)[shader];
+
+	TargetShader->CompiledData = GLSLTokenize(TargetShader->MyCode);
+	TargetShader->Compiled = 1;
+}
+
+void glDeleteShader(GLuint shader)
+{
+	// Deletion is for bitches;
+}
+
+GLuint glCreateProgram()
+{
+	FinishRecordedCommands();
+
+	Program* NewProgram = (Program*)malloc(sizeof(Program));
+	NewProgram->VertexFragInOut = swglNewVector(sizeof(_VarPair));
+	NewProgram->FeedbackNames = swglNewVector(sizeof(_SwglString*));
+	NewProgram->FeedbackVars = swglNewVector(sizeof(glslVariable*));
+	NewProgram->FeedbackFloats = 0;
+	NewProgram->Linked = 0;
+	NewProgram->LinkCount = 0;
+	swglVectorPushBack(&CurrentContext->Programs, &NewProgram);
+	return CurrentContext->Programs.Size;
+}
+
+void glAttachShader(GLuint program, GLuint shader)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_ATTACH_SHADER);
+		Command->Ints[0] = program;
+		Command->Ints[1] = shader;
+		return;
+	}
+
+	Program* MyProgram;
+	RawShader* MyShader;
+
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, program - 1);
+	swglVectorRead(&CurrentContext->Shaders, &MyShader, shader);
+
+	if (MyShader->Type == GL_VERTEX_SHADER)
+	{
+		MyProgram->HasVertex = 1;
+		MyProgram->VertexShader = MyShader->CompiledData;
+	}
+	if (MyShader->Type == GL_FRAGMENT_SHADER)
+	{
+		MyProgram->HasFrag = 1;
+		MyProgram->FragmentShader = MyShader->CompiledData;
+	}
+}
+
+void glLinkProgram(GLuint program)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_LINK_PROGRAM);
+		Command->Ints[0] = program;
+		return;
+	}
+
+	// Raster jobs share the program's varying and uniform lists, which relinking rebuilds
+	FinishRasterBatches();
+
+	Program* MyProgram;
+
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, program - 1);
+
+	// Everything linking builds is built again, so a relink, like one for new transform feedback varyings, starts clean
+	MyProgram->VertexFragInOut.Size = 0;
+
+	if (MyProgram->Linked)
+	{
+		swglVectorFree(&MyProgram->Uniforms);
+		swglVectorFree(&MyProgram->Layouts);
+		free(MyProgram->UniformBlock);
+	}
+
+	_SwglVector VertOuts = swglNewVector(sizeof(glslVariable*));
+	_SwglVector FragIns = swglNewVector(sizeof(glslVariable*));
+
+	_SwglVector Uniforms = swglNewVector(sizeof(glslVariable*));
+	_SwglVector Layouts = swglNewVector(sizeof(glslVariable*));
+
+	MyProgram->InstanceIDVar = 0;
+
+	for (int i = 0; i < MyProgram->VertexShader.GlobalVars.Size; i++)
+	{
+		glslVariable* VertVar;
+
+		swglVectorRead(&MyProgram->VertexShader.GlobalVars, &VertVar, i);
+
+		if (VertVar->isOut) swglVectorPushBack(&VertOuts, &VertVar);
+		if (VertVar->isUniform) swglVectorPushBack(&Uniforms, &VertVar);
+		if (VertVar->isLayout) swglVectorPushBack(&Layouts, &VertVar);
+		if (swglStringEquals(VertVar->Name, "gl_Position")) MyProgram->PositionVar = VertVar;
+		if (swglStringEquals(VertVar->Name, "gl_InstanceID")) MyProgram->InstanceIDVar = VertVar;
+	}
+
+	MyProgram->VertexUniformCount = Uniforms.Size;
+	MyProgram->FragmentOut = 0;
+
+	// Captured in the order they were named, every name has to be an output or nothing is captured
+	MyProgram->FeedbackVars.Size = 0;
+	MyProgram->FeedbackFloats = 0;
+
+	for (int i = 0; i < MyProgram->FeedbackNames.Size; i++)
+	{
+		_SwglString* Name = ((_SwglString**)MyProgram->FeedbackNames.Data)[i];
+		glslVariable* Captured = 0;
+
+		for (int j = 0; j < MyProgram->VertexShader.GlobalVars.Size; j++)
+		{
+			glslVariable* VertVar = ((glslVariable**)MyProgram->VertexShader.GlobalVars.Data)[j];
+			if ((VertVar->isOut || VertVar == MyProgram->PositionVar) && swglStringEquals(VertVar->Name, swglString2CString(Name))) Captured = VertVar;
+		}
+
+		if (!Captured)
+		{
+			MyProgram->FeedbackVars.Size = 0;
+			MyProgram->FeedbackFloats = 0;
+			break;
+		}
+
+		swglVectorPushBack(&MyProgram->FeedbackVars, &Captured);
+		MyProgram->FeedbackFloats += GLSLTypeSize(Captured->Type) / sizeof(float);
+	}
+
+	for (int i = 0; i < MyProgram->FragmentShader.GlobalVars.Size; i++)
+	{
+		glslVariable* FragVar;
+
+		swglVectorRead(&MyProgram->FragmentShader.GlobalVars, &FragVar, i);
+
+		if (FragVar->isIn) swglVectorPushBack(&FragIns, &FragVar);
+		if (FragVar->isUniform) swglVectorPushBack(&Uniforms, &FragVar);
+		if (FragVar->isOut && !MyProgram->FragmentOut) MyProgram->FragmentOut = FragVar;
+	}
+
+	MyProgram->Uniforms = Uniforms;
+	MyProgram->Layouts = Layouts;
+
+	int UniformBlockSize = MAX(MyProgram->VertexShader.UniformSize + MyProgram->FragmentShader.UniformSize, 1);
+	MyProgram->UniformBlock = (uint8_t*)malloc(UniformBlockSize);
+	memset(MyProgram->UniformBlock, 0, UniformBlockSize);
+
+	for (int i = 0; i < FragIns.Size; i++)
+	{
+		glslVariable* FragIn;
+
+		swglVectorRead(&FragIns, &FragIn, i);
+
+		uint8_t LinkedPair = 0;
+
+		for (int j = 0; j < VertOuts.Size; j++)
+		{
+			glslVariable* VertOut;
+
+			swglVectorRead(&VertOuts, &VertOut, j);
+
+			if (swglStringEquals(FragIn->Name, swglString2CString(VertOut->Name)))
+			{
+				_VarPair AddPair = { FragIn, VertOut };
+				swglVectorPushBack(&MyProgram->VertexFragInOut, &AddPair);
+				LinkedPair = 1;
+				break;
+			}
+		}
+	}
+
+	swglVectorFree(&VertOuts);
+	swglVectorFree(&FragIns);
+
+	MyProgram->Linked = 1;
+	MyProgram->LinkCount++;
+}
+
+uint8_t* VertexUniforms(Program* MyProgram)
+{
+	return MyProgram->UniformBlock;
+}
+
+uint8_t* FragmentUniforms(Program* MyProgram)
+{
+	return MyProgram->UniformBlock + MyProgram->VertexShader.UniformSize;
+}
+
+// Where glUniform* stores the value of the uniform at Index in MyProgram->Uniforms
+void* ProgramUniformData(Program* MyProgram, int Index)
+{
+	glslVariable* Uniform = ((glslVariable**)MyProgram->Uniforms.Data)[Index];
+
+	if (Index < MyProgram->VertexUniformCount) return VertexUniforms(MyProgram) + Uniform->Slot;
+	return FragmentUniforms(MyProgram) + Uniform->Slot;
+}
+
+void glUseProgram(GLuint program)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_USE_PROGRAM);
+		Command->Ints[0] = program;
+		return;
+	}
+
+	// Captured vertices are laid out by the program transform feedback began with
+	if (CurrentContext->TransformFeedbackActive) return;
+
+	if (program == 0) CurrentContext->ActiveProgram = 0;
+	else swglVectorRead(&CurrentContext->Programs, &CurrentContext->ActiveProgram, program - 1);
+}
+
+void glTransformFeedbackVaryings(GLuint program, GLsizei count, const GLchar* const* varyings, GLenum bufferMode)
+{
+	// Program setup, so it waits for the recorded calls instead of copying the names into a command
+	FinishRecordedCommands();
+
+	if (program == 0 || (int)program > CurrentContext->Programs.Size) return;
+	if (bufferMode != GL_INTERLEAVED_ATTRIBS) return;
+
+	Program* MyProgram = ((Program**)CurrentContext->Programs.Data)[program - 1];
+
+	for (int i = 0; i < MyProgram->FeedbackNames.Size; i++)
+	{
+		_SwglString* Name = ((_SwglString**)MyProgram->FeedbackNames.Data)[i];
+		free(Name->Data);
+		free(Name);
+	}
+
+	MyProgram->FeedbackNames.Size = 0;
+
+	for (GLsizei i = 0; i < count; i++)
+	{
+		_SwglString* Name = swglCString2String(varyings[i]);
+		swglVectorPushBack(&MyProgram->FeedbackNames, &Name);
+	}
+}
+
+GLuint glGenVertexArrays(GLsizei n, GLuint* arrays)
+{
+	FinishRecordedCommands();
+
+	// Only supports one vertex array per call for now
+	*arrays = CurrentContext->VertexArrays.Size + 1;
+
+	VertexArray* VertArray = (VertexArray*)malloc(sizeof(VertexArray));
+	VertArray->Attribs = swglNewVector(sizeof(VertexArrayAttrib));
+	VertArray->ElementBuffer = 0;
+	VertArray->VertexBuffer = 0;
+	VertArray->Plan.BuiltFor = 0;
+	VertArray->Plan.Fetches = swglNewVector(sizeof(AttributeFetch));
+
+	swglVectorPushBack(&CurrentContext->VertexArrays, &VertArray);
+	return 0;
+}
+
+void glBindVertexArray(GLuint array)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BIND_VERTEX_ARRAY);
+		Command->Ints[0] = array;
+		return;
+	}
+
+	if (array == 0) CurrentContext->ActiveVertexArray = 0;
+	else swglVectorRead(&CurrentContext->VertexArrays, &CurrentContext->ActiveVertexArray, array - 1);
+}
+
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_VERTEX_ATTRIB_POINTER);
+		Command->Ints[0] = index;
+		Command->Ints[1] = size;
+		Command->Ints[2] = normalized;
+		Command->Ints[3] = stride;
+		Command->Enums[0] = type;
+		Command->Pointer = (void*)pointer; // An offset into the bound buffer
+		return;
+	}
+
+	if (CurrentContext->ActiveVertexArray)
+	{
+		VertexArrayAttrib Attrib;
+
+		Attrib.index = index;
+		Attrib.normalized = normalized;
+		Attrib.offset = (int)pointer;
+		Attrib.size = size;
+		Attrib.stride = stride;
+		Attrib.type = type;
+		Attrib.divisor = 0;
+
+		// Respecifying an attribute overwrites its entry and keeps its divisor
+		VertexArrayAttrib* Previous = 0;
+
+		for (int i = 0; i < CurrentContext->ActiveVertexArray->Attribs.Size; i++)
+		{
+			VertexArrayAttrib* Candidate = (VertexArrayAttrib*)CurrentContext->ActiveVertexArray->Attribs.Data + i;
+			if (Candidate->index == index) Previous = Candidate;
+		}
+
+		if (Previous)
+		{
+			Attrib.divisor = Previous->divisor;
+			*Previous = Attrib;
+		}
+		else
+		{
+			swglVectorPushBack(&CurrentContext->ActiveVertexArray->Attribs, &Attrib);
+		}
+
+		CurrentContext->ActiveVertexArray->Plan.BuiltFor = 0;
+	}
+}
+
+void glVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_VERTEX_ATTRIB_DIVISOR);
+		Command->Ints[0] = index;
+		Command->Ints[1] = divisor;
+		return;
+	}
+
+	if (!CurrentContext->ActiveVertexArray) return;
+
+	for (int i = 0; i < CurrentContext->ActiveVertexArray->Attribs.Size; i++)
+	{
+		VertexArrayAttrib* Attrib = (VertexArrayAttrib*)CurrentContext->ActiveVertexArray->Attribs.Data + i;
+		if (Attrib->index == index) Attrib->divisor = divisor;
+	}
+
+	CurrentContext->ActiveVertexArray->Plan.BuiltFor = 0;
+}
+
+/*
+* BUFFER STORAGE
+* Buffer structs and the storage of buffer objects come from a per-context pool of size classes, so buffers
+* created, respecified and deleted every frame reuse the same blocks instead of going through malloc each time
+*/
+
+// Smallest size class of at least Size bytes, -1 when the storage is allocated on its own
+int BufferSizeClass(size_t Size)
+{
+	for (int Class = 0; Class < SWGL_BUFFER_CLASSES; Class++)
+	{
+		if (Size <= (size_t)SWGL_BUFFER_ALIGN << Class) return Class;
+	}
+
+	return -1;
+}
+
+// Bytes of the block holding Size bytes of storage
+size_t BufferBlockSize(size_t Size)
+{
+	int Class = BufferSizeClass(Size);
+	return Class < 0 ? Size : (size_t)SWGL_BUFFER_ALIGN << Class;
+}
+
+// Rounds up to SWGL_BUFFER_ALIGN. malloc's own alignment leaves at least a pointer's room below the result
+uint8_t* AlignBufferBlock(uint8_t* Raw)
+{
+	return Raw + SWGL_BUFFER_ALIGN - ((uintptr_t)Raw & (SWGL_BUFFER_ALIGN - 1));
+}
+
+void* AllocBufferBlock(BufferPool* Pool, size_t Size)
+{
+	int Class = BufferSizeClass(Size);
+
+	if (Class < 0)
+	{
+		uint8_t* Raw = (uint8_t*)malloc(Size + SWGL_BUFFER_ALIGN);
+		uint8_t* Block = AlignBufferBlock(Raw);
+		((void**)Block)[-1] = Raw;
+		return Block;
+	}
+
+	if (!Pool->FreeBlocks[Class])
+	{
+		size_t BlockSize = BufferBlockSize(Size);
+		uint8_t* Slab = (uint8_t*)malloc(SWGL_BUFFER_SLAB_SIZE + SWGL_BUFFER_ALIGN);
+		uint8_t* First = AlignBufferBlock(Slab);
+
+		swglVectorPushBack(&Pool->Slabs, &Slab);
+
+		for (size_t Offset = 0; Offset + BlockSize <= SWGL_BUFFER_SLAB_SIZE; Offset += BlockSize)
+		{
+			*(void**)(First + Offset) = Pool->FreeBlocks[Class];
+			Pool->FreeBlocks[Class] = First + Offset;
+		}
+	}
+
+	void* Block = Pool->FreeBlocks[Class];
+	Pool->FreeBlocks[Class] = *(void**)Block;
+	return Block;
+}
+
+// Size is the one the block was allocated for, or any other of the same class
+void FreeBufferBlock(BufferPool* Pool, void* Block, size_t Size)
+{
+	if (!Block) return;
+
+	int Class = BufferSizeClass(Size);
+
+	if (Class < 0)
+	{
+		free(((void**)Block)[-1]);
+		return;
+	}
+
+	*(void**)Block = Pool->FreeBlocks[Class];
+	Pool->FreeBlocks[Class] = Block;
+}
+
+GLuint glGenBuffers(GLsizei n, GLuint* buffers)
+{
+	FinishRecordedCommands();
+
+	// Only supports 1 buffer per call for now
+	Buffer* NewBuffer = (Buffer*)AllocBufferBlock(&CurrentContext->BufferPool, sizeof(Buffer));
+
+	NewBuffer->data = 0;
+	NewBuffer->size = 0;
+	NewBuffer->mapped = 0;
+	NewBuffer->external = 0;
+
+	if (CurrentContext->FreeBufferNames.Size)
+	{
+		swglVectorRead(&CurrentContext->FreeBufferNames, buffers, CurrentContext->FreeBufferNames.Size - 1);
+		swglVectorPopBack(&CurrentContext->FreeBufferNames);
+		swglVectorWrite(&CurrentContext->Buffers, &NewBuffer, *buffers - 1);
+		return 0;
+	}
+
+	swglVectorPushBack(&CurrentContext->Buffers, &NewBuffer);
+	*buffers = CurrentContext->Buffers.Size;
+	return 0;
+}
+
+void glDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_DELETE_BUFFERS);
+		Command->Ints[0] = n;
+		Command->Data = CopyCommandData(buffers, sizeof(GLuint) * n);
+		return;
+	}
+
+	for (GLsizei i = 0; i < n; i++)
+	{
+		GLuint Name = buffers[i];
+
+		if (Name == 0 || Name > (GLuint)CurrentContext->Buffers.Size) continue;
+
+		Buffer* MyBuffer = ((Buffer**)CurrentContext->Buffers.Data)[Name - 1];
+
+		if (!MyBuffer) continue;
+
+		// Unbound from every binding, vertex arrays that are not bound included, so nothing keeps a freed buffer
+		if (CurrentContext->ArrayBuffer == MyBuffer) CurrentContext->ArrayBuffer = 0;
+		if (CurrentContext->DrawIndirectBuffer == MyBuffer) CurrentContext->DrawIndirectBuffer = 0;
+		if (CurrentContext->TransformFeedbackBuffer == MyBuffer) CurrentContext->TransformFeedbackBuffer = 0;
+
+		for (int j = 0; j < CurrentContext->VertexArrays.Size; j++)
+		{
+			VertexArray* VertArray = ((VertexArray**)CurrentContext->VertexArrays.Data)[j];
+			if (VertArray->VertexBuffer == MyBuffer) VertArray->VertexBuffer = 0;
+			if (VertArray->ElementBuffer == MyBuffer) VertArray->ElementBuffer = 0;
+		}
+
+		// Draws have finished reading it by the time they return
+		if (!MyBuffer->external) FreeBufferBlock(&CurrentContext->BufferPool, MyBuffer->data, MyBuffer->size);
+		FreeBufferBlock(&CurrentContext->BufferPool, MyBuffer, sizeof(Buffer));
+
+		((Buffer**)CurrentContext->Buffers.Data)[Name - 1] = 0;
+		swglVectorPushBack(&CurrentContext->FreeBufferNames, &Name);
+	}
+}
+
+void glBindBuffer(GLenum type, GLuint buffer)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BIND_BUFFER);
+		Command->Enums[0] = type;
+		Command->Ints[0] = buffer;
+		return;
+	}
+
+	if (type == GL_ARRAY_BUFFER)
+	{
+		if (buffer == 0)
+		{
+			CurrentContext->ArrayBuffer = 0;
+			return;
+		}
+
+		Buffer* TargetBuffer;
+
+		swglVectorRead(&CurrentContext->Buffers, &TargetBuffer, buffer - 1);
+
+		CurrentContext->ArrayBuffer = TargetBuffer;
+
+		if (CurrentContext->ActiveVertexArray) CurrentContext->ActiveVertexArray->VertexBuffer = TargetBuffer;
+	}
+	else if (type == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		// Part of the vertex array's state, there is nothing to bind it to without one
+		if (!CurrentContext->ActiveVertexArray) return;
+
+		Buffer* TargetBuffer = 0;
+
+		if (buffer != 0) swglVectorRead(&CurrentContext->Buffers, &TargetBuffer, buffer - 1);
+
+		CurrentContext->ActiveVertexArray->ElementBuffer = TargetBuffer;
+	}
+	else if (type == GL_DRAW_INDIRECT_BUFFER)
+	{
+		Buffer* TargetBuffer = 0;
+
+		if (buffer != 0) swglVectorRead(&CurrentContext->Buffers, &TargetBuffer, buffer - 1);
+
+		CurrentContext->DrawIndirectBuffer = TargetBuffer;
+	}
+	else if (type == GL_TRANSFORM_FEEDBACK_BUFFER)
+	{
+		// Draws are writing to it
+		if (CurrentContext->TransformFeedbackActive) return;
+
+		Buffer* TargetBuffer = 0;
+
+		if (buffer != 0) swglVectorRead(&CurrentContext->Buffers, &TargetBuffer, buffer - 1);
+
+		CurrentContext->TransformFeedbackBuffer = TargetBuffer;
+	}
+}
+
+// There is a single transform feedback binding, so this binds the same buffer as glBindBuffer
+void glBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BIND_BUFFER_BASE);
+		Command->Enums[0] = target;
+		Command->Ints[0] = index;
+		Command->Ints[1] = buffer;
+		return;
+	}
+
+	if (target != GL_TRANSFORM_FEEDBACK_BUFFER || index != 0) return;
+
+	glBindBuffer(target, buffer);
+}
+
+Buffer* GetBoundBuffer(GLenum target)
+{
+	if (target == GL_ARRAY_BUFFER) return CurrentContext->ArrayBuffer;
+	if (target == GL_ELEMENT_ARRAY_BUFFER && CurrentContext->ActiveVertexArray) return CurrentContext->ActiveVertexArray->ElementBuffer;
+	if (target == GL_DRAW_INDIRECT_BUFFER) return CurrentContext->DrawIndirectBuffer;
+	if (target == GL_TRANSFORM_FEEDBACK_BUFFER) return CurrentContext->TransformFeedbackBuffer;
+	return 0;
+}
+
+void glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BUFFER_DATA);
+		Command->Enums[0] = target;
+		Command->Enums[1] = usage;
+		Command->Sizes[0] = size;
+		Command->Data = CopyCommandData(data, size);
+		return;
+	}
+
+	Buffer* MyBuffer = GetBoundBuffer(target);
+
+	if (!MyBuffer || size < 0) return;
+
+	// Draws have read the old contents by the time they return, so storage is reused in place while the new size fits the same block
+	if (MyBuffer->external || !MyBuffer->data || BufferBlockSize(MyBuffer->size) != BufferBlockSize(size))
+	{
+		if (!MyBuffer->external) FreeBufferBlock(&CurrentContext->BufferPool, MyBuffer->data, MyBuffer->size);
+		MyBuffer->data = size ? AllocBufferBlock(&CurrentContext->BufferPool, size) : 0;
+		MyBuffer->external = 0;
+	}
+
+	MyBuffer->size = size;
+
+	if (data) memcpy(MyBuffer->data, data, size);
+
+	MyBuffer->mapped = 0;
+}
+
+void swglBufferStorageExternal(GLenum target, GLsizeiptr size, void* data)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BUFFER_STORAGE_EXTERNAL);
+		Command->Enums[0] = target;
+		Command->Sizes[0] = size;
+		Command->Pointer = data; // Read by the draws that use it, never copied
+		return;
+	}
+
+	Buffer* MyBuffer = GetBoundBuffer(target);
+
+	if (!MyBuffer || size < 0) return;
+
+	if (!MyBuffer->external) FreeBufferBlock(&CurrentContext->BufferPool, MyBuffer->data, MyBuffer->size);
+
+	MyBuffer->data = data;
+	MyBuffer->size = size;
+	MyBuffer->mapped = 0;
+	MyBuffer->external = 1;
+}
+
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BUFFER_SUB_DATA);
+		Command->Enums[0] = target;
+		Command->Sizes[0] = offset;
+		Command->Sizes[1] = size;
+		Command->Data = CopyCommandData(data, size);
+		return;
+	}
+
+	Buffer* MyBuffer = GetBoundBuffer(target);
+
+	if (!MyBuffer || MyBuffer->mapped || !data) return;
+	if (offset < 0 || size < 0 || offset + size > MyBuffer->size) return;
+
+	memcpy((uint8_t*)MyBuffer->data + offset, data, size);
+}
+
+// Recorded calls may still bind, respecify or draw from the buffer, so maps wait for them, unsynchronized ones included.
+// A write only map that invalidates does not: it gets fresh storage, copied into the buffer when unmapped, and its
+// range is only checked then. Draws read vertex data while they run, so after the wait nothing else uses the buffer
+void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	uint8_t Invalidates = (access & (GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)) != 0;
+
+	if (IsRecording() && Invalidates && !(access & GL_MAP_READ_BIT) && !CurrentContext->StagedMap)
+	{
+		if (offset < 0 || length <= 0 || !(access & GL_MAP_WRITE_BIT)) return 0;
+
+		CurrentContext->StagedMap = malloc(length);
+		CurrentContext->StagedMapTarget = target;
+		CurrentContext->StagedMapOffset = offset;
+		CurrentContext->StagedMapLength = length;
+		return CurrentContext->StagedMap;
+	}
+
+	FinishRecordedCommands();
+
+	Buffer* MyBuffer = GetBoundBuffer(target);
+
+	if (!MyBuffer || MyBuffer->mapped) return 0;
+	if (offset < 0 || length <= 0 || offset + length > MyBuffer->size) return 0;
+	if (!(access & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT))) return 0;
+
+	// Orphaned like a respecification, the application's memory is left alone and the buffer gets its own storage back
+	if (access & GL_MAP_INVALIDATE_BUFFER_BIT)
+	{
+		void* Fresh = AllocBufferBlock(&CurrentContext->BufferPool, MyBuffer->size);
+		if (!MyBuffer->external) FreeBufferBlock(&CurrentContext->BufferPool, MyBuffer->data, MyBuffer->size);
+		MyBuffer->data = Fresh;
+		MyBuffer->external = 0;
+	}
+
+	MyBuffer->mapped = 1;
+
+	return (uint8_t*)MyBuffer->data + offset;
+}
+
+GLboolean glUnmapBuffer(GLenum target)
+{
+	if (CurrentContext->StagedMap && target == CurrentContext->StagedMapTarget)
+	{
+		void* Staged = CurrentContext->StagedMap;
+		CurrentContext->StagedMap = 0;
+
+		if (!IsRecording())
+		{
+			glBufferSubData(target, CurrentContext->StagedMapOffset, CurrentContext->StagedMapLength, Staged);
+			free(Staged);
+			return GL_TRUE;
+		}
+
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BUFFER_SUB_DATA);
+		Command->Enums[0] = target;
+		Command->Sizes[0] = CurrentContext->StagedMapOffset;
+		Command->Sizes[1] = CurrentContext->StagedMapLength;
+		Command->Data = Staged; // Freed once it has executed
+		return GL_TRUE;
+	}
+
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNMAP_BUFFER);
+		Command->Enums[0] = target;
+		return GL_TRUE;
+	}
+
+	Buffer* MyBuffer = GetBoundBuffer(target);
+
+	if (!MyBuffer || !MyBuffer->mapped) return GL_FALSE;
+
+	MyBuffer->mapped = 0;
+	return GL_TRUE;
+}
+
+
+
+// In pixels from the sample point of single sampled rendering, the standard 4x and 8x patterns
+const float SampleOffsets1[1][2] = { { 0.0f, 0.0f } };
+const float SampleOffsets4[4][2] = { { -0.125f, -0.375f }, { 0.375f, -0.125f }, { -0.375f, 0.125f }, { 0.125f, 0.375f } };
+const float SampleOffsets8[8][2] = {
+	{ 0.0625f, -0.1875f }, { -0.0625f, 0.1875f }, { 0.3125f, 0.0625f }, { -0.1875f, -0.3125f },
+	{ -0.3125f, 0.3125f }, { -0.4375f, -0.0625f }, { 0.1875f, 0.4375f }, { 0.4375f, -0.4375f },
+};
+
+const float (*GetSampleOffsets(GLsizei Samples))[2]
+{
+	if (Samples == 4) return SampleOffsets4;
+	if (Samples == 8) return SampleOffsets8;
+	return SampleOffsets1;
+}
+
+// All samples of a pixel, for rasterization that only tests the pixel's centre
+uint8_t FullSampleMask()
+{
+	return (uint8_t)((1 << CurrentContext->Framebuffer->Samples) - 1);
+}
+
+uint8_t IsMultisampling()
+{
+	return CurrentContext->Framebuffer->Samples > 1 && CurrentContext->MultisampleEnabled;
+}
+
+void SetFramebufferSamples(Framebuffer* Target, GLsizei Samples)
+{
+	if (Target->Samples > 1)
+	{
+		free(Target->SampleColor);
+		free(Target->SampleDepth);
+	}
+
+	Target->Samples = Samples;
+
+	if (Samples == 1)
+	{
+		Target->SampleColor = Target->ColorAttachment;
+		Target->SampleDepth = Target->DepthAttachment;
+		return;
+	}
+
+	Target->SampleColor = (uint32_t*)malloc(4 * Target->Width * Target->Height * Samples);
+	Target->SampleDepth = malloc(sizeof(float) * Target->Width * Target->Height * Samples);
+}
+
+void swglSetSampleCount(GLsizei samples)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_SET_SAMPLE_COUNT);
+		Command->Ints[0] = samples;
+		return;
+	}
+
+	if (samples != 1 && samples != 4 && samples != 8) return;
+
+	FinishRasterBatches();
+
+	for (int i = 0; i < CurrentContext->SwapBufferCount; i++) SetFramebufferSamples(CurrentContext->SwapChain[i], samples);
+}
+
+GLsizei swglGetSampleCount()
+{
+	FinishRecordedCommands();
+
+	return CurrentContext->Framebuffer->Samples;
+}
+
+// Averages each pixel's samples into ColorAttachment, rounding to nearest
+void ResolveFramebuffer()
+{
+	Framebuffer* Target = CurrentContext->Framebuffer;
+
+	uint32_t* Src = Target->SampleColor;
+	uint32_t* Dst = Target->ColorAttachment;
+	int PixelCount = Target->Width * Target->Height;
+	int Samples = Target->Samples;
+	int Shift = Samples == 8 ? 3 : 2;
+
+#ifdef __SSE2__
+	__m128i Zero = _mm_setzero_si128();
+	__m128i Round = _mm_set1_epi16(Samples / 2);
+	__m128i ShiftCount = _mm_cvtsi32_si128(Shift);
+
+	for (int i = 0; i < PixelCount; i++, Src += Samples)
+	{
+		// Channels widened to 16 bits, four samples per load summed into two pixels' worth of lanes
+		__m128i Sum = Zero;
+
+		for (int j = 0; j < Samples; j += 4)
+		{
+			__m128i Texels = _mm_loadu_si128((__m128i*)(Src + j));
+			Sum = _mm_add_epi16(Sum, _mm_unpacklo_epi8(Texels, Zero));
+			Sum = _mm_add_epi16(Sum, _mm_unpackhi_epi8(Texels, Zero));
+		}
+
+		Sum = _mm_add_epi16(Sum, _mm_srli_si128(Sum, 8));
+		Sum = _mm_srl_epi16(_mm_add_epi16(Sum, Round), ShiftCount);
+		Dst[i] = _mm_cvtsi128_si32(_mm_packus_epi16(Sum, Sum));
+	}
+#else
+	for (int i = 0; i < PixelCount; i++, Src += Samples)
+	{
+		uint32_t Color = 0;
+
+		for (int Channel = 0; Channel < 32; Channel += 8)
+		{
+			uint32_t Sum = Samples / 2;
+			for (int j = 0; j < Samples; j++) Sum += (Src[j] >> Channel) & 0xFF;
+			Color |= (Sum >> Shift) << Channel;
+		}
+
+		Dst[i] = Color;
+	}
+#endif
+}
+
+void glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_CLEAR_COLOR);
+		Command->Floats[0] = red;
+		Command->Floats[1] = green;
+		Command->Floats[2] = blue;
+		Command->Floats[3] = alpha;
+		return;
+	}
+
+	CurrentContext->ClearColorRed = MIN(MAX(red, 0.0f), 1.0f);
+	CurrentContext->ClearColorGreen = MIN(MAX(green, 0.0f), 1.0f);
+	CurrentContext->ClearColorBlue = MIN(MAX(blue, 0.0f), 1.0f);
+	CurrentContext->ClearColorAlpha = MIN(MAX(alpha, 0.0f), 1.0f);
+}
+
+void glClear(GLuint flags)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_CLEAR);
+		Command->Ints[0] = flags;
+		return;
+	}
+
+	FinishRasterBatches();
+
+	Framebuffer* Target = CurrentContext->Framebuffer;
+
+	if (flags & GL_COLOR_BUFFER_BIT)
+	{
+		uint32_t ClearColor = 0;
+		ClearColor |= (uint32_t)(CurrentContext->ClearColorRed * 255) << 24;
+		ClearColor |= (uint32_t)(CurrentContext->ClearColorGreen * 255) << 16;
+		ClearColor |= (uint32_t)(CurrentContext->ClearColorBlue * 255) << 8;
+		ClearColor |= (uint32_t)(CurrentContext->ClearColorAlpha * 255);
+
+		int Samples = Target->Samples;
+
+		for (int y = MAX(CurrentContext->ViewportY, 0); y < MIN(CurrentContext->ViewportY + CurrentContext->ViewportHeight, Target->Height); y++)
+		{
+			for (int x = MAX(CurrentContext->ViewportX, 0); x < MIN(CurrentContext->ViewportX + CurrentContext->ViewportWidth, Target->Width); x++)
+			{
+				for (int i = 0; i < Samples; i++) Target->SampleColor[(y * Target->Width + x) * Samples + i] = ClearColor;
+			}
+		}
+	}
+	if (flags & GL_DEPTH_BUFFER_BIT)
+	{
+		if (Target->DepthFormat == GL_FLOAT)
+		{
+			int Samples = Target->Samples;
+
+			for (int y = MAX(CurrentContext->ViewportY, 0); y < MIN(CurrentContext->ViewportY + CurrentContext->ViewportHeight, Target->Height); y++)
+			{
+				for (int x = MAX(CurrentContext->ViewportX, 0); x < MIN(CurrentContext->ViewportX + CurrentContext->ViewportWidth, Target->Width); x++)
+				{
+					for (int i = 0; i < Samples; i++) ((GLfloat*)Target->SampleDepth)[(y * Target->Width + x) * Samples + i] = 0.0f;
+				}
+			}
 		}
 	}
 }
 
-void glActiveTexture(GLenum target)
+void glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_VIEWPORT);
+		Command->Ints[0] = x;
+		Command->Ints[1] = y;
+		Command->Ints[2] = width;
+		Command->Ints[3] = height;
+		return;
+	}
+
+	CurrentContext->ViewportX = x;
+	CurrentContext->ViewportY = y;
+	CurrentContext->ViewportWidth = width;
+	CurrentContext->ViewportHeight = height;
+}
+
+void swglGetTriangleStats(swglTriangleStats* stats)
+{
+	FinishRecordedCommands();
+
+	// Coverage is counted as batches retire
+	FinishRasterBatches();
+
+	*stats = CurrentContext->TriangleStats;
+}
+
+void swglResetTriangleStats()
+{
+	if (IsRecording())
+	{
+		RecordCommand(SWGL_CMD_RESET_TRIANGLE_STATS);
+		return;
+	}
+
+	FinishRasterBatches();
+
+	memset(&CurrentContext->TriangleStats, 0, sizeof(CurrentContext->TriangleStats));
+}
+
+void swglGetVertexStats(swglVertexStats* stats)
+{
+	FinishRecordedCommands();
+
+	*stats = CurrentContext->VertexStats;
+}
+
+void swglResetVertexStats()
+{
+	if (IsRecording())
+	{
+		RecordCommand(SWGL_CMD_RESET_VERTEX_STATS);
+		return;
+	}
+
+	memset(&CurrentContext->VertexStats, 0, sizeof(CurrentContext->VertexStats));
+}
+
+void glEnable(GLenum cap)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_ENABLE);
+		Command->Enums[0] = cap;
+		return;
+	}
+
+	if (cap == GL_CULL_FACE) CurrentContext->CullFaceEnabled = 1;
+	else if (cap == GL_MULTISAMPLE) CurrentContext->MultisampleEnabled = 1;
+	else if (cap == GL_RASTERIZER_DISCARD) CurrentContext->RasterizerDiscard = 1;
+}
+
+void glDisable(GLenum cap)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_DISABLE);
+		Command->Enums[0] = cap;
+		return;
+	}
+
+	if (cap == GL_CULL_FACE) CurrentContext->CullFaceEnabled = 0;
+	else if (cap == GL_MULTISAMPLE) CurrentContext->MultisampleEnabled = 0;
+	else if (cap == GL_RASTERIZER_DISCARD) CurrentContext->RasterizerDiscard = 0;
+}
+
+void glCullFace(GLenum mode)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_CULL_FACE);
+		Command->Enums[0] = mode;
+		return;
+	}
+
+	if (mode != GL_FRONT && mode != GL_BACK && mode != GL_FRONT_AND_BACK) return;
+	CurrentContext->CullFaceMode = mode;
+}
+
+void glFrontFace(GLenum mode)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_FRONT_FACE);
+		Command->Enums[0] = mode;
+		return;
+	}
+
+	if (mode != GL_CW && mode != GL_CCW) return;
+	CurrentContext->FrontFaceMode = mode;
+}
+
+void glLineWidth(GLfloat width)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_LINE_WIDTH);
+		Command->Floats[0] = width;
+		return;
+	}
+
+	if (!(width > 0.0f)) return;
+	CurrentContext->LineWidth = width;
+}
+
+// Determinant of the clip-space (x, y, w) rows, it has the sign of the projected area
+// and stays correct when a vertex is behind the eye, so no divide or near clip is needed first
+float TriangleFacingDet(glslVec4* Verts)
+{
+	return Verts[0].x * (Verts[1].y * Verts[2].w - Verts[2].y * Verts[1].w)
+		- Verts[0].y * (Verts[1].x * Verts[2].w - Verts[2].x * Verts[1].w)
+		+ Verts[0].w * (Verts[1].x * Verts[2].y - Verts[2].x * Verts[1].y);
+}
+
+uint8_t IsTriangleCulled(float Det)
+{
+	if (!CurrentContext->CullFaceEnabled) return 0;
+	if (CurrentContext->CullFaceMode == GL_FRONT_AND_BACK) return 1;
+
+	uint8_t IsFront = CurrentContext->FrontFaceMode == GL_CCW ? Det > 0.0f : Det < 0.0f;
+
+	if (CurrentContext->CullFaceMode == GL_BACK) return !IsFront;
+	return IsFront;
+}
+
+glslVec4 Sub(glslVec4 x, glslVec4 y)
+{
+	x.x -= y.x;
+	x.y -= y.y;
+	x.z -= y.z;
+	x.w -= y.w;
+	return x;
+}
+
+float Dot2(glslVec4 x, glslVec4 y)
+{
+	return x.x * y.x + x.y * y.y;
+}
+
+void Barycentric(glslVec4 a, glslVec4 b, glslVec4 c, glslVec4 p, float* u, float* v, float* w)
+{
+	glslVec4 v0 = Sub(b, a), v1 = Sub(c, a), v2 = Sub(p, a);
+	float d00 = Dot2(v0, v0);
+	float d01 = Dot2(v0, v1);
+	float d11 = Dot2(v1, v1);
+	float d20 = Dot2(v2, v0);
+	float d21 = Dot2(v2, v1);
+	float denom = d00 * d11 - d01 * d01;
+	*v = (d11 * d20 - d01 * d21) / denom;
+	*w = (d00 * d21 - d01 * d20) / denom;
+	*u = 1.0f - *v - *w;
+}
+
+// Scan bounds are the viewport clamped to the framebuffer, rows are flipped on write
+void GetScanBounds(int* MinX, int* MinY, int* MaxX, int* MaxY)
+{
+	int FramebufferWidth = CurrentContext->Framebuffer->Width;
+	int FramebufferHeight = CurrentContext->Framebuffer->Height;
+	int ViewportMaxX = CurrentContext->ViewportX + (int)CurrentContext->ViewportWidth;
+	int ViewportMaxY = CurrentContext->ViewportY + (int)CurrentContext->ViewportHeight;
+
+	*MinX = MAX(CurrentContext->ViewportX, 0);
+	*MaxX = MIN(ViewportMaxX, FramebufferWidth);
+	*MinY = MAX(CurrentContext->ViewportY, ViewportMaxY + CurrentContext->ViewportY - FramebufferHeight);
+	*MaxY = MIN(ViewportMaxY, ViewportMaxY + CurrentContext->ViewportY);
+}
+
+// Weights the packed varyings of three post-transform vertices into the fragment shader's inputs.
+// Integers are not interpolated, they take the first vertex's value
+void InterpolateVaryings(glslContext* Context, float** Varyings, float u, float v, float w)
+{
+	int Offset = 0;
+
+	for (int i = 0; i < CurrentContext->ActiveProgram->VertexFragInOut.Size; i++)
+	{
+		_VarPair InOut;
+
+		swglVectorRead(&CurrentContext->ActiveProgram->VertexFragInOut, &InOut, i);
+
+		if (InOut.first->Type != InOut.second->Type) continue;
+
+		int Floats = GLSLTypeSize(InOut.first->Type) / sizeof(float);
+		float* Out = (float*)GLSLVarData(Context, InOut.first);
+
+		if (InOut.first->Type == GLSL_INT) memcpy(Out, Varyings[0] + Offset, sizeof(int));
+		else for (int j = 0; j < Floats; j++) Out[j] = Varyings[0][Offset + j] * u + Varyings[1][Offset + j] * v + Varyings[2][Offset + j] * w;
+
+		Offset += Floats;
+	}
+}
+
+// Blends the fragment shader's output in Context into the samples of SampleMask, starting at CurCol
+void WriteFragmentColor(glslContext* Context, uint32_t* CurCol, uint8_t SampleMask)
 {
-	ActiveTextureUnit = (int)target - (int)GL_TEXTURE0;
-}
+	if (!CurrentContext->ActiveProgram->FragmentOut) return;
 
-void glTexParameteri(GLenum target, GLenum type, GLenum mode)
-{
-	if (target == GL_TEXTURE_2D)
+	float* Out = (float*)GLSLVarData(Context, CurrentContext->ActiveProgram->FragmentOut);
+
+	float SrcR = Out[0];
+	float SrcG = Out[1];
+	float SrcB = Out[2];
+	float SrcA = Out[3];
+
+	SrcR = MIN(MAX(SrcR, 0.0f), 1.0f);
+	SrcG = MIN(MAX(SrcG, 0.0f), 1.0f);
+	SrcB = MIN(MAX(SrcB, 0.0f), 1.0f);
+	SrcA = MIN(MAX(SrcA, 0.0f), 1.0f);
+
+	for (; SampleMask; SampleMask >>= 1, CurCol++)
 	{
-		if (!ActiveTexture2D) return;
-		if (type == GL_TEXTURE_WRAP_S)
+		if (!(SampleMask & 1)) continue;
+
+		float CurR = ((*CurCol >> 24) & 0xFF) / 255.0f;
+		float CurG = ((*CurCol >> 16) & 0xFF) / 255.0f;
+		float CurB = ((*CurCol >> 8) & 0xFF) / 255.0f;
+		float CurA = (*CurCol & 0xFF) / 255.0f;
+
+		float OutR = CurR + SrcA * (SrcR - CurR);
+		float OutG = CurG + SrcA * (SrcG - CurG);
+		float OutB = CurB + SrcA * (SrcB - CurB);
+		float OutA = CurA + SrcA * (SrcA - CurA);
+
+		uint32_t Color;
+
+		if (CurrentContext->Framebuffer->ColorFormat == GL_RGB)
 		{
-			ActiveTexture2D->SRepeat = mode;
+			Color = 0xFF;
+			Color |= (int)(OutR * 255) << 24;
+			Color |= (int)(OutG * 255) << 16;
+			Color |= (int)(OutB * 255) << 8;
 		}
-		if (type == GL_TEXTURE_WRAP_T)
+		else if (CurrentContext->Framebuffer->ColorFormat == GL_RGBA)
 		{
-			ActiveTexture2D->TRepeat = mode;
+			Color = 0x0;
+			Color |= (int)(OutR * 255) << 24;
+			Color |= (int)(OutG * 255) << 16;
+			Color |= (int)(OutB * 255) << 8;
+			Color |= (int)(OutA * 255);
 		}
+
+		*CurCol = Color;
 	}
 }
 
-void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* data)
+// Perspective correct depth at a point inside or near the triangle
+float InterpolateDepth(glslVec4* Coords, float x, float y)
 {
-	if (!data) return;
-	if (border != 0) return; // By specification, must always be 0
+	glslVec4 MyPoint = { x, y, 0.0f, 0.0f };
 
-	if (target == GL_TEXTURE_2D)
+	float u, v, w;
+	Barycentric(Coords[0], Coords[1], Coords[2], MyPoint, &u, &v, &w);
+
+	u /= Coords[0].w;
+	v /= Coords[1].w;
+	w /= Coords[2].w;
+
+	return (Coords[0].z * u + Coords[1].z * v + Coords[2].z * w) / (u + v + w);
+}
+
+// Shades the 2x2 quad whose bottom left pixel is (QuadX, QuadY). Lane n is pixel (QuadX + (n & 1), QuadY + (n >> 1)).
+// LaneSamples holds each lane's covered samples, lanes without any are helper lanes that only feed derivatives.
+// The fragment shader runs once per lane, at the pixel's sample point, whatever the sample count.
+void ShadeQuad(glslContext* Lanes, int QuadX, int QuadY, uint8_t* LaneSamples, glslVec4* Coords, float** Varyings)
+{
+	if (CurrentContext->Framebuffer->DepthFormat != GL_FLOAT) return;
+
+	int Samples = CurrentContext->Framebuffer->Samples;
+	const float (*Offsets)[2] = GetSampleOffsets(Samples);
+	uint8_t PerSampleDepth = IsMultisampling();
+
+	float LaneU[4], LaneV[4], LaneW[4];
+	int LaneIndex[4];
+	uint8_t WriteSamples[4];
+	uint8_t AnyWritten = 0;
+
+	for (int Lane = 0; Lane < 4; Lane++)
 	{
-		if (!ActiveTexture2D) return;
-		if (ActiveTexture2D->Data) free(ActiveTexture2D->Data);
-		if (internalformat != format) return; // Must be the same format for both output and input
-		if (internalformat == GL_RGBA) ActiveTexture2D->FloatsPerPixel = 4;
-		if (internalformat == GL_RGB) ActiveTexture2D->FloatsPerPixel = 3;
-		if (internalformat == GL_RG) ActiveTexture2D->FloatsPerPixel = 2;
-		if (internalformat == GL_RED) ActiveTexture2D->FloatsPerPixel = 1;
+		int x = QuadX + (Lane & 1);
+		int y = QuadY + (Lane >> 1);
+
+		glslVec4 MyPoint = { x, y, 0.0f, 0.0f };
+
+		float u, v, w;
+		Barycentric(Coords[0], Coords[1], Coords[2], MyPoint, &u, &v, &w);
+
+		float uCorrected = u / Coords[0].w;
+		float vCorrected = v / Coords[1].w;
+		float wCorrected = w / Coords[2].w;
+
+		float sum = uCorrected + vCorrected + wCorrected;
+
+		LaneU[Lane] = uCorrected / sum;
+		LaneV[Lane] = vCorrected / sum;
+		LaneW[Lane] = wCorrected / sum;
+
+		WriteSamples[Lane] = 0;
 
-		ActiveTexture2D->Width = width;
-		ActiveTexture2D->Height = height;
+		if (!LaneSamples[Lane]) continue;
 
-		ActiveTexture2D->Data = (float*)malloc(ActiveTexture2D->FloatsPerPixel * width * height * sizeof(float));
+		float z = (Coords[0].z * LaneU[Lane] + Coords[1].z * LaneV[Lane] + Coords[2].z * LaneW[Lane]);
 
-		float* StepData = ActiveTexture2D->Data;
+		LaneIndex[Lane] = (x + MIN(CurrentContext->Framebuffer->Height - 1, MAX(0, ((CurrentContext->ViewportHeight - (y - CurrentContext->ViewportY + 1)) + CurrentContext->ViewportY))) * CurrentContext->Framebuffer->Width) * Samples;
 
-		for (int i = 0; i < width * height * ActiveTexture2D->FloatsPerPixel; i += ActiveTexture2D->FloatsPerPixel)
+		for (int i = 0; i < Samples; i++)
 		{
-			for (int j = 0; j < ActiveTexture2D->FloatsPerPixel; j++)
+			if (!(LaneSamples[Lane] & (1 << i))) continue;
+
+			// Depth is per sample, only colour is shared between a pixel's samples
+			float SampleZ = PerSampleDepth ? InterpolateDepth(Coords, x + Offsets[i][0], y + Offsets[i][1]) : z;
+			float* CurZ = &(((float*)CurrentContext->Framebuffer->SampleDepth)[LaneIndex[Lane] + i]);
+
+			if (*CurZ == 0.0f || *CurZ >= SampleZ)
 			{
-				if (type == GL_FLOAT) ActiveTexture2D->Data[i + j] = ((float*)data)[i + j];
-				if (type == GL_UNSIGNED_BYTE) ActiveTexture2D->Data[i + j] = ((uint8_t*)data)[i + j] / 255.0f;
+				*CurZ = SampleZ;
+				WriteSamples[Lane] |= 1 << i;
 			}
 		}
+
+		AnyWritten |= WriteSamples[Lane];
+	}
+
+	if (!AnyWritten) return;
+
+	// Nothing reads a neighbouring lane, so skip the helper lanes and run the written ones one after another
+	if (!CurrentContext->ActiveProgram->FragmentShader.UsesQuadTokens)
+	{
+		for (int Lane = 0; Lane < 4; Lane++)
+		{
+			if (!WriteSamples[Lane]) continue;
+
+			InterpolateVaryings(&Lanes[0], Varyings, LaneU[Lane], LaneV[Lane], LaneW[Lane]);
+			ExecuteGLSL(&Lanes[0], CurrentContext->ActiveProgram->FragmentShader);
+			WriteFragmentColor(&Lanes[0], &CurrentContext->Framebuffer->SampleColor[LaneIndex[Lane]], WriteSamples[Lane]);
+		}
+		return;
+	}
+
+	for (int Lane = 0; Lane < 4; Lane++)
+	{
+		InterpolateVaryings(&Lanes[Lane], Varyings, LaneU[Lane], LaneV[Lane], LaneW[Lane]);
+	}
+
+	ExecuteGLSLQuad(CurrentContext->ActiveProgram->FragmentShader, Lanes);
+
+	for (int Lane = 0; Lane < 4; Lane++)
+	{
+		if (!WriteSamples[Lane]) continue;
+
+		WriteFragmentColor(&Lanes[Lane], &CurrentContext->Framebuffer->SampleColor[LaneIndex[Lane]], WriteSamples[Lane]);
 	}
 }
 
-void glGenerateMipmap(GLenum target)
+// Spans of an even and odd scanline pair, flushed as a row of quads once both are known
+typedef struct
 {
-	if (target == GL_TEXTURE_2D)
-	{
-		if (!ActiveTexture2D) return;
-		if (!ActiveTexture2D->Data) return;
+	int Y;
+	int Start[2];
+	int End[2];
+} QuadRowSpans;
 
-		int CurWidth = ActiveTexture2D->Width / 2;
-		int CurHeight = ActiveTexture2D->Height / 2;
+void ResetQuadRow(QuadRowSpans* Row, int y)
+{
+	Row->Y = y & ~1;
+	Row->Start[0] = Row->Start[1] = INT32_MAX;
+	Row->End[0] = Row->End[1] = INT32_MIN;
+}
 
-		float* PrevPtr = ActiveTexture2D->Data;
+void FlushQuadRow(glslContext* Lanes, QuadRowSpans* Row, glslVec4* Coords, float** Varyings)
+{
+	int Start = MIN(Row->Start[0], Row->Start[1]);
+	int End = MAX(Row->End[0], Row->End[1]);
 
-		while (CurWidth + CurHeight > 4)
-		{
-			float* CurPtr = (float*)malloc(CurWidth * CurHeight * sizeof(float) * ActiveTexture2D->FloatsPerPixel);
+	uint8_t SampleMask = FullSampleMask();
 
-			for (int y = 0; y < CurHeight; y++)
-			{
-				for (int x = 0; x < CurWidth; x++)
-				{
-					float* CurPixel = CurPtr + ActiveTexture2D->FloatsPerPixel * (x + y * CurWidth);
-					if (ActiveTexture2D->FloatsPerPixel >= 1) CurPixel[0] = 0.0f;
-					if (ActiveTexture2D->FloatsPerPixel >= 2) CurPixel[1] = 0.0f;
-					if (ActiveTexture2D->FloatsPerPixel >= 3) CurPixel[2] = 0.0f;
-					if (ActiveTexture2D->FloatsPerPixel == 4) CurPixel[3] = 0.0f;
-					for (int sY = 0; sY < 2; sY++)
-					{
-						for (int sX = 0; sX < 2; sX++)
-						{
-							float* PrevPixel = PrevPtr + ActiveTexture2D->FloatsPerPixel * ((x * 2 + sX) + (y * 2 + sY) * CurWidth * 2);
-							if (ActiveTexture2D->FloatsPerPixel >= 1) CurPixel[0] += PrevPixel[0];
-							if (ActiveTexture2D->FloatsPerPixel >= 2) CurPixel[1] += PrevPixel[1];
-							if (ActiveTexture2D->FloatsPerPixel >= 3) CurPixel[2] += PrevPixel[2];
-							if (ActiveTexture2D->FloatsPerPixel == 4) CurPixel[3] += PrevPixel[3];
-						}
-					}
-					if (ActiveTexture2D->FloatsPerPixel >= 1) CurPixel[0] /= 4.0f;
-					if (ActiveTexture2D->FloatsPerPixel >= 2) CurPixel[1] /= 4.0f;
-					if (ActiveTexture2D->FloatsPerPixel >= 3) CurPixel[2] /= 4.0f;
-					if (ActiveTexture2D->FloatsPerPixel == 4) CurPixel[3] /= 4.0f;
-				}
-			}
+	for (int QuadX = Start & ~1; QuadX < End; QuadX += 2)
+	{
+		uint8_t LaneSamples[4];
+		uint8_t Covered = 0;
 
-			MipMap2D Mipmap = { CurPtr, CurWidth, CurHeight };
-			swglVectorPushBack(&ActiveTexture2D->MipMaps, &Mipmap);
+		for (int Lane = 0; Lane < 4; Lane++)
+		{
+			int x = QuadX + (Lane & 1);
+			int Span = Lane >> 1;
 
-			CurWidth /= 2;
-			CurHeight /= 2;
-			PrevPtr = CurPtr;
+			LaneSamples[Lane] = x >= Row->Start[Span] && x < Row->End[Span] ? SampleMask : 0;
+			Covered |= LaneSamples[Lane];
 		}
+
+		if (Covered) ShadeQuad(Lanes, QuadX, Row->Y, LaneSamples, Coords, Varyings);
 	}
 }
 
-float MipMapLevel;
+// The part of a batch that falls in one raster cell, rasterized as one job
+typedef struct
+{
+	RasterBatch* Batch;
+	int Cell;
+
+	// Window coordinates of the cell's pixels, within the batch's scan bounds
+	int MinX;
+	int MinY;
+	int MaxX;
+	int MaxY;
 
-glslExValue ExecuteGLSLToken(glslToken* Token)
+	_SwglVector Triangles; // Indices into the batch's triangles that touch the tile, in submission order
+	_SwglVector Covered; // A uint8_t per entry of Triangles, whether it covered a sample of the tile
+
+	glslContext* Lanes; // The cell's fragment shader contexts while the tile is rasterized
+} RasterTile;
+
+void DrawTriangle(RasterTile* Tile, glslVec4* Coords, float** Varyings)
 {
-	if (Token->Type == GLSL_TOK_VAR)
+	glslVec4 OldCoords[3];
+	OldCoords[0] = Coords[0];
+	OldCoords[1] = Coords[1];
+	OldCoords[2] = Coords[2];
+
+	if (Coords[0].y > Coords[2].y)
+	{
+		glslVec4 Temp = Coords[0];
+		Coords[0] = Coords[2];
+		Coords[2] = Temp;
+	}
+
+	if (Coords[0].y > Coords[1].y)
 	{
-		VerifyVar(Token->Var);
+		glslVec4 Temp = Coords[0];
+		Coords[0] = Coords[1];
+		Coords[1] = Temp;
+	}
 
-		if (Token->Var->Type == GLSL_FLOAT)
-		{
-			glslExValue ExOutput = { GLSL_FLOAT, ((float*)Token->Var->Value.Data)[0] };
-			return ExOutput;
-		}
-		else if (Token->Var->Type == GLSL_VEC2)
-		{
-			glslExValue ExOutput = { GLSL_VEC2, ((float*)Token->Var->Value.Data)[0], ((float*)Token->Var->Value.Data)[1] };
-			return ExOutput;
-		}
-		else if (Token->Var->Type == GLSL_VEC3)
-		{
-			glslExValue ExOutput = { GLSL_VEC3, ((float*)Token->Var->Value.Data)[0], ((float*)Token->Var->Value.Data)[1], ((float*)Token->Var->Value.Data)[2] };
-			return ExOutput;
-		}
-		else if (Token->Var->Type == GLSL_VEC4)
-		{
-			glslExValue ExOutput = { GLSL_VEC4, ((float*)Token->Var->Value.Data)[0], ((float*)Token->Var->Value.Data)[1], ((float*)Token->Var->Value.Data)[2], ((float*)Token->Var->Value.Data)[3] };
-			return ExOutput;
-		}
-		else if (Token->Var->Type == GLSL_INT)
+	if (Coords[1].y > Coords[2].y)
+	{
+		glslVec4 Temp = Coords[1];
+		Coords[1] = Coords[2];
+		Coords[2] = Temp;
+	}
+
+	int ScanMinX, ScanMinY, ScanMaxX, ScanMaxY;
+	GetScanBounds(&ScanMinX, &ScanMinY, &ScanMaxX, &ScanMaxY);
+
+	if (Coords[0].y >= Tile->MaxY) return;
+	if (Coords[2].y < Tile->MinY) return;
+
+	float s0 = (Coords[2].x - Coords[0].x) / MAX(Coords[2].y - Coords[0].y, 1.0f);
+	float s1 = (Coords[1].x - Coords[0].x) / MAX(Coords[1].y - Coords[0].y, 1.0f);
+	float s2 = (Coords[2].x - Coords[1].x) / MAX(Coords[2].y - Coords[1].y, 1.0f);
+
+	float y = Coords[0].y;
+	float x0 = Coords[0].x;
+	float x1 = x0;
+
+	uint8_t Switched = 0;
+
+	if (y < ScanMinY)
+	{
+		// Jump straight to the first visible scanline instead of stepping through the guard band
+		float SwitchY = MAX(Coords[0].y, Coords[1].y - 1.0f);
+
+		y = ScanMinY;
+		x0 = Coords[0].x + s0 * (y - Coords[0].y);
+
+		if (y <= SwitchY)
 		{
-			glslExValue ExOutput = { GLSL_INT, 0.0f, 0.0f, 0.0f, 0.0f, ((int*)Token->Var->Value.Data)[0] };
-			return ExOutput;
+			x1 = Coords[0].x + s1 * (y - Coords[0].y);
 		}
-		else if (Token->Var->Type == GLSL_SAMPLER2D)
+		else
 		{
-			glslExValue ExOutput = { GLSL_SAMPLER2D, 0.0f, 0.0f, 0.0f, 0.0f, ((int*)Token->Var->Value.Data)[0] };
-			return ExOutput;
+			Switched = 1;
+			s1 = s2;
+			x1 = Coords[1].x + s2 * (y - SwitchY);
 		}
-		else if (Token->Var->Type == GLSL_MAT2)
+	}
+
+	// Steps to the tile's first row like the loop below, the spans are the same whichever tile starts them
+	for (; y < Tile->MinY && y < Coords[2].y; y++,x0 += s0,x1 += s1)
+	{
+		if (y + 1 >= Coords[1].y && !Switched)
 		{
-			glslMat2 MatVal = { ((float*)Token->Var->Value.Data)[0], ((float*)Token->Var->Value.Data)[1],
-				  ((float*)Token->Var->Value.Data)[1], ((float*)Token->Var->Value.Data)[2] };
-			glslExValue ExOutput = { GLSL_MAT2, 0.0f, 0.0f, 0.0f, 0.0f, 0, MatVal };
-			return ExOutput;
+			Switched = 1;
+			s1 = s2;
+			x1 = Coords[1].x;
 		}
-		else if (Token->Var->Type == GLSL_MAT3)
+	}
+
+	QuadRowSpans Row;
+	ResetQuadRow(&Row, (int)y);
+
+	for (; y < MIN(Coords[2].y, Tile->MaxY); y++,x0 += s0,x1 += s1)
+	{
+		int RowY = (int)y;
+
+		if ((RowY & ~1) != Row.Y)
 		{
-			glslMat3 MatVal = { ((float*)Token->Var->Value.Data)[0], ((float*)Token->Var->Value.Data)[1], ((float*)Token->Var->Value.Data)[2],
-				  ((float*)Token->Var->Value.Data)[3], ((float*)Token->Var->Value.Data)[4],  ((float*)Token->Var->Value.Data)[5],
-				  ((float*)Token->Var->Value.Data)[6], ((float*)Token->Var->Value.Data)[7],  ((float*)Token->Var->Value.Data)[8]
-			};
-			glslExValue ExOutput = { GLSL_MAT3, 0.0f, 0.0f, 0.0f, 0.0f, 0, { 0.0f }, MatVal };
-			return ExOutput;
+			FlushQuadRow(Tile->Lanes, &Row, OldCoords, Varyings);
+			ResetQuadRow(&Row, RowY);
 		}
-		else if (Token->Var->Type == GLSL_MAT4)
+
+		// Same pixels as stepping x up from the truncated span start while x < SpanEnd
+		float SpanStart = MAX(MIN(x0, x1), Tile->MinX);
+		float SpanEnd = MIN(MAX(x0, x1), Tile->MaxX);
+		int End = (int)SpanEnd;
+		if (End < SpanEnd) End++;
+
+		Row.Start[RowY & 1] = (int)SpanStart;
+		Row.End[RowY & 1] = End;
+
+		if (y + 1 >= Coords[1].y && !Switched)
 		{
-			glslMat4 MatVal = { ((float*)Token->Var->Value.Data)[0], ((float*)Token->Var->Value.Data)[1], ((float*)Token->Var->Value.Data)[2], ((float*)Token->Var->Value.Data)[3],
-				  ((float*)Token->Var->Value.Data)[4], ((float*)Token->Var->Value.Data)[5],  ((float*)Token->Var->Value.Data)[6], ((float*)Token->Var->Value.Data)[7],
-				  ((float*)Token->Var->Value.Data)[8], ((float*)Token->Var->Value.Data)[9],  ((float*)Token->Var->Value.Data)[10],  ((float*)Token->Var->Value.Data)[11],
-				  ((float*)Token->Var->Value.Data)[10], ((float*)Token->Var->Value.Data)[13],  ((float*)Token->Var->Value.Data)[14],  ((float*)Token->Var->Value.Data)[15],
-			};
-			glslExValue ExOutput = { GLSL_MAT4, 0.0f, 0.0f, 0.0f, 0.0f, 0, { 0.0f }, { 0.0f }, MatVal };
-			return ExOutput;
+			Switched = 1;
+			s1 = s2;
+			x1 = Coords[1].x;
 		}
 	}
-	else if (Token->Type == GLSL_TOK_CONST)
+
+	FlushQuadRow(Tile->Lanes, &Row, OldCoords, Varyings);
+}
+
+// Largest bounding box edge, in pixels, that goes through DrawSmallTriangle instead of the scanline setup
+#define SWGL_SMALL_TRIANGLE_SIZE 2.0f
+
+uint8_t IsEdgeSampleCovered(float EdgeValue, glslVec4 a, glslVec4 b)
+{
+	if (EdgeValue > 0.0f) return 1;
+	if (EdgeValue < 0.0f) return 0;
+
+	// Samples exactly on an edge belong to left and min-y edges, like the scanline's inclusive start
+	float dEdx = a.y - b.y;
+	float dEdy = b.x - a.x;
+	return dEdx > 0.0f || (dEdx == 0.0f && dEdy > 0.0f);
+}
+
+// Tests the handful of samples in the bounding box with edge functions and shades the quads
+// they fall in directly, skipping the edge sorting and slope setup of DrawTriangle. Returns whether any sample was covered
+uint8_t DrawSmallTriangle(RasterTile* Tile, glslVec4* Coords, float** Varyings, float Area)
+{
+	glslVec4 Verts[3] = { Coords[0], Coords[1], Coords[2] };
+
+	// Wind the edge functions so that the interior is positive
+	if (Area < 0.0f)
 	{
-		if (Token->Const.IsFloat)
+		Verts[1] = Coords[2];
+		Verts[2] = Coords[1];
+	}
+
+	int MinX = MAX((int)MIN(MIN(Verts[0].x, Verts[1].x), Verts[2].x), Tile->MinX);
+	int MaxX = MIN((int)MAX(MAX(Verts[0].x, Verts[1].x), Verts[2].x), Tile->MaxX);
+	int MinY = MAX((int)MIN(MIN(Verts[0].y, Verts[1].y), Verts[2].y), Tile->MinY);
+	int MaxY = MIN((int)MAX(MAX(Verts[0].y, Verts[1].y), Verts[2].y), Tile->MaxY);
+
+	// A box of at most 2x2 samples straddles at most 2x2 quads
+	int QuadX[4];
+	int QuadY[4];
+	uint8_t QuadSamples[4][4];
+	int QuadCount = 0;
+
+	uint8_t SampleMask = FullSampleMask();
+
+	for (int y = MinY & ~1; y < MaxY; y += 2)
+	{
+		for (int x = MinX & ~1; x < MaxX; x += 2)
 		{
-			glslExValue ExOutput = { GLSL_FLOAT, Token->Const.Fval };
-			return ExOutput;
+			uint8_t CoverageMask = 0;
+
+			for (int Lane = 0; Lane < 4; Lane++)
+			{
+				int SampleX = x + (Lane & 1);
+				int SampleY = y + (Lane >> 1);
+
+				if (SampleX < MinX || SampleX >= MaxX || SampleY < MinY || SampleY >= MaxY) continue;
+
+				float e0 = (Verts[2].x - Verts[1].x) * (SampleY - Verts[1].y) - (Verts[2].y - Verts[1].y) * (SampleX - Verts[1].x);
+				float e1 = (Verts[0].x - Verts[2].x) * (SampleY - Verts[2].y) - (Verts[0].y - Verts[2].y) * (SampleX - Verts[2].x);
+				float e2 = (Verts[1].x - Verts[0].x) * (SampleY - Verts[0].y) - (Verts[1].y - Verts[0].y) * (SampleX - Verts[0].x);
+
+				if (!IsEdgeSampleCovered(e0, Verts[1], Verts[2])) continue;
+				if (!IsEdgeSampleCovered(e1, Verts[2], Verts[0])) continue;
+				if (!IsEdgeSampleCovered(e2, Verts[0], Verts[1])) continue;
+
+				CoverageMask |= 1 << Lane;
+			}
+
+			if (!CoverageMask) continue;
+
+			for (int Lane = 0; Lane < 4; Lane++)
+			{
+				QuadSamples[QuadCount][Lane] = CoverageMask & (1 << Lane) ? SampleMask : 0;
+			}
+
+			QuadX[QuadCount] = x;
+			QuadY[QuadCount] = y;
+			QuadCount++;
 		}
-		else
+	}
+
+	for (int i = 0; i < QuadCount; i++)
+	{
+		ShadeQuad(Tile->Lanes, QuadX[i], QuadY[i], QuadSamples[i], Coords, Varyings);
+	}
+
+	return QuadCount > 0;
+}
+
+// Tests every sample of the pixels in the bounding box with edge functions. Coverage is per sample,
+// the quads it touches are shaded once per pixel by ShadeQuad. Returns whether any sample was covered
+uint8_t DrawMultisampleTriangle(RasterTile* Tile, glslVec4* Coords, float** Varyings, float Area)
+{
+	glslVec4 Verts[3] = { Coords[0], Coords[1], Coords[2] };
+
+	// Wind the edge functions so that the interior is positive
+	if (Area < 0.0f)
+	{
+		Verts[1] = Coords[2];
+		Verts[2] = Coords[1];
+	}
+
+	int Samples = CurrentContext->Framebuffer->Samples;
+	const float (*Offsets)[2] = GetSampleOffsets(Samples);
+
+	// Samples sit within half a pixel of the pixel's sample point, widen the box to the pixels that can reach it
+	int MinX = MAX((int)MIN(MIN(Verts[0].x, Verts[1].x), Verts[2].x) - 1, Tile->MinX);
+	int MaxX = MIN((int)MAX(MAX(Verts[0].x, Verts[1].x), Verts[2].x) + 2, Tile->MaxX);
+	int MinY = MAX((int)MIN(MIN(Verts[0].y, Verts[1].y), Verts[2].y) - 1, Tile->MinY);
+	int MaxY = MIN((int)MAX(MAX(Verts[0].y, Verts[1].y), Verts[2].y) + 2, Tile->MaxY);
+
+	uint8_t Covered = 0;
+
+	for (int QuadY = MinY & ~1; QuadY < MaxY; QuadY += 2)
+	{
+		for (int QuadX = MinX & ~1; QuadX < MaxX; QuadX += 2)
 		{
-			glslExValue ExOutput = { GLSL_INT, 0.0f, 0.0f, 0.0f, 0.0f, Token->Const.Ival };
-			return ExOutput;
+			uint8_t LaneSamples[4];
+			uint8_t QuadCovered = 0;
+
+			for (int Lane = 0; Lane < 4; Lane++)
+			{
+				int x = QuadX + (Lane & 1);
+				int y = QuadY + (Lane >> 1);
+
+				LaneSamples[Lane] = 0;
+
+				if (x < MinX || x >= MaxX || y < MinY || y >= MaxY) continue;
+
+				for (int i = 0; i < Samples; i++)
+				{
+					float SampleX = x + Offsets[i][0];
+					float SampleY = y + Offsets[i][1];
+
+					float e0 = (Verts[2].x - Verts[1].x) * (SampleY - Verts[1].y) - (Verts[2].y - Verts[1].y) * (SampleX - Verts[1].x);
+					float e1 = (Verts[0].x - Verts[2].x) * (SampleY - Verts[2].y) - (Verts[0].y - Verts[2].y) * (SampleX - Verts[2].x);
+					float e2 = (Verts[1].x - Verts[0].x) * (SampleY - Verts[0].y) - (Verts[1].y - Verts[0].y) * (SampleX - Verts[0].x);
+
+					if (!IsEdgeSampleCovered(e0, Verts[1], Verts[2])) continue;
+					if (!IsEdgeSampleCovered(e1, Verts[2], Verts[0])) continue;
+					if (!IsEdgeSampleCovered(e2, Verts[0], Verts[1])) continue;
+
+					LaneSamples[Lane] |= 1 << i;
+				}
+
+				QuadCovered |= LaneSamples[Lane];
+			}
+
+			if (!QuadCovered) continue;
+
+			Covered = 1;
+			ShadeQuad(Tile->Lanes, QuadX, QuadY, LaneSamples, Coords, Varyings);
 		}
 	}
-	else if (Token->Type == GLSL_TOK_VAR_DECL)
-	{
-		VerifyVar(Token->Var);
 
-		glslExValue Result = ExecuteGLSLToken(Token->Second);
+	return Covered;
+}
+
+/*
+* VERTEX SHADING
+*/
+
+// Batches with fewer vertices shade on the calling thread, below this splitting them into jobs costs more than it saves
+#define SWGL_PARALLEL_VERTEX_MIN 1024
+
+// Vertices shaded before primitive assembly consumes them, bounds the post-transform buffer. Multiple of 3
+#define SWGL_VERTEX_BATCH 3072
+
+// Vertices per scheduler job, SWGL_VERTEX_BATCH is a multiple of it
+#define SWGL_VERTEX_JOB_SIZE 256
+
+// Vertices whose attributes are converted together before they are shaded one at a time
+#define SWGL_FETCH_BATCH 64
+
+// Entries of the post-transform cache, a power of two well above SWGL_VERTEX_BATCH to keep probe chains short
+#define SWGL_VERTEX_CACHE_SIZE 8192
+
+// Shaded vertices in submission order, then the vertices clipping adds. Positions and varyings are kept
+// in separate flat arrays, varyings packed as floats in VertexFragInOut order
+typedef struct
+{
+	int Capacity;
+	int Count;
+	int VaryingFloats;
+	glslVec4* Positions;
+	float* Varyings;
+
+	// Outputs transform feedback captures, in FeedbackVars order. Only kept while it is active
+	int FeedbackFloats;
+	float* Feedback;
+} PostTransformBuffer;
 
-		AssignToExVal(Token->Var, Result);
-		glslExValue ExOutput = { GLSL_UNKNOWN };
-		return ExOutput;
-	}
-	else if (Token->Type == GLSL_TOK_ASSIGN)
+PostTransformBuffer NewPostTransformBuffer(int Capacity)
+{
+	PostTransformBuffer Buffer;
+	Buffer.Capacity = Capacity;
+	Buffer.Count = 0;
+	Buffer.VaryingFloats = 0;
+
+	for (int i = 0; i < CurrentContext->ActiveProgram->VertexFragInOut.Size; i++)
 	{
-		VerifyVar(Token->First->Var);
+		_VarPair InOut;
 
-		glslExValue Result = ExecuteGLSLToken(Token->Second);
+		swglVectorRead(&CurrentContext->ActiveProgram->VertexFragInOut, &InOut, i);
 
-		AssignToExVal(Token->First->Var, Result);
-		return Result;
+		if (InOut.first->Type != InOut.second->Type) continue;
+
+		Buffer.VaryingFloats += GLSLTypeSize(InOut.second->Type) / sizeof(float);
 	}
-	else if (Token->Type == GLSL_TOK_ADD)
-	{
-		glslExValue FirstResult = ExecuteGLSLToken(Token->First);
-		glslExValue SecondResult = ExecuteGLSLToken(Token->Second);
 
-		if (FirstResult.Type != SecondResult.Type)
-		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
-		}
+	Buffer.Positions = (glslVec4*)malloc(sizeof(glslVec4) * Capacity);
+	Buffer.Varyings = (float*)malloc(sizeof(float) * MAX(Buffer.VaryingFloats * Capacity, 1));
 
-		FirstResult.x += SecondResult.x;
-		FirstResult.y += SecondResult.y;
-		FirstResult.z += SecondResult.z;
-		FirstResult.w += SecondResult.w;
-		FirstResult.i += SecondResult.i;
+	Buffer.FeedbackFloats = CurrentContext->TransformFeedbackActive ? CurrentContext->ActiveProgram->FeedbackFloats : 0;
+	Buffer.Feedback = Buffer.FeedbackFloats ? (float*)malloc(sizeof(float) * Buffer.FeedbackFloats * Capacity) : 0;
 
-		if (FirstResult.Type == GLSL_MAT2)
-		{
-			FirstResult.Mat2.m00 += SecondResult.Mat2.m00;
-			FirstResult.Mat2.m01 += SecondResult.Mat2.m01;
+	return Buffer;
+}
 
-			FirstResult.Mat2.m10 += SecondResult.Mat2.m10;
-			FirstResult.Mat2.m11 += SecondResult.Mat2.m11;
-		}
-		else if (FirstResult.Type == GLSL_MAT3)
-		{
-			FirstResult.Mat3.m00 += SecondResult.Mat3.m00;
-			FirstResult.Mat3.m01 += SecondResult.Mat3.m01;
-			FirstResult.Mat3.m02 += SecondResult.Mat3.m02;
+void FreePostTransformBuffer(PostTransformBuffer* Buffer)
+{
+	free(Buffer->Positions);
+	free(Buffer->Varyings);
+	free(Buffer->Feedback);
+}
 
-			FirstResult.Mat3.m10 += SecondResult.Mat3.m10;
-			FirstResult.Mat3.m11 += SecondResult.Mat3.m11;
-			FirstResult.Mat3.m12 += SecondResult.Mat3.m12;
+// Bytes of one component of an attribute type, or of a whole element for the packed types. 0 if it cannot be fetched
+int AttributeTypeSize(GLenum Type)
+{
+	if (Type == GL_BYTE || Type == GL_UNSIGNED_BYTE) return 1;
+	if (Type == GL_SHORT || Type == GL_UNSIGNED_SHORT || Type == GL_HALF_FLOAT) return 2;
+	if (Type == GL_FLOAT || Type == GL_INT || Type == GL_UNSIGNED_INT || Type == GL_INT_2_10_10_10_REV || Type == GL_UNSIGNED_INT_2_10_10_10_REV) return 4;
+	return 0;
+}
 
-			FirstResult.Mat3.m20 += SecondResult.Mat3.m20;
-			FirstResult.Mat3.m21 += SecondResult.Mat3.m21;
-			FirstResult.Mat3.m22 += SecondResult.Mat3.m22;
-		}
-		else if (FirstResult.Type == GLSL_MAT4)
-		{
-			FirstResult.Mat4.m00 += SecondResult.Mat4.m00;
-			FirstResult.Mat4.m01 += SecondResult.Mat4.m01;
-			FirstResult.Mat4.m02 += SecondResult.Mat4.m02;
-			FirstResult.Mat4.m03 += SecondResult.Mat4.m02;
+// Four components in one 32 bit word, x in the low 10 bits and w in the high 2
+uint8_t IsPackedAttributeType(GLenum Type)
+{
+	return Type == GL_INT_2_10_10_10_REV || Type == GL_UNSIGNED_INT_2_10_10_10_REV;
+}
 
-			FirstResult.Mat4.m10 += SecondResult.Mat4.m10;
-			FirstResult.Mat4.m11 += SecondResult.Mat4.m11;
-			FirstResult.Mat4.m12 += SecondResult.Mat4.m12;
-			FirstResult.Mat4.m13 += SecondResult.Mat4.m12;
+// Divided by rather than multiplied by the reciprocal, so normalized values are exactly the floats n / Range
+void SetAttributeRanges(AttributeFetch* Fetch)
+{
+	Fetch->Range = 1.0f;
+	Fetch->RangeW = 1.0f;
+	Fetch->SignedNormalized = 0;
 
-			FirstResult.Mat4.m20 += SecondResult.Mat4.m20;
-			FirstResult.Mat4.m21 += SecondResult.Mat4.m21;
-			FirstResult.Mat4.m22 += SecondResult.Mat4.m22;
-			FirstResult.Mat4.m23 += SecondResult.Mat4.m22;
+	if (!Fetch->Normalized) return;
 
-			FirstResult.Mat4.m30 += SecondResult.Mat4.m30;
-			FirstResult.Mat4.m31 += SecondResult.Mat4.m31;
-			FirstResult.Mat4.m32 += SecondResult.Mat4.m32;
-			FirstResult.Mat4.m33 += SecondResult.Mat4.m33;
-		}
+	if (Fetch->Type == GL_UNSIGNED_BYTE) Fetch->Range = 255.0f;
+	else if (Fetch->Type == GL_BYTE) Fetch->Range = 127.0f;
+	else if (Fetch->Type == GL_UNSIGNED_SHORT) Fetch->Range = 65535.0f;
+	else if (Fetch->Type == GL_SHORT) Fetch->Range = 32767.0f;
+	else if (Fetch->Type == GL_UNSIGNED_INT) Fetch->Range = 4294967295.0f;
+	else if (Fetch->Type == GL_INT) Fetch->Range = 2147483647.0f;
+	else if (Fetch->Type == GL_UNSIGNED_INT_2_10_10_10_REV) Fetch->Range = 1023.0f;
+	else if (Fetch->Type == GL_INT_2_10_10_10_REV) Fetch->Range = 511.0f;
 
-		return FirstResult;
-	}
-	else if (Token->Type == GLSL_TOK_SUB)
+	if (!IsPackedAttributeType(Fetch->Type)) Fetch->RangeW = Fetch->Range;
+	else if (Fetch->Type == GL_UNSIGNED_INT_2_10_10_10_REV) Fetch->RangeW = 3.0f;
+
+	Fetch->SignedNormalized = Fetch->Type == GL_BYTE || Fetch->Type == GL_SHORT || Fetch->Type == GL_INT || Fetch->Type == GL_INT_2_10_10_10_REV;
+}
+
+// The magnitude's bits shifted into a float's place are the value scaled by 2^-112, denormals included,
+// and infinities and NaNs get the float's all ones exponent
+float HalfToFloat(uint16_t Half)
+{
+	uint32_t Magnitude = Half & 0x7FFF;
+	uint32_t Bits = Magnitude << 13;
+	uint32_t ScaleBits = 0x77800000; // 2^112
+	float Value, Scale;
+
+	memcpy(&Value, &Bits, sizeof(float));
+	memcpy(&Scale, &ScaleBits, sizeof(float));
+	Value *= Scale;
+	memcpy(&Bits, &Value, sizeof(float));
+
+	if (Magnitude >= 0x7C00) Bits |= 0x7F800000;
+	Bits |= (uint32_t)(Half & 0x8000) << 16;
+
+	memcpy(&Value, &Bits, sizeof(float));
+	return Value;
+}
+
+#ifdef __SSE2__
+// HalfToFloat of four halves, zero extended to 32 bits
+__m128 HalfToFloat4(__m128i Halves)
+{
+	__m128i Magnitude = _mm_and_si128(Halves, _mm_set1_epi32(0x7FFF));
+	__m128 Value = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(Magnitude, 13)), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+	__m128i Special = _mm_and_si128(_mm_cmpgt_epi32(Magnitude, _mm_set1_epi32(0x7BFF)), _mm_set1_epi32(0x7F800000));
+	__m128i Sign = _mm_slli_epi32(_mm_and_si128(Halves, _mm_set1_epi32(0x8000)), 16);
+
+	return _mm_or_ps(Value, _mm_castsi128_ps(_mm_or_si128(Special, Sign)));
+}
+#endif
+
+// Component j of an element of one of the integer types, sign extended and not yet normalized
+int ReadAttributeInteger(GLenum Type, uint8_t* Src, int j)
+{
+	if (Type == GL_UNSIGNED_BYTE) return Src[j];
+	if (Type == GL_BYTE) return ((int8_t*)Src)[j];
+	if (Type == GL_UNSIGNED_SHORT) return ((uint16_t*)Src)[j];
+	if (Type == GL_SHORT) return ((int16_t*)Src)[j];
+
+	if (IsPackedAttributeType(Type))
 	{
-		glslExValue FirstResult = ExecuteGLSLToken(Token->First);
-		glslExValue SecondResult = ExecuteGLSLToken(Token->Second);
+		uint32_t Packed;
+		memcpy(&Packed, Src, sizeof(uint32_t));
 
-		if (FirstResult.Type != SecondResult.Type)
-		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
-		}
+		int Bits = j == 3 ? 2 : 10;
+		int Field = (Packed >> (j * 10)) & ((1 << Bits) - 1);
 
-		FirstResult.x -= SecondResult.x;
-		FirstResult.y -= SecondResult.y;
-		FirstResult.z -= SecondResult.z;
-		FirstResult.w -= SecondResult.w;
-		FirstResult.i -= SecondResult.i;
+		if (Type == GL_INT_2_10_10_10_REV) return (Field ^ (1 << (Bits - 1))) - (1 << (Bits - 1));
+		return Field;
+	}
 
-		if (FirstResult.Type == GLSL_MAT2)
-		{
-			FirstResult.Mat2.m00 -= SecondResult.Mat2.m00;
-			FirstResult.Mat2.m01 -= SecondResult.Mat2.m01;
+	return ((int*)Src)[j];
+}
 
-			FirstResult.Mat2.m10 -= SecondResult.Mat2.m10;
-			FirstResult.Mat2.m11 -= SecondResult.Mat2.m11;
-		}
-		else if (FirstResult.Type == GLSL_MAT3)
-		{
-			FirstResult.Mat3.m00 -= SecondResult.Mat3.m00;
-			FirstResult.Mat3.m01 -= SecondResult.Mat3.m01;
-			FirstResult.Mat3.m02 -= SecondResult.Mat3.m02;
+// Matches each vertex shader input to the attribute that feeds it, the last one specified for its location
+FetchPlan* GetFetchPlan(VertexArray* VertArray, Program* MyProgram)
+{
+	FetchPlan* Plan = &VertArray->Plan;
 
-			FirstResult.Mat3.m10 -= SecondResult.Mat3.m10;
-			FirstResult.Mat3.m11 -= SecondResult.Mat3.m11;
-			FirstResult.Mat3.m12 -= SecondResult.Mat3.m12;
+	if (Plan->BuiltFor == MyProgram && Plan->LinkCount == MyProgram->LinkCount) return Plan;
 
-			FirstResult.Mat3.m20 -= SecondResult.Mat3.m20;
-			FirstResult.Mat3.m21 -= SecondResult.Mat3.m21;
-			FirstResult.Mat3.m22 -= SecondResult.Mat3.m22;
-		}
-		else if (FirstResult.Type == GLSL_MAT4)
+	Plan->BuiltFor = MyProgram;
+	Plan->LinkCount = MyProgram->LinkCount;
+	Plan->Fetches.Size = 0;
+	Plan->StagedFloats = 0;
+
+	for (int i = 0; i < MyProgram->Layouts.Size; i++)
+	{
+		glslVariable* Var = ((glslVariable**)MyProgram->Layouts.Data)[i];
+		VertexArrayAttrib* Attrib = 0;
+
+		for (int j = 0; j < VertArray->Attribs.Size; j++)
 		{
-			FirstResult.Mat4.m00 -= SecondResult.Mat4.m00;
-			FirstResult.Mat4.m01 -= SecondResult.Mat4.m01;
-			FirstResult.Mat4.m02 -= SecondResult.Mat4.m02;
-			FirstResult.Mat4.m03 -= SecondResult.Mat4.m02;
+			VertexArrayAttrib* Candidate = (VertexArrayAttrib*)VertArray->Attribs.Data + j;
+			if (Candidate->index == Var->Layout->Location) Attrib = Candidate;
+		}
 
-			FirstResult.Mat4.m10 -= SecondResult.Mat4.m10;
-			FirstResult.Mat4.m11 -= SecondResult.Mat4.m11;
-			FirstResult.Mat4.m12 -= SecondResult.Mat4.m12;
-			FirstResult.Mat4.m13 -= SecondResult.Mat4.m12;
+		if (!Attrib) continue;
 
-			FirstResult.Mat4.m20 -= SecondResult.Mat4.m20;
-			FirstResult.Mat4.m21 -= SecondResult.Mat4.m21;
-			FirstResult.Mat4.m22 -= SecondResult.Mat4.m22;
-			FirstResult.Mat4.m23 -= SecondResult.Mat4.m22;
+		int TypeSize = AttributeTypeSize(Attrib->type);
 
-			FirstResult.Mat4.m30 -= SecondResult.Mat4.m30;
-			FirstResult.Mat4.m31 -= SecondResult.Mat4.m31;
-			FirstResult.Mat4.m32 -= SecondResult.Mat4.m32;
-			FirstResult.Mat4.m33 -= SecondResult.Mat4.m33;
-		}
+		if (!TypeSize) continue;
+		if (IsPackedAttributeType(Attrib->type) && Attrib->size != 4) continue;
 
-		return FirstResult;
+		AttributeFetch Fetch;
+		Fetch.Offset = Attrib->offset;
+		// A stride of 0 is tightly packed elements
+		Fetch.Stride = Attrib->stride;
+		if (!Fetch.Stride) Fetch.Stride = IsPackedAttributeType(Attrib->type) ? TypeSize : TypeSize * Attrib->size;
+		Fetch.Divisor = Attrib->divisor;
+		Fetch.Type = Attrib->type;
+		Fetch.Normalized = Attrib->normalized;
+		Fetch.Slot = Var->Slot;
+		Fetch.InputFloats = GLSLTypeSize(Var->Type) / sizeof(float);
+		Fetch.IntegerInput = Var->Type == GLSL_INT;
+		Fetch.Components = MIN(Attrib->size, Fetch.InputFloats);
+		Fetch.StagedOffset = Plan->StagedFloats;
+		SetAttributeRanges(&Fetch);
+
+		Plan->StagedFloats += Fetch.InputFloats;
+		swglVectorPushBack(&Plan->Fetches, &Fetch);
 	}
-	else if (Token->Type == GLSL_TOK_MUL)
+
+	return Plan;
+}
+
+// Converts one attribute of Count vertices into their staged inputs, a type and component count per loop
+void FetchAttributeBatch(AttributeFetch* Fetch, uint8_t* Data, const uint32_t* Vertices, const uint32_t* Instances, int Count, float* Staged, int StagedFloats)
+{
+	float* Dst = Staged + Fetch->StagedOffset;
+
+	for (int i = 0; i < Count; i++, Dst += StagedFloats)
 	{
-		glslExValue FirstResult = ExecuteGLSLToken(Token->First);
-		glslExValue SecondResult = ExecuteGLSLToken(Token->Second);
+		uint32_t Element = Fetch->Divisor ? Instances[i] / Fetch->Divisor : Vertices[i];
+		uint8_t* Src = Data + Element * Fetch->Stride + Fetch->Offset;
 
-		if (FirstResult.Type != GLSL_MAT2 && FirstResult.Type != GLSL_MAT3 && FirstResult.Type != GLSL_MAT4)
+		if (Fetch->IntegerInput)
 		{
-			if (FirstResult.Type != SecondResult.Type)
-			{
-				glslExValue ExOutput = { GLSL_UNKNOWN };
-				return ExOutput;
-			}
-			FirstResult.x *= SecondResult.x;
-			FirstResult.y *= SecondResult.y;
-			FirstResult.z *= SecondResult.z;
-			FirstResult.w *= SecondResult.w;
-			FirstResult.i *= SecondResult.i;
+			int Value = 0;
+			if (Fetch->Type == GL_FLOAT) Value = (int)*(float*)Src;
+			else if (Fetch->Type == GL_HALF_FLOAT) Value = (int)HalfToFloat(*(uint16_t*)Src);
+			else Value = ReadAttributeInteger(Fetch->Type, Src, 0);
+			memcpy(Dst, &Value, sizeof(int));
+			continue;
 		}
-		else
+
+#ifdef __SSE2__
+		if (Fetch->Components == 4)
 		{
-			if (FirstResult.Type == GLSL_MAT2 && SecondResult.Type == GLSL_MAT2)
+			if (Fetch->Type == GL_FLOAT)
 			{
-				FirstResult.Mat2 = MatMulMat2(&FirstResult.Mat2, &SecondResult.Mat2);
+				_mm_storeu_ps(Dst, _mm_loadu_ps((float*)Src));
+				continue;
 			}
-			else if (FirstResult.Type == GLSL_MAT2 && SecondResult.Type == GLSL_VEC2)
+
+			if (Fetch->Type == GL_HALF_FLOAT)
 			{
-				glslVec2 InVec2 = { SecondResult.x, SecondResult.y };
-				glslVec2 Result = MatMulMat2Vec(&FirstResult.Mat2, &InVec2);
-				FirstResult.x = Result.x;
-				FirstResult.y = Result.y;
-				FirstResult.Type = GLSL_VEC2;
+				_mm_storeu_ps(Dst, HalfToFloat4(_mm_unpacklo_epi16(_mm_loadl_epi64((__m128i*)Src), _mm_setzero_si128())));
+				continue;
 			}
-			else if (FirstResult.Type == GLSL_MAT3 && SecondResult.Type == GLSL_MAT3)
+
+			if (Fetch->Type == GL_UNSIGNED_INT)
 			{
-				FirstResult.Mat3 = MatMulMat3(&FirstResult.Mat3, &SecondResult.Mat3);
+				// Converted as two exact 16 bit halves, so their sum rounds once like the scalar conversion
+				__m128i Unsigned = _mm_loadu_si128((__m128i*)Src);
+				__m128 High = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(Unsigned, 16)), _mm_set1_ps(65536.0f));
+				__m128 Value = _mm_add_ps(High, _mm_cvtepi32_ps(_mm_and_si128(Unsigned, _mm_set1_epi32(0xFFFF))));
+
+				_mm_storeu_ps(Dst, _mm_div_ps(Value, _mm_set_ps(Fetch->RangeW, Fetch->Range, Fetch->Range, Fetch->Range)));
+				continue;
 			}
-			else if (FirstResult.Type == GLSL_MAT3 && SecondResult.Type == GLSL_VEC3)
+
+			// Integers are widened to 32 bits, then converted and normalized like the scalar loop below
+			__m128i Integers;
+
+			if (Fetch->Type == GL_UNSIGNED_BYTE || Fetch->Type == GL_BYTE)
 			{
-				glslVec3 InVec3 = { SecondResult.x, SecondResult.y, SecondResult.z };
-				glslVec3 Result = MatMulMat3Vec(&FirstResult.Mat3, &InVec3);
-				FirstResult.x = Result.x;
-				FirstResult.y = Result.y;
-				FirstResult.z = Result.z;
-				FirstResult.Type = GLSL_VEC3;
+				int Packed;
+				memcpy(&Packed, Src, sizeof(int));
+				__m128i Bytes = _mm_cvtsi32_si128(Packed);
+
+				if (Fetch->Type == GL_BYTE) Integers = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_unpacklo_epi8(Bytes, Bytes), _mm_unpacklo_epi8(Bytes, Bytes)), 24);
+				else Integers = _mm_unpacklo_epi16(_mm_unpacklo_epi8(Bytes, _mm_setzero_si128()), _mm_setzero_si128());
 			}
-			else if (FirstResult.Type == GLSL_MAT4 && SecondResult.Type == GLSL_MAT4)
+			else if (Fetch->Type == GL_UNSIGNED_SHORT || Fetch->Type == GL_SHORT)
 			{
-				FirstResult.Mat4 = MatMulMat4(&FirstResult.Mat4, &SecondResult.Mat4);
+				__m128i Shorts = _mm_loadl_epi64((__m128i*)Src);
+
+				if (Fetch->Type == GL_SHORT) Integers = _mm_srai_epi32(_mm_unpacklo_epi16(Shorts, Shorts), 16);
+				else Integers = _mm_unpacklo_epi16(Shorts, _mm_setzero_si128());
 			}
-			else if (FirstResult.Type == GLSL_MAT4 && SecondResult.Type == GLSL_VEC4)
+			else if (IsPackedAttributeType(Fetch->Type))
 			{
-				glslVec4 InVec4 = { SecondResult.x, SecondResult.y, SecondResult.z, SecondResult.w };
-				glslVec4 Result = MatMulMat4Vec(&FirstResult.Mat4, &InVec4);
-				FirstResult.x = Result.x;
-				FirstResult.y = Result.y;
-				FirstResult.z = Result.z;
-				FirstResult.w = Result.w;
-				FirstResult.Type = GLSL_VEC4;
+				Integers = _mm_set_epi32(ReadAttributeInteger(Fetch->Type, Src, 3), ReadAttributeInteger(Fetch->Type, Src, 2), ReadAttributeInteger(Fetch->Type, Src, 1), ReadAttributeInteger(Fetch->Type, Src, 0));
+			}
+			else
+			{
+				Integers = _mm_loadu_si128((__m128i*)Src);
 			}
+
+			__m128 Value = _mm_div_ps(_mm_cvtepi32_ps(Integers), _mm_set_ps(Fetch->RangeW, Fetch->Range, Fetch->Range, Fetch->Range));
+			if (Fetch->SignedNormalized) Value = _mm_max_ps(Value, _mm_set1_ps(-1.0f));
+
+			_mm_storeu_ps(Dst, Value);
+			continue;
 		}
+#endif
 
+		if (Fetch->Type == GL_FLOAT)
+		{
+			for (int j = 0; j < Fetch->Components; j++) Dst[j] = ((float*)Src)[j];
+			continue;
+		}
 
-		return FirstResult;
-	}
-	else if (Token->Type == GLSL_TOK_DIV)
-	{
-		glslExValue FirstResult = ExecuteGLSLToken(Token->First);
-		glslExValue SecondResult = ExecuteGLSLToken(Token->Second);
+		if (Fetch->Type == GL_HALF_FLOAT)
+		{
+			for (int j = 0; j < Fetch->Components; j++) Dst[j] = HalfToFloat(((uint16_t*)Src)[j]);
+			continue;
+		}
 
-		if (FirstResult.Type != SecondResult.Type)
+		for (int j = 0; j < Fetch->Components; j++)
 		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
+			float Value = Fetch->Type == GL_UNSIGNED_INT ? (float)((uint32_t*)Src)[j] : (float)ReadAttributeInteger(Fetch->Type, Src, j);
+			Value /= j == 3 ? Fetch->RangeW : Fetch->Range;
+			Dst[j] = Fetch->SignedNormalized && Value < -1.0f ? -1.0f : Value;
 		}
+	}
 
-		FirstResult.x /= SecondResult.x;
-		FirstResult.y /= SecondResult.y;
-		FirstResult.z /= SecondResult.z;
-		FirstResult.w /= SecondResult.w;
-		if (SecondResult.i != 0) FirstResult.i /= SecondResult.i;
+	// Components the buffer does not give default to 0, 0, 0, 1
+	if (Fetch->IntegerInput || Fetch->Components == Fetch->InputFloats) return;
 
-		return FirstResult;
+	Dst = Staged + Fetch->StagedOffset;
+
+	for (int i = 0; i < Count; i++, Dst += StagedFloats)
+	{
+		for (int j = Fetch->Components; j < Fetch->InputFloats; j++) Dst[j] = j == 3 ? 1.0f : 0.0f;
 	}
-	else if (Token->Type == GLSL_TOK_TEXTURE)
+}
+
+// Stages the inputs of vertices Vertices[i] of instances Instances[i], for i up to Count - 1
+void FetchVertexBatch(FetchPlan* Plan, const uint32_t* Vertices, const uint32_t* Instances, int Count, float* Staged)
+{
+	uint8_t* Data = (uint8_t*)CurrentContext->ActiveVertexArray->VertexBuffer->data;
+
+	for (int i = 0; i < Plan->Fetches.Size; i++)
 	{
-		if (Token->Args.Size != 2)
-		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
-		}
+		FetchAttributeBatch((AttributeFetch*)Plan->Fetches.Data + i, Data, Vertices, Instances, Count, Staged, Plan->StagedFloats);
+	}
+}
+
+void LoadStagedVertex(glslContext* Context, FetchPlan* Plan, float* Staged, uint32_t Instance)
+{
+	for (int i = 0; i < Plan->Fetches.Size; i++)
+	{
+		AttributeFetch* Fetch = (AttributeFetch*)Plan->Fetches.Data + i;
+		memcpy(Context->Frame + Fetch->Slot, Staged + Fetch->StagedOffset, Fetch->InputFloats * sizeof(float));
+	}
+
+	if (CurrentContext->ActiveProgram->InstanceIDVar) *(int*)GLSLVarData(Context, CurrentContext->ActiveProgram->InstanceIDVar) = Instance;
+}
+
+// Copies the outputs transform feedback captures from a shaded vertex, one after another
+void ReadFeedbackVertex(glslContext* Context, float* Out)
+{
+	Program* MyProgram = CurrentContext->ActiveProgram;
+
+	for (int i = 0; i < MyProgram->FeedbackVars.Size; i++)
+	{
+		glslVariable* Var = ((glslVariable**)MyProgram->FeedbackVars.Data)[i];
+		int Size = GLSLTypeSize(Var->Type);
+
+		memcpy(Out, GLSLVarData(Context, Var), Size);
+		Out += Size / sizeof(float);
+	}
+}
+
+// Shades vertex Vertices[First + i] of instance Instances[First + i] into slot Slot + i of the buffer, for i up to Count - 1
+void ShadeVertices(glslContext* Context, FetchPlan* Plan, const uint32_t* Vertices, const uint32_t* Instances, int First, int Count, PostTransformBuffer* Out, int Slot)
+{
+	float* Staged = (float*)malloc(sizeof(float) * MAX(Plan->StagedFloats, 1) * SWGL_FETCH_BATCH);
+
+	for (int i = 0; i < Count; i++)
+	{
+		if (i % SWGL_FETCH_BATCH == 0) FetchVertexBatch(Plan, Vertices + First + i, Instances + First + i, MIN(SWGL_FETCH_BATCH, Count - i), Staged);
+
+		LoadStagedVertex(Context, Plan, Staged + i % SWGL_FETCH_BATCH * Plan->StagedFloats, Instances[First + i]);
+
+		ExecuteGLSL(Context, CurrentContext->ActiveProgram->VertexShader);
 
-		glslToken* TokArg;
+		memcpy(&Out->Positions[Slot + i], GLSLVarData(Context, CurrentContext->ActiveProgram->PositionVar), sizeof(glslVec4));
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue FirstResult = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 1);
-		glslExValue SecondResult = ExecuteGLSLToken(TokArg);
+		float* Varying = Out->Varyings + (Slot + i) * Out->VaryingFloats;
 
-		if (FirstResult.Type != GLSL_SAMPLER2D)
+		for (int j = 0; j < CurrentContext->ActiveProgram->VertexFragInOut.Size; j++)
 		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
-		}
+			_VarPair InOut;
 
-		if (SecondResult.Type != GLSL_VEC2)
-		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
+			swglVectorRead(&CurrentContext->ActiveProgram->VertexFragInOut, &InOut, j);
+
+			if (InOut.first->Type != InOut.second->Type) continue;
+
+			int Size = GLSLTypeSize(InOut.second->Type);
+			memcpy(Varying, GLSLVarData(Context, InOut.second), Size);
+			Varying += Size / sizeof(float);
 		}
 
-		Texture2D* Texture = TextureUnits[FirstResult.i];
+		if (Out->Feedback) ReadFeedbackVertex(Context, Out->Feedback + (Slot + i) * Out->FeedbackFloats);
+	}
+
+	free(Staged);
+}
+
+// Adds the vertex t of the way from slot From to slot To, doubling the buffer when it is full
+int AddInterpolatedVertex(PostTransformBuffer* Buffer, int From, int To, float t)
+{
+	if (Buffer->Count == Buffer->Capacity)
+	{
+		PostTransformBuffer Grown = NewPostTransformBuffer(MAX(Buffer->Capacity * 2, 16));
+		memcpy(Grown.Positions, Buffer->Positions, sizeof(glslVec4) * Buffer->Count);
+		memcpy(Grown.Varyings, Buffer->Varyings, sizeof(float) * Buffer->VaryingFloats * Buffer->Count);
+		if (Grown.Feedback) memcpy(Grown.Feedback, Buffer->Feedback, sizeof(float) * Buffer->FeedbackFloats * Buffer->Count);
+		Grown.Count = Buffer->Count;
 
-		float* TextureData = Texture->Data;
-		int TextureWidth = Texture->Width;
-		int TextureHeight = Texture->Height;
+		FreePostTransformBuffer(Buffer);
+		*Buffer = Grown;
+	}
 
-		float* HigherTextureData = 0;
-		int HigherTextureWidth = 0;
-		int HigherTextureHeight = 0;
+	int Slot = Buffer->Count++;
+	Buffer->Positions[Slot] = InterpolateVec4(Buffer->Positions[From], Buffer->Positions[To], t);
 
-		//float CurrentMipMapLevelX = TextureWidth / (TriangleMaxX - TriangleMinX);
-		//float CurrentMipMapLevelY = TextureHeight / (TriangleMaxY - TriangleMinY);
+	float* Out = Buffer->Varyings + Slot * Buffer->VaryingFloats;
+	float* Varyings0 = Buffer->Varyings + From * Buffer->VaryingFloats;
+	float* Varyings1 = Buffer->Varyings + To * Buffer->VaryingFloats;
+	int Offset = 0;
 
-		//float CurrentMipMapLevel = MAX(CurrentMipMapLevelX, CurrentMipMapLevelY);
+	for (int i = 0; i < CurrentContext->ActiveProgram->VertexFragInOut.Size; i++)
+	{
+		_VarPair InOut;
 
-		float CurrentMipMapLevel = MipMapLevel;
+		swglVectorRead(&CurrentContext->ActiveProgram->VertexFragInOut, &InOut, i);
 
-		if (Texture->MipMaps.Size > 0 && CurrentMipMapLevel > 0.0f)
-		{
-			MipMap2D MipMap;
-			swglVectorRead(&Texture->MipMaps, &MipMap, MIN(CurrentMipMapLevel, Texture->MipMaps.Size - 1));
+		if (InOut.first->Type != InOut.second->Type) continue;
 
-			TextureData = MipMap.Data;
-			TextureWidth = MipMap.Width;
-			TextureHeight = MipMap.Height;
+		int Floats = GLSLTypeSize(InOut.first->Type) / sizeof(float);
 
-			swglVectorRead(&Texture->MipMaps, &MipMap, MIN(CurrentMipMapLevel - 1, Texture->MipMaps.Size - 1));
+		if (InOut.first->Type == GLSL_INT) memcpy(Out + Offset, Varyings0 + Offset, sizeof(int));
+		else for (int j = 0; j < Floats; j++) Out[Offset + j] = Varyings0[Offset + j] + t * (Varyings1[Offset + j] - Varyings0[Offset + j]);
 
-			HigherTextureData = MipMap.Data;
-			HigherTextureWidth = MipMap.Width;
-			HigherTextureHeight = MipMap.Height;
-		}
+		Offset += Floats;
+	}
 
+	return Slot;
+}
 
-		int TexelX = SecondResult.x * TextureWidth;
-		int TexelY = SecondResult.y * TextureHeight;
+// Sutherland-Hodgman against every plane in Planes, on slots of the buffer. New vertices are added to the buffer
+// and the clipped polygon's slots written to Out, to be drawn as a fan. Returns its vertex count
+int ClipTriangle(PostTransformBuffer* Buffer, int* Slots, uint32_t Planes, int* Out)
+{
+	int Polys[2][SWGL_MAX_CLIP_VERTS];
+	int* In = Polys[0];
+	int* Next = Polys[1];
+	int InCount = 3;
 
-		if (Texture->SRepeat == GL_REPEAT)
-		{
-			TexelX %= TextureWidth;
-		}
-		TexelX = MIN(MAX(TexelX, 0), TextureWidth - 1);
+	for (int i = 0; i < 3; i++) In[i] = Slots[i];
 
-		if (Texture->TRepeat == GL_REPEAT)
+	for (uint32_t Plane = SWGL_CLIP_NEAR; Plane <= SWGL_CLIP_GUARD_TOP && InCount >= 3; Plane <<= 1)
+	{
+		if (!(Planes & Plane)) continue;
+
+		float Dist[SWGL_MAX_CLIP_VERTS];
+		for (int i = 0; i < InCount; i++)
 		{
-			TexelY %= TextureHeight;
+			Dist[i] = ClipPlaneDistance(Buffer->Positions[In[i]], Plane);
 		}
-		TexelY = MIN(MAX(TexelY, 0), TextureHeight - 1);
 
-		float* StartData = TextureData + Texture->FloatsPerPixel * (TexelX + TexelY * TextureWidth);
+		int NextCount = 0;
 
-		glslExValue OutVal = { GLSL_VEC4 };
-		if (Texture->FloatsPerPixel >= 1) OutVal.x = StartData[0];
-		if (Texture->FloatsPerPixel >= 2) OutVal.y = StartData[1];
-		if (Texture->FloatsPerPixel >= 3) OutVal.z = StartData[2];
-		if (Texture->FloatsPerPixel == 4) OutVal.w = StartData[3];
-
-		if (HigherTextureData)
+		for (int i = 0; i < InCount; i++)
 		{
-			int HTexelX = SecondResult.x * HigherTextureWidth;
-			int HTexelY = SecondResult.y * HigherTextureHeight;
+			int j = (i + 1) % InCount;
 
-			if (Texture->SRepeat == GL_REPEAT)
-			{
-				HTexelX %= HigherTextureWidth;
-			}
-			HTexelX = MIN(MAX(HTexelX, 0), HigherTextureWidth - 1);
+			float di = Dist[i];
+			float dj = Dist[j];
+
+			if (di >= 0.0f) Next[NextCount++] = In[i];
 
-			if (Texture->TRepeat == GL_REPEAT)
+			if ((di >= 0.0f) != (dj >= 0.0f))
 			{
-				HTexelY %= HigherTextureHeight;
+				// Always interpolate from the inside vertex so shared edges produce identical points
+				int From = di >= 0.0f ? i : j;
+				int To = di >= 0.0f ? j : i;
+				float dFrom = di >= 0.0f ? di : dj;
+				float dTo = di >= 0.0f ? dj : di;
+
+				Next[NextCount++] = AddInterpolatedVertex(Buffer, In[From], In[To], dFrom / (dFrom - dTo));
 			}
-			HTexelY = MIN(MAX(HTexelY, 0), HigherTextureHeight - 1);
+		}
 
-			StartData = HigherTextureData + Texture->FloatsPerPixel * (HTexelX + HTexelY * HigherTextureWidth);
+		int* Temp = In;
+		In = Next;
+		Next = Temp;
+		InCount = NextCount;
+	}
+
+	if (InCount < 3) return 0;
+
+	memcpy(Out, In, sizeof(int) * InCount);
+	return InCount;
+}
 
-			float T = CurrentMipMapLevel - (int)CurrentMipMapLevel;
+typedef struct
+{
+	FetchPlan* Plan;
+	const uint32_t* Vertices;
+	const uint32_t* Instances;
+	int First;
+	int Count;
+	PostTransformBuffer* Out;
+	int Slot;
+} VertexShadingJob;
 
-			T = 1.0f - T;
+void ShadeVertexJob(void* Arg)
+{
+	VertexShadingJob* Job = (VertexShadingJob*)Arg;
 
-			if (Texture->FloatsPerPixel >= 1) OutVal.x = OutVal.x + T * (StartData[0] - OutVal.x);
-			if (Texture->FloatsPerPixel >= 2) OutVal.y = OutVal.y + T * (StartData[1] - OutVal.y);
-			if (Texture->FloatsPerPixel >= 3) OutVal.z = OutVal.z + T * (StartData[2] - OutVal.z);
-			if (Texture->FloatsPerPixel == 4) OutVal.w = OutVal.w + T * (StartData[3] - OutVal.w);
+	glslContext Context = NewGLSLContext(&CurrentContext->ActiveProgram->VertexShader, VertexUniforms(CurrentContext->ActiveProgram));
+	ShadeVertices(&Context, Job->Plan, Job->Vertices, Job->Instances, Job->First, Job->Count, Job->Out, Job->Slot);
+	FreeGLSLContext(&Context);
+}
 
-		}
+// Each vertex is shaded independently from its own attributes, so splitting the range into jobs
+// gives the same post-transform buffer as shading it in order. The buffer then holds just these vertices
+void ShadeVertexBatch(glslContext* Context, FetchPlan* Plan, const uint32_t* Vertices, const uint32_t* Instances, int First, int Count, PostTransformBuffer* Out)
+{
+	CurrentContext->VertexStats.Shaded += Count;
+	Out->Count = Count;
 
-		return OutVal;
-	}
-	else if (Token->Type == GLSL_TOK_COS)
+	if (CurrentPool()->ThreadCount > 1 && Count >= SWGL_PARALLEL_VERTEX_MIN)
 	{
-		if (Token->Args.Size != 1)
+		VertexShadingJob Jobs[SWGL_VERTEX_BATCH / SWGL_VERTEX_JOB_SIZE];
+		JobGroup Group = { 0 };
+
+		for (int i = 0; i * SWGL_VERTEX_JOB_SIZE < Count; i++)
 		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
+			Jobs[i].Plan = Plan;
+			Jobs[i].Vertices = Vertices;
+			Jobs[i].Instances = Instances;
+			Jobs[i].First = First + i * SWGL_VERTEX_JOB_SIZE;
+			Jobs[i].Count = MIN(SWGL_VERTEX_JOB_SIZE, Count - i * SWGL_VERTEX_JOB_SIZE);
+			Jobs[i].Out = Out;
+			Jobs[i].Slot = i * SWGL_VERTEX_JOB_SIZE;
+			SubmitJob(&Group, ShadeVertexJob, &Jobs[i]);
 		}
 
-		glslToken* TokArg;
-
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue Result = ExecuteGLSLToken(TokArg);
-		Result.x = swgl_cos(Result.x);
-		Result.y = swgl_cos(Result.y);
-		Result.z = swgl_cos(Result.z);
-		Result.w = swgl_cos(Result.w);
-		return Result;
+		WaitJobGroup(&Group);
+		return;
 	}
-	else if (Token->Type == GLSL_TOK_SIN)
+
+	ShadeVertices(Context, Plan, Vertices, Instances, First, Count, Out, 0);
+}
+
+// One draw of a glDraw* call. Element e of the draw is element e % Count of instance e / Count
+typedef struct
+{
+	GLint First;
+	GLsizei Count; // Per instance
+	GLsizei InstanceCount;
+	const void* Indices; // 0 to draw consecutive vertices
+	GLenum IndexType;
+} DrawCall;
+
+// Position in the elements of a list of draws, consumed in order by the batches
+typedef struct
+{
+	int Draw;
+	int64_t Element;
+} DrawCursor;
+
+// The vertices and instances one batch of draws shades, each distinct pair into one slot of the batch's buffer.
+// Indexed draws find repeated pairs through a hash table of the batch's elements, the post-transform cache
+struct VertexCache
+{
+	uint64_t Keys[SWGL_VERTEX_CACHE_SIZE]; // Instance in the high half, vertex in the low half
+	int Entries[SWGL_VERTEX_CACHE_SIZE]; // Slot of the key's vertex
+	uint32_t Stamps[SWGL_VERTEX_CACHE_SIZE]; // Entries are only valid for the batch with the same stamp
+	uint32_t Stamp;
+
+	// Per slot, in the order the elements first used them
+	uint32_t Vertices[SWGL_VERTEX_BATCH];
+	uint32_t Instances[SWGL_VERTEX_BATCH];
+	int VertexCount;
+
+	// Per primitive assembled from the batch's elements, PrimitiveVertices of them each
+	int Slots[SWGL_VERTEX_BATCH * 3];
+	int PrimitiveCount;
+
+	// The slots a strip, fan or loop's next primitive is made with. Carried over from the previous batch
+	// they are the vertices and instances to shade again, if the primitive goes on in this batch
+	int Held[2];
+	uint32_t HeldVertices[2];
+	uint32_t HeldInstances[2];
+	int HeldCount;
+	uint8_t HeldCarried;
+};
+
+// Vertices of each primitive a mode assembles, strips, fans and loops give separate triangles and lines
+int PrimitiveVertices(GLenum Mode)
+{
+	if (Mode == GL_POINTS) return 1;
+	if (Mode == GL_LINES || Mode == GL_LINE_STRIP || Mode == GL_LINE_LOOP) return 2;
+	return 3;
+}
+
+uint32_t ReadElementIndex(const void* Indices, GLenum Type, int i)
+{
+	if (Type == GL_UNSIGNED_BYTE) return ((const uint8_t*)Indices)[i];
+	if (Type == GL_UNSIGNED_SHORT) return ((const uint16_t*)Indices)[i];
+	return ((const uint32_t*)Indices)[i];
+}
+
+// Moves the cursor past the next element of the draws, one of Count vertices or indices from First on
+DrawCall* NextDrawElement(DrawCall* Draws, DrawCursor* Cursor, uint32_t* Element, uint32_t* Instance)
+{
+	DrawCall* Draw = &Draws[Cursor->Draw];
+
+	while (Cursor->Element >= (int64_t)Draw->Count * Draw->InstanceCount)
 	{
-		if (Token->Args.Size != 1)
-		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
-		}
+		Draw = &Draws[++Cursor->Draw];
+		Cursor->Element = 0;
+	}
 
-		glslToken* TokArg;
+	*Instance = Cursor->Element / Draw->Count;
+	*Element = Draw->First + Cursor->Element % Draw->Count;
+	Cursor->Element++;
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue Result = ExecuteGLSLToken(TokArg);
-		Result.x = swgl_sin(Result.x);
-		Result.y = swgl_sin(Result.y);
-		Result.z = swgl_sin(Result.z);
-		Result.w = swgl_sin(Result.w);
-		return Result;
+	return Draw;
+}
+
+// Slot of a vertex and instance in the batch, vertices of indexed draws are only shaded once per batch
+int CacheVertex(VertexCache* Cache, uint32_t Vertex, uint32_t Instance, uint8_t Indexed)
+{
+	if (!Indexed)
+	{
+		Cache->Vertices[Cache->VertexCount] = Vertex;
+		Cache->Instances[Cache->VertexCount] = Instance;
+		return Cache->VertexCount++;
 	}
-	else if (Token->Type == GLSL_TOK_TAN)
+
+	uint64_t Key = (uint64_t)Instance << 32 | Vertex;
+	uint32_t Entry = ((Vertex ^ Instance * 0x9E3779B9u) * 2654435761u) & (SWGL_VERTEX_CACHE_SIZE - 1);
+
+	while (Cache->Stamps[Entry] == Cache->Stamp && Cache->Keys[Entry] != Key) Entry = (Entry + 1) & (SWGL_VERTEX_CACHE_SIZE - 1);
+
+	if (Cache->Stamps[Entry] == Cache->Stamp)
 	{
-		if (Token->Args.Size != 1)
-		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
-		}
+		CurrentContext->VertexStats.CacheHits++;
+		return Cache->Entries[Entry];
+	}
 
-		glslToken* TokArg;
+	Cache->Keys[Entry] = Key;
+	Cache->Entries[Entry] = Cache->VertexCount;
+	Cache->Stamps[Entry] = Cache->Stamp;
+	Cache->Vertices[Cache->VertexCount] = Vertex;
+	Cache->Instances[Cache->VertexCount] = Instance;
+	CurrentContext->VertexStats.CacheMisses++;
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue Result = ExecuteGLSLToken(TokArg);
-		Result.x = swgl_tan(Result.x);
-		Result.y = swgl_tan(Result.y);
-		Result.z = swgl_tan(Result.z);
-		Result.w = swgl_tan(Result.w);
-		return Result;
+	return Cache->VertexCount++;
+}
+
+// Assembles the primitives of the draws' next elements, at most Remaining, until the batch is full.
+// Lists take 3 elements per triangle, 2 per line or 1 per point. Strips and fans take 1, pairing it with the two held vertices,
+// and strips swap the held pair on odd triangles to keep the winding. Line strips and loops hold their first
+// and last vertex, loops close on the first at the end of each instance. Returns the elements consumed
+int64_t CacheBatchVertices(VertexCache* Cache, GLenum Mode, DrawCall* Draws, DrawCursor* Cursor, int64_t Remaining)
+{
+	Cache->VertexCount = 0;
+	Cache->PrimitiveCount = 0;
+	Cache->Stamp++;
+	if (!Cache->Stamp)
+	{
+		memset(Cache->Stamps, 0, sizeof(Cache->Stamps));
+		Cache->Stamp = 1;
 	}
-	else if (Token->Type == GLSL_TOK_MIN)
+
+	if (Mode == GL_TRIANGLES || Mode == GL_LINES || Mode == GL_POINTS)
 	{
-		if (Token->Args.Size != 2)
-		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
-		}
+		int Count = MIN(SWGL_VERTEX_BATCH, Remaining);
 
-		glslToken* TokArg;
+		for (int i = 0; i < Count; i++)
+		{
+			uint32_t Element, Instance;
+			DrawCall* Draw = NextDrawElement(Draws, Cursor, &Element, &Instance);
+			uint32_t Vertex = Draw->Indices ? ReadElementIndex(Draw->Indices, Draw->IndexType, Element) : Element;
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue FirstResult = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 1);
-		glslExValue SecondResult = ExecuteGLSLToken(TokArg);
+			Cache->Slots[i] = CacheVertex(Cache, Vertex, Instance, Draw->Indices != 0);
+		}
 
-		FirstResult.x = MIN(FirstResult.x, SecondResult.x);
-		FirstResult.y = MIN(FirstResult.y, SecondResult.y);
-		FirstResult.z = MIN(FirstResult.z, SecondResult.z);
-		FirstResult.w = MIN(FirstResult.w, SecondResult.w);
-		return FirstResult;
+		Cache->PrimitiveCount = Count / PrimitiveVertices(Mode);
+		return Count;
 	}
-	else if (Token->Type == GLSL_TOK_MAX)
+
+	// Slots of the previous batch, only their vertices and instances are kept
+	if (Cache->HeldCount)
 	{
-		if (Token->Args.Size != 2)
+		for (int i = 0; i < Cache->HeldCount; i++)
 		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
+			Cache->HeldVertices[i] = Cache->Vertices[Cache->Held[i]];
+			Cache->HeldInstances[i] = Cache->Instances[Cache->Held[i]];
 		}
 
-		glslToken* TokArg;
+		Cache->HeldCarried = 1;
+	}
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue FirstResult = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 1);
-		glslExValue SecondResult = ExecuteGLSLToken(TokArg);
+	int64_t Consumed = 0;
 
-		FirstResult.x = MAX(FirstResult.x, SecondResult.x);
-		FirstResult.y = MAX(FirstResult.y, SecondResult.y);
-		FirstResult.z = MAX(FirstResult.z, SecondResult.z);
-		FirstResult.w = MAX(FirstResult.w, SecondResult.w);
-		return FirstResult;
-	}
-	else if (Token->Type == GLSL_TOK_SWIZZLE)
+	// A new element adds at most 1 vertex and 2 primitives, and carrying the held pair 2 more vertices
+	while (Consumed < Remaining && Cache->VertexCount + 3 <= SWGL_VERTEX_BATCH && Cache->PrimitiveCount + 2 <= SWGL_VERTEX_BATCH)
 	{
-		glslExValue Input = ExecuteGLSLToken(Token->First);
+		uint32_t Element, Instance;
+		DrawCall* Draw = NextDrawElement(Draws, Cursor, &Element, &Instance);
+		uint32_t Vertex = Draw->Indices ? ReadElementIndex(Draw->Indices, Draw->IndexType, Element) : Element;
+		uint32_t Local = Element - Draw->First;
 
-		glslExValue Output;
+		Consumed++;
 
-		for (int i = 0; i < Token->Swizzle.Size; i++)
+		// Each instance starts a new primitive
+		if (Local == 0)
 		{
-			float CurVal = 0;
-			int CurSwizzle;
+			Cache->HeldCount = 0;
+			Cache->HeldCarried = 0;
+		}
+		else if (Cache->HeldCarried)
+		{
+			for (int i = 0; i < Cache->HeldCount; i++) Cache->Held[i] = CacheVertex(Cache, Cache->HeldVertices[i], Cache->HeldInstances[i], 0);
 
-			swglVectorRead(&Token->Swizzle, &CurSwizzle, i);
+			Cache->HeldCarried = 0;
+		}
 
-			if (CurSwizzle == 0)
-			{
-				CurVal = Input.x;
-			}
-			else if (CurSwizzle == 1)
-			{
-				CurVal = Input.y;
-			}
-			else if (CurSwizzle == 2)
-			{
-				CurVal = Input.z;
-			}
-			else if (CurSwizzle == 3)
-			{
-				CurVal = Input.w;
-			}
+		int Slot = CacheVertex(Cache, Vertex, Instance, Draw->Indices != 0);
 
-			if (i == 0)
-			{
-				Output.x = CurVal;
-			}
-			else if (i == 1)
-			{
-				Output.y = CurVal;
-			}
-			else if (i == 2)
+		if (Mode == GL_LINE_STRIP || Mode == GL_LINE_LOOP)
+		{
+			if (Local == 0)
 			{
-				Output.z = CurVal;
+				Cache->Held[0] = Cache->Held[1] = Slot;
+				Cache->HeldCount = 2;
+				continue;
 			}
-			else if (i == 3)
+
+			int* Line = &Cache->Slots[Cache->PrimitiveCount++ * 2];
+			Line[0] = Cache->Held[1];
+			Line[1] = Slot;
+
+			Cache->Held[1] = Slot;
+
+			if (Mode == GL_LINE_LOOP && Local == Draw->Count - 1)
 			{
-				Output.w = CurVal;
+				Line = &Cache->Slots[Cache->PrimitiveCount++ * 2];
+				Line[0] = Slot;
+				Line[1] = Cache->Held[0];
 			}
+			continue;
 		}
 
-		if (Token->Swizzle.Size == 0)
-		{
-			glslExValue ExOutput = { GLSL_UNKNOWN };
-			return ExOutput;
-		}
-		else if (Token->Swizzle.Size == 1)
-		{
-			Output.Type = GLSL_FLOAT;
-		}
-		else if (Token->Swizzle.Size == 2)
-		{
-			Output.Type = GLSL_VEC2;
-		}
-		else if (Token->Swizzle.Size == 3)
-		{
-			Output.Type = GLSL_VEC3;
-		}
-		else if (Token->Swizzle.Size == 4)
+		if (Cache->HeldCount < 2)
 		{
-			Output.Type = GLSL_VEC4;
+			Cache->Held[Cache->HeldCount++] = Slot;
+			continue;
 		}
-		return Output;
-	}
-	else if (Token->Type == GLSL_TOK_FLOAT_CONSTRUCT)
-	{
-		glslToken* TokArg;
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue Arg0 = ExecuteGLSLToken(TokArg);
+		int* Triangle = &Cache->Slots[Cache->PrimitiveCount++ * 3];
+		uint8_t Odd = Mode == GL_TRIANGLE_STRIP && (Local & 1);
 
-		glslExValue ExOutput = { GLSL_FLOAT, Arg0.Type != GLSL_INT ? Arg0.x : (float)Arg0.i };
-		return ExOutput;
+		Triangle[0] = Cache->Held[Odd];
+		Triangle[1] = Cache->Held[!Odd];
+		Triangle[2] = Slot;
+
+		// Fans keep their first vertex, strips move on to the last two
+		if (Mode == GL_TRIANGLE_STRIP) Cache->Held[0] = Cache->Held[1];
+		Cache->Held[1] = Slot;
 	}
-	else if (Token->Type == GLSL_TOK_VEC2_CONSTRUCT)
-	{
-		glslToken* TokArg;
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue Arg0 = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 1);
-		glslExValue Arg1 = ExecuteGLSLToken(TokArg);
+	return Consumed;
+}
 
-		glslExValue ExOutput = { GLSL_VEC2,
-			Arg0.Type != GLSL_INT ? Arg0.x : (float)Arg0.i,
-			Arg1.Type != GLSL_INT ? Arg1.x : (float)Arg1.i
-		};
-		return ExOutput;
-	}
-	else if (Token->Type == GLSL_TOK_VEC3_CONSTRUCT)
-	{
-		glslToken* TokArg;
+/*
+* TILED RASTERIZATION
+* The framebuffer is split into fixed cells. Each vertex batch bins its triangles into the cells they touch
+* and queues one job per touched cell, then the drawing thread moves on to shade and bin the next batch.
+* A cell rasterizes its tiles one at a time in batch order, so pixels are written in submission order
+* while different cells and later batches' geometry run in parallel. Batches hold a copy of the drawing state
+* they were drawn with, calls that write what raster jobs read, or read what they write, finish them first
+*/
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue Arg0 = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 1);
-		glslExValue Arg1 = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 2);
-		glslExValue Arg2 = ExecuteGLSLToken(TokArg);
+// Cells are rasterized as independent jobs, without threads a single cell covers any framebuffer
+#if SWGL_THREAD_COUNT > 1
+#define SWGL_TILE_SIZE 64
+#else
+#define SWGL_TILE_SIZE 0x40000000
+#endif
 
-		glslExValue ExOutput = { GLSL_VEC3,
-			Arg0.Type != GLSL_INT ? Arg0.x : (float)Arg0.i,
-			Arg1.Type != GLSL_INT ? Arg1.x : (float)Arg1.i,
-			Arg2.Type != GLSL_INT ? Arg2.x : (float)Arg2.i
-		};
-		return ExOutput;
-	}
-	else if (Token->Type == GLSL_TOK_VEC4_CONSTRUCT)
-	{
-		glslToken* TokArg;
+typedef enum
+{
+	SWGL_RASTER_SCANLINE,
+	SWGL_RASTER_SMALL,
+	SWGL_RASTER_MULTISAMPLE,
+} RasterPath;
+
+// A triangle snapped to window coordinates, waiting for the tiles it was binned to
+typedef struct
+{
+	glslVec4 Coords[3];
+	float Area;
+	RasterPath Path;
+	int Slots[3]; // Into the batch's post-transform buffer
+	uint8_t Covered;
+} ScreenTriangle;
+
+// SWGL_TILE_SIZE square of framebuffer pixels, in rows as stored so the same pixels map to it under any viewport
+struct RasterCell
+{
+	_SwglVector Waiting; // RasterTile* queued behind the running one, oldest first
+	int WaitingHead;
+	uint8_t Running;
+
+	// Compiled token trees are never freed, so their function list identifies the shader the lanes were made for
+	void* LaneShader;
+	glslContext Lanes[4];
+};
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue Arg0 = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 1);
-		glslExValue Arg1 = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 2);
-		glslExValue Arg2 = ExecuteGLSLToken(TokArg);
-		swglVectorRead(&Token->Args, &TokArg, 3);
-		glslExValue Arg3 = ExecuteGLSLToken(TokArg);
+// The triangles assembled from one vertex batch, rasterized while later batches are shaded
+struct RasterBatch
+{
+	swglContext* Owner;
 
-		glslExValue ExOutput = { GLSL_VEC4,
-			Arg0.Type != GLSL_INT ? Arg0.x : (float)Arg0.i,
-			Arg1.Type != GLSL_INT ? Arg1.x : (float)Arg1.i,
-			Arg2.Type != GLSL_INT ? Arg2.x : (float)Arg2.i,
-			Arg3.Type != GLSL_INT ? Arg3.x : (float)Arg3.i
-		};
-		return ExOutput;
-	}
-	else if (Token->Type == GLSL_TOK_INT_CONSTRUCT)
-	{
-		glslToken* TokArg;
+	// Raster jobs run with this copy current, drawing state and uniforms as they were when the batch was drawn
+	swglContext State;
+	Program DrawProgram;
 
-		swglVectorRead(&Token->Args, &TokArg, 0);
-		glslExValue Arg0 = ExecuteGLSLToken(TokArg);
+	PostTransformBuffer Transformed;
+	JobGroup Group;
 
-		glslExValue ExOutput = { GLSL_INT, 0.0f, 0.0f, 0.0f, 0.0f, Arg0.Type != GLSL_INT ? (int)Arg0.x : Arg0.i };
-		return ExOutput;
-	}
-}
+	_SwglVector Triangles;
+
+	int ScanMinX;
+	int ScanMinY;
+	int ScanMaxX;
+	int ScanMaxY;
+	int RowFlip; // Window row y is stored in framebuffer row RowFlip - y
 
-void ExecuteGLSLFunction(glslFunction* Func)
+	RasterTile** Tiles; // Per cell, 0 until a triangle touches it
+	_SwglVector UsedTiles; // RasterTile*, in the order they were first touched
+};
+
+void InitRasterCells()
 {
-	for (int i = 0; i < Func->RootScope->Lines.Size; i++)
-	{
-		glslToken* LineTok;
+	CurrentContext->RasterCellsX = (CurrentContext->Framebuffer->Width + SWGL_TILE_SIZE - 1) / SWGL_TILE_SIZE;
+	CurrentContext->RasterCellsY = (CurrentContext->Framebuffer->Height + SWGL_TILE_SIZE - 1) / SWGL_TILE_SIZE;
 
-		swglVectorRead(&Func->RootScope->Lines, &LineTok, i);
+	int CellCount = CurrentContext->RasterCellsX * CurrentContext->RasterCellsY;
+	CurrentContext->RasterCells = (RasterCell*)malloc(sizeof(RasterCell) * MAX(CellCount, 1));
 
-		if (!LineTok) continue;
-		ExecuteGLSLToken(LineTok);
+	for (int i = 0; i < CellCount; i++)
+	{
+		RasterCell* Cell = &CurrentContext->RasterCells[i];
+
+		Cell->Waiting = swglNewVector(sizeof(RasterTile*));
+		Cell->WaitingHead = 0;
+		Cell->Running = 0;
+		Cell->LaneShader = 0;
 	}
 }
 
-void ExecuteGLSL(glslTokenized Tokens)
+void FreeRasterCells(swglContext* Context)
 {
-	for (int i = 0; i < Tokens.Funcs.Size; i++)
-	{
-		glslFunction* Func;
+	if (!Context->RasterCells) return;
 
-		swglVectorRead(&Tokens.Funcs, &Func, i);
+	for (int i = 0; i < Context->RasterCellsX * Context->RasterCellsY; i++)
+	{
+		RasterCell* Cell = &Context->RasterCells[i];
 
-		if (swglStringEquals(Func->Name, "main"))
+		if (Cell->LaneShader)
 		{
-			ExecuteGLSLFunction(Func);
+			for (int j = 0; j < 4; j++) FreeGLSLContext(&Cell->Lanes[j]);
 		}
+
+		swglVectorFree(&Cell->Waiting);
 	}
-}
 
-GLuint glCreateShader(GLenum type)
-{
-	RawShader* Shader = (RawShader*)malloc(sizeof(RawShader));
-	Shader->Type = type;
-	swglVectorPushBack(&GlobalShaders, &Shader);
-	return GlobalShaders.Size - 1;
+	free(Context->RasterCells);
+	Context->RasterCells = 0;
 }
 
-void glShaderSource(GLuint shader, const GLchar* string)
+RasterBatch* NewRasterBatch(int VertexCount)
 {
-	_SwglString* ShaderCode = swglCString2String((const char*)string);
+	if (!CurrentContext->RasterCells) InitRasterCells();
 
-	RawShader* TargetShader = ((RawShader**)GlobalShaders.Data)[shader];
+	RasterBatch* Batch = (RasterBatch*)malloc(sizeof(RasterBatch));
 
-	TargetShader->MyCode = ShaderCode;
-}
+	Batch->Owner = CurrentContext;
+	Batch->DrawProgram = *CurrentContext->ActiveProgram;
 
-void glCompileShader(GLuint shader)
-{
-	RawShader* TargetShader = ((RawShader**)GlobalShaders.Data)[shader];
+	// Only the state rasterization reads, the rest of the context can be in use by the recording thread
+	memset(&Batch->State, 0, sizeof(swglContext));
+	Batch->State.ActiveProgram = &Batch->DrawProgram;
+	Batch->State.Framebuffer = CurrentContext->Framebuffer;
+	Batch->State.ViewportX = CurrentContext->ViewportX;
+	Batch->State.ViewportY = CurrentContext->ViewportY;
+	Batch->State.ViewportWidth = CurrentContext->ViewportWidth;
+	Batch->State.ViewportHeight = CurrentContext->ViewportHeight;
+	Batch->State.MultisampleEnabled = CurrentContext->MultisampleEnabled;
+	Batch->State.ThreadPool = CurrentContext->ThreadPool;
+	memcpy(Batch->State.TextureUnits, CurrentContext->TextureUnits, sizeof(CurrentContext->TextureUnits));
 
-	TargetShader->CompiledData = GLSLTokenize(TargetShader->MyCode);
-	TargetShader->Compiled = 1;
-}
+	int UniformBlockSize = MAX(Batch->DrawProgram.VertexShader.UniformSize + Batch->DrawProgram.FragmentShader.UniformSize, 1);
+	Batch->DrawProgram.UniformBlock = (uint8_t*)malloc(UniformBlockSize);
+	memcpy(Batch->DrawProgram.UniformBlock, CurrentContext->ActiveProgram->UniformBlock, UniformBlockSize);
 
-void glDeleteShader(GLuint shader)
-{
-	// Deletion is for bitches;
+	Batch->Transformed = NewPostTransformBuffer(VertexCount);
+	Batch->Group.Pending = 0;
+	Batch->Group.Pool = 0;
+
+	Batch->Triangles = swglNewVector(sizeof(ScreenTriangle));
+
+	GetScanBounds(&Batch->ScanMinX, &Batch->ScanMinY, &Batch->ScanMaxX, &Batch->ScanMaxY);
+	Batch->RowFlip = 2 * CurrentContext->ViewportY + (int)CurrentContext->ViewportHeight - 1;
+
+	Batch->Tiles = (RasterTile**)calloc(MAX(CurrentContext->RasterCellsX * CurrentContext->RasterCellsY, 1), sizeof(RasterTile*));
+	Batch->UsedTiles = swglNewVector(sizeof(RasterTile*));
+
+	return Batch;
 }
 
-typedef struct
+// The batch's tile for a cell, created the first time a triangle is binned to it
+RasterTile* GetRasterTile(RasterBatch* Batch, int CellX, int CellY)
 {
-	uint8_t Linked;
-	_SwglVector VertexFragInOut;
-	_SwglVector Uniforms;
-	_SwglVector Layouts;
+	int Cell = CellX + CellY * CurrentContext->RasterCellsX;
 
-	uint8_t HasVertex;
-	uint8_t HasFrag;
-	glslTokenized VertexShader;
-	glslTokenized FragmentShader;
-} Program;
+	if (Batch->Tiles[Cell]) return Batch->Tiles[Cell];
 
-Program* ActiveProgram;
-_SwglVector GlobalPrograms;
+	RasterTile* Tile = (RasterTile*)malloc(sizeof(RasterTile));
+	Tile->Batch = Batch;
+	Tile->Cell = Cell;
 
-GLuint glCreateProgram()
-{
-	Program* NewProgram = (Program*)malloc(sizeof(Program));
-	NewProgram->VertexFragInOut = swglNewVector(sizeof(_VarPair));
-	NewProgram->Linked = 0;
-	swglVectorPushBack(&GlobalPrograms, &NewProgram);
-	return GlobalPrograms.Size;
+	// Framebuffer rows CellY * SWGL_TILE_SIZE and up are the window rows counting down from RowFlip
+	Tile->MinX = MAX(CellX * SWGL_TILE_SIZE, Batch->ScanMinX);
+	Tile->MaxX = MIN((CellX + 1) * SWGL_TILE_SIZE, Batch->ScanMaxX);
+	Tile->MinY = MAX(Batch->RowFlip - (CellY + 1) * SWGL_TILE_SIZE + 1, Batch->ScanMinY);
+	Tile->MaxY = MIN(Batch->RowFlip - CellY * SWGL_TILE_SIZE + 1, Batch->ScanMaxY);
+
+	Tile->Triangles = swglNewVector(sizeof(int));
+	Tile->Covered = swglNewVector(sizeof(uint8_t));
+
+	Batch->Tiles[Cell] = Tile;
+	swglVectorPushBack(&Batch->UsedTiles, &Tile);
+
+	return Tile;
 }
 
-void glAttachShader(GLuint program, GLuint shader)
+// Maps a clip space triangle to the window, picks its rasterization path and bins it into every tile its
+// bounding box touches. Tri carries where its vertex data comes from
+void SetupScreenTriangle(RasterBatch* Batch, glslVec4* Verts, ScreenTriangle* Tri)
 {
-	Program* MyProgram;
-	RawShader* MyShader;
+	uint8_t Multisampling = IsMultisampling();
+
+	for (int j = 0; j < 3; j++)
+	{
+		float OutPosX = Verts[j].x / Verts[j].w * (CurrentContext->ViewportWidth / 2) + (CurrentContext->ViewportWidth / 2) + CurrentContext->ViewportX;
+		float OutPosY = Verts[j].y / Verts[j].w * (CurrentContext->ViewportHeight / 2) + (CurrentContext->ViewportHeight / 2) + CurrentContext->ViewportY;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, program - 1);
-	swglVectorRead(&GlobalShaders, &MyShader, shader);
+		// Single sampled rasterization snaps to whole pixels, multisampled keeps 1/16 of a pixel for its sample offsets
+		if (Multisampling)
+		{
+			OutPosX = (int)(OutPosX * 16.0f) / 16.0f;
+			OutPosY = (int)(OutPosY * 16.0f) / 16.0f;
+		}
+		else
+		{
+			OutPosX = (int)OutPosX;
+			OutPosY = (int)OutPosY;
+		}
 
-	if (MyShader->Type == GL_VERTEX_SHADER)
+		Tri->Coords[j].x = OutPosX;
+		Tri->Coords[j].y = OutPosY;
+		Tri->Coords[j].z = Verts[j].z;
+		Tri->Coords[j].w = Verts[j].w;
+	}
+
+	glslVec4* ScreenCoords = Tri->Coords;
+
+	// Vertices are snapped to whole pixels, so slivers can collapse after the clip-space test
+	Tri->Area = (ScreenCoords[1].x - ScreenCoords[0].x) * (ScreenCoords[2].y - ScreenCoords[0].y) - (ScreenCoords[2].x - ScreenCoords[0].x) * (ScreenCoords[1].y - ScreenCoords[0].y);
+
+	if (Tri->Area == 0.0f)
 	{
-		MyProgram->HasVertex = 1;
-		MyProgram->VertexShader = MyShader->CompiledData;
+		CurrentContext->TriangleStats.Degenerate++;
+		return;
 	}
-	if (MyShader->Type == GL_FRAGMENT_SHADER)
+
+	float MinX = MIN(MIN(ScreenCoords[0].x, ScreenCoords[1].x), ScreenCoords[2].x);
+	float MaxX = MAX(MAX(ScreenCoords[0].x, ScreenCoords[1].x), ScreenCoords[2].x);
+	float MinY = MIN(MIN(ScreenCoords[0].y, ScreenCoords[1].y), ScreenCoords[2].y);
+	float MaxY = MAX(MAX(ScreenCoords[0].y, ScreenCoords[1].y), ScreenCoords[2].y);
+
+	if (Multisampling)
 	{
-		MyProgram->HasFrag = 1;
-		MyProgram->FragmentShader = MyShader->CompiledData;
+		Tri->Path = SWGL_RASTER_MULTISAMPLE;
+	}
+	else if (MaxX - MinX <= SWGL_SMALL_TRIANGLE_SIZE && MaxY - MinY <= SWGL_SMALL_TRIANGLE_SIZE)
+	{
+		Tri->Path = SWGL_RASTER_SMALL;
+	}
+	else
+	{
+		Tri->Path = SWGL_RASTER_SCANLINE;
+		CurrentContext->TriangleStats.Scanline++;
+	}
+
+	Tri->Covered = 0;
+
+	int Index = Batch->Triangles.Size;
+	swglVectorPushBack(&Batch->Triangles, Tri);
+
+	// Widened like the multisample bounding box, the pixels a path may touch stay inside it
+	int PixelMinX = MAX((int)MinX - 1, Batch->ScanMinX);
+	int PixelMaxX = MIN((int)MaxX + 2, Batch->ScanMaxX - 1);
+	int PixelMinY = MAX((int)MinY - 1, Batch->ScanMinY);
+	int PixelMaxY = MIN((int)MaxY + 2, Batch->ScanMaxY - 1);
+
+	if (PixelMinX > PixelMaxX || PixelMinY > PixelMaxY) return;
+
+	uint8_t NotCovered = 0;
+
+	for (int y = (Batch->RowFlip - PixelMaxY) / SWGL_TILE_SIZE; y <= (Batch->RowFlip - PixelMinY) / SWGL_TILE_SIZE; y++)
+	{
+		for (int x = PixelMinX / SWGL_TILE_SIZE; x <= PixelMaxX / SWGL_TILE_SIZE; x++)
+		{
+			RasterTile* Tile = GetRasterTile(Batch, x, y);
+			swglVectorPushBack(&Tile->Triangles, &Index);
+			swglVectorPushBack(&Tile->Covered, &NotCovered);
+		}
 	}
 }
 
-void glLinkProgram(GLuint program)
+void RasterizeTile(void* Arg);
+
+// Starts the tile, or queues it behind its cell's running tile
+void QueueRasterTile(RasterTile* Tile)
 {
-	Program* MyProgram;
+	RasterBatch* Batch = Tile->Batch;
+	RasterCell* Cell = &Batch->Owner->RasterCells[Tile->Cell];
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, program - 1);
+	HoldJob(&Batch->Group);
 
-	_SwglVector VertOuts = swglNewVector(sizeof(glslVariable*));
-	_SwglVector FragIns = swglNewVector(sizeof(glslVariable*));
+#ifdef SWGL_THREADS
+	pthread_mutex_lock(&Batch->Owner->RasterLock);
+#endif
+	uint8_t Running = Cell->Running;
+	if (Running) swglVectorPushBack(&Cell->Waiting, &Tile);
+	Cell->Running = 1;
+#ifdef SWGL_THREADS
+	pthread_mutex_unlock(&Batch->Owner->RasterLock);
+#endif
 
-	_SwglVector Uniforms = swglNewVector(sizeof(glslVariable*));
-	_SwglVector Layouts = swglNewVector(sizeof(glslVariable*));
+	if (!Running) SubmitHeldJob(&Batch->Group, RasterizeTile, Tile);
+}
 
+// Rasterizes the tile's triangles in submission order, then starts the next tile queued on its cell
+void RasterizeTile(void* Arg)
+{
+	RasterTile* Tile = (RasterTile*)Arg;
+	RasterBatch* Batch = Tile->Batch;
+	swglContext* Owner = Batch->Owner;
+	RasterCell* Cell = &Owner->RasterCells[Tile->Cell];
 
-	for (int i = 0; i < MyProgram->VertexShader.GlobalVars.Size; i++)
+	if (Cell->LaneShader != Batch->DrawProgram.FragmentShader.Funcs.Data)
 	{
-		glslVariable* VertVar;
-
-		swglVectorRead(&MyProgram->VertexShader.GlobalVars, &VertVar, i);
+		if (Cell->LaneShader)
+		{
+			for (int i = 0; i < 4; i++) FreeGLSLContext(&Cell->Lanes[i]);
+		}
 
-		if (VertVar->isOut) swglVectorPushBack(&VertOuts, &VertVar);
-		if (VertVar->isUniform) swglVectorPushBack(&Uniforms, &VertVar);
-		if (VertVar->isLayout) swglVectorPushBack(&Layouts, &VertVar);
+		for (int i = 0; i < 4; i++) Cell->Lanes[i] = NewGLSLQuadLane(&Batch->DrawProgram.FragmentShader, 0);
+		Cell->LaneShader = Batch->DrawProgram.FragmentShader.Funcs.Data;
 	}
 
-	for (int i = 0; i < MyProgram->FragmentShader.GlobalVars.Size; i++)
+	for (int i = 0; i < 4; i++) Cell->Lanes[i].Uniforms = FragmentUniforms(&Batch->DrawProgram);
+	Tile->Lanes = Cell->Lanes;
+
+	CurrentContext = &Batch->State;
+
+	for (int i = 0; i < Tile->Triangles.Size; i++)
 	{
-		glslVariable* FragVar;
+		ScreenTriangle* Tri = (ScreenTriangle*)Batch->Triangles.Data + ((int*)Tile->Triangles.Data)[i];
 
-		swglVectorRead(&MyProgram->FragmentShader.GlobalVars, &FragVar, i);
+		// The raster paths sort their arguments in place
+		glslVec4 Coords[3];
+		float* Varyings[3];
 
-		if (FragVar->isIn) swglVectorPushBack(&FragIns, &FragVar);
-		if (FragVar->isUniform) swglVectorPushBack(&Uniforms, &FragVar);
-		if (FragVar->isLayout) swglVectorPushBack(&Layouts, &FragVar);
+		for (int j = 0; j < 3; j++)
+		{
+			Coords[j] = Tri->Coords[j];
+			Varyings[j] = Batch->Transformed.Varyings + Tri->Slots[j] * Batch->Transformed.VaryingFloats;
+		}
+
+		uint8_t Covered = 1;
+
+		if (Tri->Path == SWGL_RASTER_MULTISAMPLE) Covered = DrawMultisampleTriangle(Tile, Coords, Varyings, Tri->Area);
+		else if (Tri->Path == SWGL_RASTER_SMALL) Covered = DrawSmallTriangle(Tile, Coords, Varyings, Tri->Area);
+		else DrawTriangle(Tile, Coords, Varyings);
+
+		((uint8_t*)Tile->Covered.Data)[i] = Covered;
 	}
 
-	MyProgram->Uniforms = Uniforms;
-	MyProgram->Layouts = Layouts;
+	CurrentContext = Owner;
 
-	for (int i = 0; i < FragIns.Size; i++)
+	RasterTile* Next = 0;
+
+#ifdef SWGL_THREADS
+	pthread_mutex_lock(&Owner->RasterLock);
+#endif
+	if (Cell->WaitingHead < Cell->Waiting.Size)
 	{
-		glslVariable* FragIn;
+		Next = ((RasterTile**)Cell->Waiting.Data)[Cell->WaitingHead++];
+		if (Cell->WaitingHead == Cell->Waiting.Size) Cell->Waiting.Size = Cell->WaitingHead = 0;
+	}
+	else
+	{
+		Cell->Running = 0;
+	}
+#ifdef SWGL_THREADS
+	pthread_mutex_unlock(&Owner->RasterLock);
+#endif
 
-		swglVectorRead(&FragIns, &FragIn, i);
+	// Already held in its batch's group when it was queued
+	if (Next) SubmitHeldJob(&Next->Batch->Group, RasterizeTile, Next);
+}
 
-		uint8_t LinkedPair = 0;
+// Waits for the batch's tiles, counts their coverage and frees the batch
+void RetireRasterBatch(RasterBatch* Batch)
+{
+	WaitJobGroup(&Batch->Group);
 
-		for (int j = 0; j < VertOuts.Size; j++)
-		{
-			glslVariable* VertOut;
+	ScreenTriangle* Triangles = (ScreenTriangle*)Batch->Triangles.Data;
 
-			swglVectorRead(&VertOuts, &VertOut, j);
+	for (int i = 0; i < Batch->UsedTiles.Size; i++)
+	{
+		RasterTile* Tile = ((RasterTile**)Batch->UsedTiles.Data)[i];
 
-			if (swglStringEquals(FragIn->Name, swglString2CString(VertOut->Name)))
-			{
-				_VarPair AddPair = { FragIn, VertOut };
-				swglVectorPushBack(&MyProgram->VertexFragInOut, &AddPair);
-				LinkedPair = 1;
-				break;
-			}
+		for (int j = 0; j < Tile->Triangles.Size; j++)
+		{
+			Triangles[((int*)Tile->Triangles.Data)[j]].Covered |= ((uint8_t*)Tile->Covered.Data)[j];
 		}
+
+		swglVectorFree(&Tile->Triangles);
+		swglVectorFree(&Tile->Covered);
+		free(Tile);
 	}
 
-	MyProgram->Linked = 1;
+	for (int i = 0; i < Batch->Triangles.Size; i++)
+	{
+		if (Triangles[i].Path == SWGL_RASTER_SCANLINE) continue;
+
+		if (!Triangles[i].Covered) CurrentContext->TriangleStats.NoCoverage++;
+		else if (Triangles[i].Path == SWGL_RASTER_SMALL) CurrentContext->TriangleStats.Small++;
+		else CurrentContext->TriangleStats.Multisample++;
+	}
+
+	swglVectorFree(&Batch->Triangles);
+	swglVectorFree(&Batch->UsedTiles);
+	free(Batch->Tiles);
+	FreePostTransformBuffer(&Batch->Transformed);
+	free(Batch->DrawProgram.UniformBlock);
+	free(Batch);
 }
 
-void glUseProgram(GLuint program)
+// Queues the batch's tiles, first retiring the oldest batch if SWGL_PIPELINE_DEPTH are in flight
+void SubmitRasterBatch(RasterBatch* Batch)
 {
-	if (program == 0) ActiveProgram = 0;
-	else swglVectorRead(&GlobalPrograms, &ActiveProgram, program - 1);
+	if (CurrentContext->InFlightCount == SWGL_PIPELINE_DEPTH)
+	{
+		RetireRasterBatch(CurrentContext->InFlightBatches[0]);
+
+		CurrentContext->InFlightCount--;
+		memmove(&CurrentContext->InFlightBatches[0], &CurrentContext->InFlightBatches[1], sizeof(RasterBatch*) * CurrentContext->InFlightCount);
+	}
+
+	CurrentContext->InFlightBatches[CurrentContext->InFlightCount++] = Batch;
+
+	for (int i = 0; i < Batch->UsedTiles.Size; i++) QueueRasterTile(((RasterTile**)Batch->UsedTiles.Data)[i]);
 }
 
-typedef struct
+// Waits for every draw in flight, for calls that write what raster jobs read or read what they write
+void FinishRasterBatches()
 {
-	void* data;
-	GLsizei size;
-} Buffer;
+	for (int i = 0; i < CurrentContext->InFlightCount; i++) RetireRasterBatch(CurrentContext->InFlightBatches[i]);
 
-typedef struct
-{
-	GLsizei stride;
-	GLboolean normalized;
-	GLenum type;
-	GLint size;
-	GLuint index;
+	CurrentContext->InFlightCount = 0;
+}
 
-	int offset;
-} VertexArrayAttrib;
+/*
+* LINE RASTERIZATION
+* Lines are clipped to the view volume in clip space, then stepped one pixel along their major axis with
+* Bresenham's algorithm. They are written straight to the framebuffer on the drawing thread, like points
+*/
 
-typedef struct
+// Shades the pixels of one major axis step, a run of Width pixels across the minor axis centred on (x, y).
+// Every pixel of the run shares the step's varyings, so the fragment shader runs at most once per step
+void ShadeLineStep(glslContext* FragmentContext, float** Varyings, int x, int y, uint8_t XMajor, float z, float t)
 {
-	_SwglVector Attribs;
-	Buffer* VertexBuffer;
-	Buffer* ElementBuffer;
-} VertexArray;
+	int ScanMinX, ScanMinY, ScanMaxX, ScanMaxY;
+	GetScanBounds(&ScanMinX, &ScanMinY, &ScanMaxX, &ScanMaxY);
 
-VertexArray* ActiveVertexArray;
-_SwglVector GlobalVertexArrays;
+	int Width = MAX((int)(CurrentContext->LineWidth + 0.5f), 1);
+	int Samples = CurrentContext->Framebuffer->Samples;
+	uint8_t Shaded = 0;
 
-GLuint glGenVertexArrays(GLsizei n, GLuint* arrays)
-{
-	// Only supports one vertex array per call for now
-	*arrays = GlobalVertexArrays.Size + 1;
+	for (int i = -(Width - 1) / 2; i <= Width / 2; i++)
+	{
+		int PixelX = XMajor ? x : x + i;
+		int PixelY = XMajor ? y + i : y;
 
-	VertexArray* VertArray = (VertexArray*)malloc(sizeof(VertexArray));
-	VertArray->Attribs = swglNewVector(sizeof(VertexArrayAttrib));
-	VertArray->ElementBuffer = (Buffer*)malloc(sizeof(Buffer));
-	VertArray->ElementBuffer->data = 0;
-	VertArray->ElementBuffer->size = 0;
-	VertArray->VertexBuffer = (Buffer*)malloc(sizeof(Buffer));
-	VertArray->VertexBuffer->data = 0;
-	VertArray->VertexBuffer->size = 0;
-
-	swglVectorPushBack(&GlobalVertexArrays, &VertArray);
-	return 0;
-}
+		if (PixelX < ScanMinX || PixelX >= ScanMaxX || PixelY < ScanMinY || PixelY >= ScanMaxY) continue;
 
-void glBindVertexArray(GLuint array)
-{
-	if (array == 0) ActiveVertexArray = 0;
-	else swglVectorRead(&GlobalVertexArrays, &ActiveVertexArray, array - 1);
+		// Rows are flipped like the triangle paths, and the pixel's samples all take its centre's depth
+		int Index = (PixelX + (2 * CurrentContext->ViewportY + (int)CurrentContext->ViewportHeight - 1 - PixelY) * CurrentContext->Framebuffer->Width) * Samples;
+		uint8_t WriteSamples = 0;
+
+		for (int j = 0; j < Samples; j++)
+		{
+			float* CurZ = &((float*)CurrentContext->Framebuffer->SampleDepth)[Index + j];
+
+			if (*CurZ == 0.0f || *CurZ >= z)
+			{
+				*CurZ = z;
+				WriteSamples |= 1 << j;
+			}
+		}
+
+		if (!WriteSamples) continue;
+
+		if (!Shaded)
+		{
+			float* Ends[3] = { Varyings[0], Varyings[1], Varyings[0] };
+			InterpolateVaryings(FragmentContext, Ends, 1.0f - t, t, 0.0f);
+
+			ExecuteGLSL(FragmentContext, CurrentContext->ActiveProgram->FragmentShader);
+			Shaded = 1;
+		}
+
+		WriteFragmentColor(FragmentContext, &CurrentContext->Framebuffer->SampleColor[Index], WriteSamples);
+	}
 }
 
-void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+// Draws the line between two clip-space vertices. Its last pixel is left out, so strips and loops draw
+// the pixels of shared vertices once. Depth and varyings are interpolated perspective correct
+void DrawLine(glslContext* FragmentContext, glslVec4* Verts, float** Varyings)
 {
-	if (ActiveVertexArray)
-	{
-		VertexArrayAttrib Attrib;
+	if (CurrentContext->Framebuffer->DepthFormat != GL_FLOAT) return;
 
-		Attrib.index = index;
-		Attrib.normalized = normalized;
-		Attrib.offset = (int)pointer;
-		Attrib.size = size;
-		Attrib.stride = stride;
-		Attrib.type = type;
+	// Liang-Barsky, the part of the line inside every plane is from t0 to t1
+	float t0 = 0.0f, t1 = 1.0f;
+
+	for (uint32_t Plane = SWGL_CLIP_LEFT; Plane <= SWGL_CLIP_FAR; Plane <<= 1)
+	{
+		float d0 = ClipPlaneDistance(Verts[0], Plane);
+		float d1 = ClipPlaneDistance(Verts[1], Plane);
 
-		swglVectorPushBack(&ActiveVertexArray->Attribs, &Attrib);
+		if (d0 < 0.0f && d1 < 0.0f) return;
+		if (d0 < 0.0f) t0 = MAX(t0, d0 / (d0 - d1));
+		else if (d1 < 0.0f) t1 = MIN(t1, d0 / (d0 - d1));
 	}
-}
 
-_SwglVector GlobalBuffers;
+	if (t0 >= t1) return;
 
-GLuint glGenBuffers(GLsizei n, GLuint* buffers)
-{
-	// Only supports 1 buffer per call for now
-	*buffers = GlobalBuffers.Size + 1;
+	glslVec4 Ends[2] = { InterpolateVec4(Verts[0], Verts[1], t0), InterpolateVec4(Verts[0], Verts[1], t1) };
+	int X[2], Y[2];
 
-	Buffer* NewBuffer = (Buffer*)malloc(sizeof(Buffer));
+	for (int j = 0; j < 2; j++)
+	{
+		X[j] = Ends[j].x / Ends[j].w * (CurrentContext->ViewportWidth / 2) + (CurrentContext->ViewportWidth / 2) + CurrentContext->ViewportX;
+		Y[j] = Ends[j].y / Ends[j].w * (CurrentContext->ViewportHeight / 2) + (CurrentContext->ViewportHeight / 2) + CurrentContext->ViewportY;
+	}
 
-	NewBuffer->data = 0;
-	NewBuffer->size = 0;
+	int StepX = X[0] < X[1] ? 1 : -1;
+	int StepY = Y[0] < Y[1] ? 1 : -1;
+	int dx = (X[1] - X[0]) * StepX;
+	int dy = (Y[1] - Y[0]) * StepY;
 
-	swglVectorPushBack(&GlobalBuffers, &NewBuffer);
-	return 0;
-}
+	uint8_t XMajor = dx >= dy;
+	int Major = XMajor ? dx : dy;
+	int Minor = XMajor ? dy : dx;
+	int Error = Major / 2;
 
-Buffer* GlobalArrayBuffer;
+	int x = X[0];
+	int y = Y[0];
 
-void glBindBuffer(GLenum type, GLuint buffer)
-{
-	if (type == GL_ARRAY_BUFFER)
+	for (int i = 0; i < Major; i++)
 	{
-		if (buffer == 0)
-		{
-			GlobalArrayBuffer = 0;
-			return;
-		}
+		// Screen space position along the line, corrected to the clip space one
+		float s = (float)i / Major;
+		float Corrected = s / Ends[1].w / ((1.0f - s) / Ends[0].w + s / Ends[1].w);
 
-		Buffer* TargetBuffer;
+		float z = Ends[0].z + Corrected * (Ends[1].z - Ends[0].z);
+
+		ShadeLineStep(FragmentContext, Varyings, x, y, XMajor, z, t0 + Corrected * (t1 - t0));
+
+		Error -= Minor;
 
-		swglVectorRead(&GlobalBuffers, &TargetBuffer, buffer - 1);
+		if (XMajor) x += StepX;
+		else y += StepY;
 
-		if (ActiveVertexArray)
+		if (Error < 0)
 		{
-			GlobalArrayBuffer = ActiveVertexArray->VertexBuffer;
+			if (XMajor) y += StepY;
+			else x += StepX;
 
-			GlobalArrayBuffer->data = TargetBuffer->data;
-			GlobalArrayBuffer->size = TargetBuffer->size;
-		}
-		else
-		{
-			GlobalArrayBuffer = TargetBuffer;
+			Error += Major;
 		}
 	}
 }
-void glBufferData(GLenum target, GLsizei size, const void* data, GLenum usage)
+
+// Appends the captured vertices of one primitive to the transform feedback buffer. Primitives are written whole,
+// one that no longer fits is dropped, like GL's overflow
+void CaptureFeedbackPrimitive(float** Vertices, int Count, int Floats)
 {
-	Buffer* MyBuffer = 0;
+	Buffer* Target = CurrentContext->TransformFeedbackBuffer;
+	size_t VertexSize = sizeof(float) * Floats;
 
-	if (target == GL_ARRAY_BUFFER)
-	{
-		MyBuffer = GlobalArrayBuffer;
-	}
+	if (!Target || Target->mapped) return;
+	if (CurrentContext->TransformFeedbackOffset + VertexSize * Count > (size_t)Target->size) return;
 
-	if (MyBuffer)
+	for (int i = 0; i < Count; i++)
 	{
-		if (MyBuffer->size == 0)
-		{
-			MyBuffer->data = malloc(size);
-			MyBuffer->size = size;
-			memcpy(MyBuffer->data, data, size);
-		}
+		memcpy((uint8_t*)Target->data + CurrentContext->TransformFeedbackOffset, Vertices[i], VertexSize);
+		CurrentContext->TransformFeedbackOffset += VertexSize;
 	}
+
+	CurrentContext->TransformFeedbackVertices += Count;
 }
 
+// Captures the primitives of a shaded batch in the order they were assembled
+void CaptureFeedbackBatch(VertexCache* Cache, PostTransformBuffer* Transformed, GLenum Mode)
+{
+	int Verts = PrimitiveVertices(Mode);
 
+	for (int i = 0; i < Cache->PrimitiveCount * Verts; i += Verts)
+	{
+		float* Vertices[3];
+		for (int j = 0; j < Verts; j++) Vertices[j] = Transformed->Feedback + Cache->Slots[i + j] * Transformed->FeedbackFloats;
 
-GLint ViewportX;
-GLint ViewportY;
-GLsizei ViewportWidth;
-GLsizei ViewportHeight;
+		CaptureFeedbackPrimitive(Vertices, Verts, Transformed->FeedbackFloats);
+	}
+}
 
-typedef struct
+// Every draw and instance of a glDraw* call shares its setup, and triangle batches run across their boundaries
+void DrawVertices(GLenum Mode, DrawCall* Draws, GLsizei DrawCount)
 {
-	GLsizei Width;
-	GLsizei Height;
+	if (!CurrentContext->ActiveVertexArray) return;
+	if (!CurrentContext->ActiveVertexArray->VertexBuffer || !CurrentContext->ActiveVertexArray->VertexBuffer->data) return;
+	if (!CurrentContext->ActiveProgram) return;
 
-	GLenum ColorFormat;
-	uint32_t* ColorAttachment;
+	// Transform feedback takes the kind of primitive it began with, and a discarding draw without it does nothing
+	if (CurrentContext->TransformFeedbackActive && PrimitiveVertices(Mode) != CurrentContext->TransformFeedbackPrimitiveVerts) return;
+	if (CurrentContext->RasterizerDiscard && !CurrentContext->TransformFeedbackActive) return;
 
-	GLenum DepthFormat;
-	void* DepthAttachment;
-} Framebuffer;
+	int64_t Elements = 0;
 
-Framebuffer* GlobalFramebuffer;
+	for (GLsizei i = 0; i < DrawCount; i++)
+	{
+		// Whole triangles per instance, so batches of a multiple of 3 elements never split one
+		if (Mode == GL_TRIANGLES) Draws[i].Count -= Draws[i].Count % 3;
+		if ((Mode == GL_TRIANGLE_STRIP || Mode == GL_TRIANGLE_FAN) && Draws[i].Count < 3) Draws[i].Count = 0;
+		if (Mode == GL_LINES) Draws[i].Count -= Draws[i].Count % 2;
+		if ((Mode == GL_LINE_STRIP || Mode == GL_LINE_LOOP) && Draws[i].Count < 2) Draws[i].Count = 0;
 
-GLfloat ClearColorRed;
-GLfloat ClearColorGreen;
-GLfloat ClearColorBlue;
-GLfloat ClearColorAlpha;
+		Elements += (int64_t)Draws[i].Count * Draws[i].InstanceCount;
+	}
 
-void glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
-{
-	ClearColorRed = MIN(MAX(red, 0.0f), 1.0f);
-	ClearColorGreen = MIN(MAX(green, 0.0f), 1.0f);
-	ClearColorBlue = MIN(MAX(blue, 0.0f), 1.0f);
-	ClearColorAlpha = MIN(MAX(alpha, 0.0f), 1.0f);
-}
+	if (Elements <= 0) return;
 
-void glClear(GLuint flags)
-{
-	if (flags & GL_COLOR_BUFFER_BIT)
+	glslContext VertexContext = NewGLSLContext(&CurrentContext->ActiveProgram->VertexShader, VertexUniforms(CurrentContext->ActiveProgram));
+	FetchPlan* Plan = GetFetchPlan(CurrentContext->ActiveVertexArray, CurrentContext->ActiveProgram);
+
+	if (CurrentContext->RasterizerDiscard)
 	{
-		uint32_t ClearColor = 0;
-		ClearColor |= (uint32_t)(ClearColorRed * 255) << 24;
-		ClearColor |= (uint32_t)(ClearColorGreen * 255) << 16;
-		ClearColor |= (uint32_t)(ClearColorBlue * 255) << 8;
-		ClearColor |= (uint32_t)(ClearColorAlpha * 255);
+		// Primitives are only assembled to be captured, nothing is rasterized
+		if (!CurrentContext->VertexCache) CurrentContext->VertexCache = (VertexCache*)calloc(1, sizeof(VertexCache));
+		VertexCache* Cache = CurrentContext->VertexCache;
+		DrawCursor Cursor = { 0, 0 };
+
+		PostTransformBuffer Transformed = NewPostTransformBuffer(SWGL_VERTEX_BATCH);
 
-		for (int y = MAX(ViewportY, 0); y < MIN(ViewportY + ViewportHeight, GlobalFramebuffer->Height); y++)
+		Cache->HeldCount = 0;
+
+		while (Elements > 0)
 		{
-			for (int x = MAX(ViewportX, 0); x < MIN(ViewportX + ViewportWidth, GlobalFramebuffer->Width); x++)
-			{
-				GlobalFramebuffer->ColorAttachment[y * GlobalFramebuffer->Width + x] = ClearColor;
-			}
+			Elements -= CacheBatchVertices(Cache, Mode, Draws, &Cursor, Elements);
+
+			if (!Cache->PrimitiveCount) continue;
+
+			ShadeVertexBatch(&VertexContext, Plan, Cache->Vertices, Cache->Instances, 0, Cache->VertexCount, &Transformed);
+			CaptureFeedbackBatch(Cache, &Transformed, Mode);
 		}
+
+		FreePostTransformBuffer(&Transformed);
 	}
-	if (flags & GL_DEPTH_BUFFER_BIT)
+	else if (Mode == GL_POINTS)
 	{
-		if (GlobalFramebuffer->DepthFormat == GL_FLOAT)
+		// Points are written straight to the framebuffer
+		FinishRasterBatches();
+
+		glslContext FragmentContext = NewGLSLContext(&CurrentContext->ActiveProgram->FragmentShader, FragmentUniforms(CurrentContext->ActiveProgram));
+		float* Position = (float*)GLSLVarData(&VertexContext, CurrentContext->ActiveProgram->PositionVar);
+
+		float* Staged = (float*)malloc(sizeof(float) * MAX(Plan->StagedFloats, 1));
+		float* Captured = CurrentContext->TransformFeedbackActive ? (float*)malloc(sizeof(float) * CurrentContext->ActiveProgram->FeedbackFloats) : 0;
+		DrawCursor Cursor = { 0, 0 };
+
+		CurrentContext->VertexStats.Shaded += Elements;
+
+		for (int64_t i = 0; i < Elements; i++)
 		{
-			for (int y = MAX(ViewportY, 0); y < MIN(ViewportY + ViewportHeight, GlobalFramebuffer->Height); y++)
+			uint32_t Element, Instance;
+			DrawCall* Draw = NextDrawElement(Draws, &Cursor, &Element, &Instance);
+			uint32_t Vertex = Draw->Indices ? ReadElementIndex(Draw->Indices, Draw->IndexType, Element) : Element;
+
+			FetchVertexBatch(Plan, &Vertex, &Instance, 1, Staged);
+			LoadStagedVertex(&VertexContext, Plan, Staged, Instance);
+
+			ExecuteGLSL(&VertexContext, CurrentContext->ActiveProgram->VertexShader);
+
+			if (Captured)
+			{
+				ReadFeedbackVertex(&VertexContext, Captured);
+				CaptureFeedbackPrimitive(&Captured, 1, CurrentContext->ActiveProgram->FeedbackFloats);
+			}
+
+			int OutPosX = Position[0] / Position[3] * (CurrentContext->ViewportHeight / 2) + (CurrentContext->ViewportWidth / 2) + CurrentContext->ViewportX;
+			int OutPosY = Position[1] / Position[3] * (CurrentContext->ViewportHeight / 2) + (CurrentContext->ViewportHeight / 2) + CurrentContext->ViewportY;
+
+			if (OutPosX < 0 || OutPosX >= CurrentContext->Framebuffer->Width) continue;
+			if (OutPosY < 0 || OutPosY >= CurrentContext->Framebuffer->Height) continue;
+
+			for (int j = 0; j < CurrentContext->ActiveProgram->VertexFragInOut.Size; j++)
 			{
-				for (int x = MAX(ViewportX, 0); x < MIN(ViewportX + ViewportWidth, GlobalFramebuffer->Width); x++)
+				_VarPair InOut;
+
+				swglVectorRead(&CurrentContext->ActiveProgram->VertexFragInOut, &InOut, j);
+
+				if (InOut.first->Type != InOut.second->Type)
 				{
-					((GLfloat*)GlobalFramebuffer->DepthAttachment)[y * GlobalFramebuffer->Width + x] = 0.0f;
+					continue;
 				}
+
+				memcpy(GLSLVarData(&FragmentContext, InOut.first), GLSLVarData(&VertexContext, InOut.second), GLSLTypeSize(InOut.first->Type));
 			}
-		}
-	}
-}
 
-void glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
-{
-	ViewportX = x;
-	ViewportY = y;
-	ViewportWidth = width;
-	ViewportHeight = height;
-}
+			ExecuteGLSL(&FragmentContext, CurrentContext->ActiveProgram->FragmentShader);
 
-glslVec4 Sub(glslVec4 x, glslVec4 y)
-{
-	x.x -= y.x;
-	x.y -= y.y;
-	x.z -= y.z;
-	x.w -= y.w;
-	return x;
-}
+			if (!CurrentContext->ActiveProgram->FragmentOut) continue;
 
-float Dot2(glslVec4 x, glslVec4 y)
-{
-	return x.x * y.x + x.y * y.y;
-}
+			float* FragOut = (float*)GLSLVarData(&FragmentContext, CurrentContext->ActiveProgram->FragmentOut);
+			float OutR = FragOut[0];
+			float OutG = FragOut[1];
+			float OutB = FragOut[2];
+			float OutA = FragOut[3];
 
-float rsqrt(float number)
-{
-	long i;
-	float x2, y;
-	const float threehalfs = 1.5F;
+			OutR = MIN(MAX(OutR, 0.0f), 1.0f);
+			OutG = MIN(MAX(OutG, 0.0f), 1.0f);
+			OutB = MIN(MAX(OutB, 0.0f), 1.0f);
+			OutA = MIN(MAX(OutA, 0.0f), 1.0f);
 
-	x2 = number * 0.5F;
-	y = number;
-	i = *(long*)&y;       
-	i = 0x5f3759df - (i >> 1);
-	y = *(float*)&i;
-	y = y * (threehalfs - (x2 * y * y));
-	y = y * (threehalfs - (x2 * y * y));
-	y = y * (threehalfs - (x2 * y * y));
+			// Points cover every sample of their pixel
+			int Samples = CurrentContext->Framebuffer->Samples;
+			int SampleIndex = (OutPosX + OutPosY * CurrentContext->Framebuffer->Width) * Samples;
 
-	return y;
-}
+			if (CurrentContext->Framebuffer->DepthAttachment)
+			{
+				if (CurrentContext->Framebuffer->DepthFormat == GL_FLOAT)
+				{
+					float OutPosZ = Position[2];
+					for (int j = 0; j < Samples; j++) ((float*)CurrentContext->Framebuffer->SampleDepth)[SampleIndex + j] = OutPosZ;
+				}
+			}
 
-void Barycentric(glslVec4 a, glslVec4 b, glslVec4 c, glslVec4 p, float* u, float* v, float* w)
-{
-	glslVec4 v0 = Sub(b, a), v1 = Sub(c, a), v2 = Sub(p, a);
-	float d00 = Dot2(v0, v0);
-	float d01 = Dot2(v0, v1);
-	float d11 = Dot2(v1, v1);
-	float d20 = Dot2(v2, v0);
-	float d21 = Dot2(v2, v1);
-	float denom = d00 * d11 - d01 * d01;
-	*v = (d11 * d20 - d01 * d21) / denom;
-	*w = (d00 * d21 - d01 * d20) / denom;
-	*u = 1.0f - *v - *w;
-}
+			if (CurrentContext->Framebuffer->ColorAttachment)
+			{
+				if (CurrentContext->Framebuffer->ColorFormat == GL_RGB)
+				{
+					uint32_t Color = 0xFF;
+					Color |= (int)(OutR * 255) << 24;
+					Color |= (int)(OutG * 255) << 16;
+					Color |= (int)(OutB * 255) << 8;
+					for (int j = 0; j < Samples; j++) CurrentContext->Framebuffer->SampleColor[SampleIndex + j] = Color;
+				}
+				else if (CurrentContext->Framebuffer->ColorFormat == GL_RGBA)
+				{
+					uint32_t Color = 0;
+					Color |= (int)(OutR * 255) << 24;
+					Color |= (int)(OutG * 255) << 16;
+					Color |= (int)(OutB * 255) << 8;
+					Color |= (int)(OutA * 255);
+					for (int j = 0; j < Samples; j++) CurrentContext->Framebuffer->SampleColor[SampleIndex + j] = Color;
+				}
+			}
+		}
 
-glslExValue InterpolateLinearEx(glslExValue a, glslExValue b, glslExValue c, float aW, float bW, float cW)
-{
-	glslExValue Out;
-	Out.Type = a.Type;
-	if (a.Type == GLSL_FLOAT)
-	{
-		Out.x = a.x * aW + b.x * bW + c.x * cW;
-	}
-	else if (a.Type == GLSL_VEC2)
-	{
-		Out.x = a.x * aW + b.x * bW + c.x * cW;
-		Out.y = a.y * aW + b.y * bW + c.y * cW;
-	}
-	else if (a.Type == GLSL_VEC3)
-	{
-		Out.x = a.x * aW + b.x * bW + c.x * cW;
-		Out.y = a.y * aW + b.y * bW + c.y * cW;
-		Out.z = a.z * aW + b.z * bW + c.z * cW;
+		FreeGLSLContext(&FragmentContext);
+		free(Staged);
+		free(Captured);
 	}
-	else if (a.Type == GLSL_VEC4)
+	else if (Mode == GL_TRIANGLES || Mode == GL_TRIANGLE_STRIP || Mode == GL_TRIANGLE_FAN)
 	{
-		Out.x = a.x * aW + b.x * bW + c.x * cW;
-		Out.y = a.y * aW + b.y * bW + c.y * cW;
-		Out.z = a.z * aW + b.z * bW + c.z * cW;
-		Out.w = a.w * aW + b.w * bW + c.w * cW;
-	}
-	return Out;
-}
+		if (!CurrentContext->VertexCache) CurrentContext->VertexCache = (VertexCache*)calloc(1, sizeof(VertexCache));
+		VertexCache* Cache = CurrentContext->VertexCache;
+		DrawCursor Cursor = { 0, 0 };
 
-float DistBetweenPointAndLine(float x1, float y1, float x2, float y2, float x3, float y3) {
-	
-	float m, c;
+		Cache->HeldCount = 0;
 
-	m = (y2 - y1) / MAX(x2 - x1, 1.0f);
-	c = y1 - m * x1;
+		while (Elements > 0)
+		{
+			Elements -= CacheBatchVertices(Cache, Mode, Draws, &Cursor, Elements);
 
-	float distance;
-	distance = (m * x3 - y3 + c);
-	if (distance < 0.0f) distance *= -1.0f;
-	distance *= rsqrt(m * m + 1);
+			if (!Cache->PrimitiveCount) continue;
 
-	return distance;
-}
+			// Earlier batches may still be rasterizing, each batch shades into its own buffer
+			RasterBatch* Batch = NewRasterBatch(Cache->VertexCount);
+			PostTransformBuffer* Transformed = &Batch->Transformed;
 
-void DrawTriangle(glslVec4* Coords, _SwglVector* CoordData)
-{
-	MipMapLevel = 40.0f / DistBetweenPointAndLine(Coords[0].x, Coords[0].y, Coords[1].x, Coords[1].y, Coords[2].x, Coords[2].y);
+			ShadeVertexBatch(&VertexContext, Plan, Cache->Vertices, Cache->Instances, 0, Cache->VertexCount, Transformed);
+			if (Transformed->Feedback) CaptureFeedbackBatch(Cache, Transformed, Mode);
 
-	glslVec4 OldCoords[3];
-	OldCoords[0] = Coords[0];
-	OldCoords[1] = Coords[1];
-	OldCoords[2] = Coords[2];
+			for (int i = 0; i < Cache->PrimitiveCount * 3; i += 3)
+			{
+				int Slots[3];
+				glslVec4 TriangleCoords[3];
 
-	if (Coords[0].y > Coords[2].y)
-	{
-		glslVec4 Temp = Coords[0];
-		Coords[0] = Coords[2];
-		Coords[2] = Temp;
-	}
+				for (int j = 0; j < 3; j++)
+				{
+					Slots[j] = Cache->Slots[i + j];
+					TriangleCoords[j] = Transformed->Positions[Slots[j]];
+				}
 
-	if (Coords[0].y > Coords[1].y)
-	{
-		glslVec4 Temp = Coords[0];
-		Coords[0] = Coords[1];
-		Coords[1] = Temp;
-	}
+				uint32_t ClipCode0 = ComputeClipCode(TriangleCoords[0]);
+				uint32_t ClipCode1 = ComputeClipCode(TriangleCoords[1]);
+				uint32_t ClipCode2 = ComputeClipCode(TriangleCoords[2]);
 
-	if (Coords[1].y > Coords[2].y)
-	{
-		glslVec4 Temp = Coords[1];
-		Coords[1] = Coords[2];
-		Coords[2] = Temp;
-	}
+				CurrentContext->TriangleStats.Submitted++;
 
-	if (Coords[0].y >= ViewportY + ViewportHeight) return;
+				// Entirely outside one frustum plane
+				if (ClipCode0 & ClipCode1 & ClipCode2 & SWGL_CLIP_FRUSTUM)
+				{
+					CurrentContext->TriangleStats.Rejected++;
+					continue;
+				}
 
-	float s0 = (Coords[2].x - Coords[0].x) / MAX(Coords[2].y - Coords[0].y, 1.0f);
-	float s1 = (Coords[1].x - Coords[0].x) / MAX(Coords[1].y - Coords[0].y, 1.0f);
-	float s2 = (Coords[2].x - Coords[1].x) / MAX(Coords[2].y - Coords[1].y, 1.0f);
+				float FacingDet = TriangleFacingDet(TriangleCoords);
 
-	float y = MAX(Coords[0].y, ViewportY);
-	float x0 = Coords[0].x;
-	float x1 = x0;
+				if (FacingDet == 0.0f)
+				{
+					CurrentContext->TriangleStats.Degenerate++;
+					continue;
+				}
 
-	uint8_t Switched = 0;
+				if (IsTriangleCulled(FacingDet))
+				{
+					CurrentContext->TriangleStats.Culled++;
+					continue;
+				}
+
+				uint32_t ClipPlanes = (ClipCode0 | ClipCode1 | ClipCode2) & SWGL_CLIP_GEOMETRIC;
+
+				if (!ClipPlanes)
+				{
+					// Within the guard band, the tiles clip to the viewport while scanning
+					ScreenTriangle Tri;
+					for (int j = 0; j < 3; j++) Tri.Slots[j] = Slots[j];
+
+					SetupScreenTriangle(Batch, TriangleCoords, &Tri);
+					continue;
+				}
+
+				CurrentContext->TriangleStats.Clipped++;
+
+				// Clip vertices are appended to the batch's own buffer, the polygon is a list of slots
+				int Poly[SWGL_MAX_CLIP_VERTS];
+				int VertCount = ClipTriangle(Transformed, Slots, ClipPlanes, Poly);
 
-	for (; y < MIN(Coords[2].y, ViewportY + ViewportHeight); y++,x0 += s0,x1 += s1)
+				for (int k = 1; k + 1 < VertCount; k++)
+				{
+					ScreenTriangle Tri;
+					Tri.Slots[0] = Poly[0];
+					Tri.Slots[1] = Poly[k];
+					Tri.Slots[2] = Poly[k + 1];
+
+					glslVec4 FanCoords[3];
+					for (int j = 0; j < 3; j++) FanCoords[j] = Transformed->Positions[Tri.Slots[j]];
+
+					SetupScreenTriangle(Batch, FanCoords, &Tri);
+				}
+			}
+
+			SubmitRasterBatch(Batch);
+		}
+	}
+	else if (Mode == GL_LINES || Mode == GL_LINE_STRIP || Mode == GL_LINE_LOOP)
 	{
-		for (int x = MAX(MIN(x0, x1), ViewportX);x < MIN(MAX(x0, x1), ViewportX + ViewportWidth);x++)
-		{
-			if (x < 0) continue;
-			if (x >= GlobalFramebuffer->Width) break;
-			glslVec4 MyPoint = { x, y, 0.0f, 0.0f };
+		// Lines are written straight to the framebuffer
+		FinishRasterBatches();
 
-			float u, v, w;
-			Barycentric(OldCoords[0], OldCoords[1], OldCoords[2], MyPoint, &u, &v, &w);
+		glslContext FragmentContext = NewGLSLContext(&CurrentContext->ActiveProgram->FragmentShader, FragmentUniforms(CurrentContext->ActiveProgram));
 
-			float uCorrected = u / OldCoords[0].w;
-			float vCorrected = v / OldCoords[1].w;
-			float wCorrected = w / OldCoords[2].w;
+		if (!CurrentContext->VertexCache) CurrentContext->VertexCache = (VertexCache*)calloc(1, sizeof(VertexCache));
+		VertexCache* Cache = CurrentContext->VertexCache;
+		DrawCursor Cursor = { 0, 0 };
 
-			float sum = uCorrected + vCorrected + wCorrected;
+		// Lines are drawn before the next batch is shaded, so one buffer serves every batch
+		PostTransformBuffer Transformed = NewPostTransformBuffer(SWGL_VERTEX_BATCH);
 
+		Cache->HeldCount = 0;
 
-			uCorrected /= sum;
-			vCorrected /= sum;
-			wCorrected /= sum;
+		while (Elements > 0)
+		{
+			Elements -= CacheBatchVertices(Cache, Mode, Draws, &Cursor, Elements);
 
-			u = uCorrected;
-			v = vCorrected;
-			w = wCorrected;
+			if (!Cache->PrimitiveCount) continue;
 
-			float z = (OldCoords[0].z * u + OldCoords[1].z * v + OldCoords[2].z * w);
+			ShadeVertexBatch(&VertexContext, Plan, Cache->Vertices, Cache->Instances, 0, Cache->VertexCount, &Transformed);
+			if (Transformed.Feedback) CaptureFeedbackBatch(Cache, &Transformed, Mode);
 
-			if (GlobalFramebuffer->DepthFormat == GL_FLOAT)
+			for (int i = 0; i < Cache->PrimitiveCount * 2; i += 2)
 			{
-				float* CurZ = &(((float*)GlobalFramebuffer->DepthAttachment)[(int)x + MIN(GlobalFramebuffer->Height - 1, MAX(0, ((ViewportHeight - ((int)y - ViewportY + 1)) + ViewportY))) * GlobalFramebuffer->Width]);
-				if (*CurZ == 0.0f || *CurZ >= z)
+				glslVec4 LineCoords[2];
+				float* LineVaryings[2];
+
+				for (int j = 0; j < 2; j++)
 				{
-					*CurZ = z;
+					LineCoords[j] = Transformed.Positions[Cache->Slots[i + j]];
+					LineVaryings[j] = Transformed.Varyings + Cache->Slots[i + j] * Transformed.VaryingFloats;
+				}
 
-					uint32_t* CurCol = &(GlobalFramebuffer->ColorAttachment[(int)x + MIN(GlobalFramebuffer->Height - 1, MAX(0, ((ViewportHeight - ((int)y - ViewportY + 1)) + ViewportY))) * GlobalFramebuffer->Width]);
+				DrawLine(&FragmentContext, LineCoords, LineVaryings);
+			}
+		}
 
+		FreePostTransformBuffer(&Transformed);
+		FreeGLSLContext(&FragmentContext);
+	}
 
-					for (int i = 0; i < CoordData[0].Size; i++)
-					{
-						_ExVarPair FirstArg, SecondArg, ThirdArg;
+	FreeGLSLContext(&VertexContext);
+}
 
-						swglVectorRead(&CoordData[0], &FirstArg, i);
-						swglVectorRead(&CoordData[1], &SecondArg, i);
-						swglVectorRead(&CoordData[2], &ThirdArg, i);
+// Points an indexed draw at its indices, Offset bytes into the vertex array's element buffer.
+// Fails if the index type is not one of GL_UNSIGNED_BYTE, SHORT or INT, or the indices run past the buffer
+uint8_t ResolveElementDraw(DrawCall* Draw, const void* Offset)
+{
+	if (!CurrentContext->ActiveVertexArray) return 0;
 
-						glslExValue InterpVal = InterpolateLinearEx(FirstArg.first, SecondArg.first, ThirdArg.first, u, v, w);
+	Buffer* ElementBuffer = CurrentContext->ActiveVertexArray->ElementBuffer;
 
+	if (!ElementBuffer || !ElementBuffer->data) return 0;
 
-						AssignToExVal(FirstArg.second, InterpVal);
-					}
+	size_t IndexSize = 0;
+	if (Draw->IndexType == GL_UNSIGNED_BYTE) IndexSize = 1;
+	else if (Draw->IndexType == GL_UNSIGNED_SHORT) IndexSize = 2;
+	else if (Draw->IndexType == GL_UNSIGNED_INT) IndexSize = 4;
 
-					ExecuteGLSL(ActiveProgram->FragmentShader);
+	if (!IndexSize) return 0;
+	if ((size_t)Offset + Draw->Count * IndexSize > (size_t)ElementBuffer->size) return 0;
 
-					float OutR, OutG, OutB, OutA;
+	Draw->Indices = (uint8_t*)ElementBuffer->data + (size_t)Offset;
+	return 1;
+}
 
-					for (int _i = 0; _i < ActiveProgram->FragmentShader.GlobalVars.Size; _i++)
-					{
-						glslVariable* Var;
-
-						swglVectorRead(&ActiveProgram->FragmentShader.GlobalVars, &Var, _i);
-
-						if (Var->isOut)
-						{
-							OutR = ((float*)Var->Value.Data)[0];
-							OutG = ((float*)Var->Value.Data)[1];
-							OutB = ((float*)Var->Value.Data)[2];
-							OutA = ((float*)Var->Value.Data)[3];
-							break;
-						}
-					}
+void glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	glDrawArraysInstanced(mode, first, count, 1);
+}
+
+void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_DRAW_ARRAYS);
+		Command->Enums[0] = mode;
+		Command->Ints[0] = first;
+		Command->Ints[1] = count;
+		Command->Ints[2] = instancecount;
+		return;
+	}
 
-					OutR = MIN(MAX(OutR, 0.0f), 1.0f);
-					OutG = MIN(MAX(OutG, 0.0f), 1.0f);
-					OutB = MIN(MAX(OutB, 0.0f), 1.0f);
-					OutA = MIN(MAX(OutA, 0.0f), 1.0f);
-					//OutA *= MIN((MIN(MIN(MIN(u, 1.0f - u), MIN(v, 1.0f - v)), MIN(w, 1.0f - w))) * 50.0f, 1.0f); // UNCOMMENT FOR AA
+	DrawCall Draw = { first, count, instancecount, 0, 0 };
+	DrawVertices(mode, &Draw, 1);
+}
 
-					float CurR = ((*CurCol >> 24) & 0xFF) / 255.0f;
-					float CurG = ((*CurCol >> 16) & 0xFF) / 255.0f;
-					float CurB = ((*CurCol >> 8) & 0xFF) / 255.0f;
-					float CurA = (*CurCol & 0xFF) / 255.0f;
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	glDrawElementsInstanced(mode, count, type, indices, 1);
+}
 
-					OutR = CurR + OutA * (OutR - CurR);
-					OutG = CurG + OutA * (OutG - CurG);
-					OutB = CurB + OutA * (OutB - CurB);
-					OutA = CurA + OutA * (OutA - CurA);
+void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_DRAW_ELEMENTS);
+		Command->Enums[0] = mode;
+		Command->Enums[1] = type;
+		Command->Ints[0] = count;
+		Command->Ints[1] = instancecount;
+		Command->Pointer = (void*)indices; // An offset into the bound element buffer
+		return;
+	}
 
-					uint32_t Color;
+	DrawCall Draw = { 0, count, instancecount, 0, type };
+	if (!ResolveElementDraw(&Draw, indices)) return;
 
-					if (GlobalFramebuffer->ColorFormat == GL_RGB)
-					{
-						Color = 0xFF;
-						Color |= (int)(OutR * 255) << 24;
-						Color |= (int)(OutG * 255) << 16;
-						Color |= (int)(OutB * 255) << 8;
-					}
-					else if (GlobalFramebuffer->ColorFormat == GL_RGBA)
-					{
-						Color = 0x0;
-						Color |= (int)(OutR * 255) << 24;
-						Color |= (int)(OutG * 255) << 16;
-						Color |= (int)(OutB * 255) << 8;
-						Color |= (int)(OutA * 255);
-					}
+	DrawVertices(mode, &Draw, 1);
+}
 
-					*CurCol = Color;
-				}
-			}
-		}
-		if (y + 1 >= Coords[1].y && !Switched)
+// The post-transform cache finds the vertices each batch uses, so the range is not needed
+void glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices)
+{
+	if (end < start) return;
+
+	glDrawElements(mode, count, type, indices);
+}
+
+void glMultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawcount)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_MULTI_DRAW_ARRAYS);
+		Command->Enums[0] = mode;
+		Command->Ints[0] = drawcount;
+
+		// The firsts followed by the counts
+		Command->Data = malloc(sizeof(GLint) * 2 * MAX(drawcount, 1));
+		memcpy(Command->Data, first, sizeof(GLint) * drawcount);
+		memcpy((GLint*)Command->Data + drawcount, count, sizeof(GLsizei) * drawcount);
+		return;
+	}
+
+	if (!drawcount) return;
+
+	DrawCall* Draws = (DrawCall*)malloc(sizeof(DrawCall) * drawcount);
+
+	for (GLsizei i = 0; i < drawcount; i++)
+	{
+		DrawCall Draw = { first[i], count[i], 1, 0, 0 };
+		Draws[i] = Draw;
+	}
+
+	DrawVertices(mode, Draws, drawcount);
+	free(Draws);
+}
+
+void glMultiDrawElements(GLenum mode, const GLsizei* count, GLenum type, const void* const* indices, GLsizei drawcount)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_MULTI_DRAW_ELEMENTS);
+		Command->Enums[0] = mode;
+		Command->Enums[1] = type;
+		Command->Ints[0] = drawcount;
+
+		// The index offsets followed by the counts
+		Command->Data = malloc((sizeof(void*) + sizeof(GLsizei)) * MAX(drawcount, 1));
+		memcpy(Command->Data, indices, sizeof(void*) * drawcount);
+		memcpy((void**)Command->Data + drawcount, count, sizeof(GLsizei) * drawcount);
+		return;
+	}
+
+	if (!drawcount) return;
+
+	DrawCall* Draws = (DrawCall*)malloc(sizeof(DrawCall) * drawcount);
+
+	for (GLsizei i = 0; i < drawcount; i++)
+	{
+		DrawCall Draw = { 0, count[i], 1, 0, type };
+		Draws[i] = Draw;
+
+		if (!ResolveElementDraw(&Draws[i], indices[i]))
 		{
-			Switched = 1;
-			s1 = s2;
-			x1 = Coords[1].x;
+			free(Draws);
+			return;
 		}
 	}
+
+	DrawVertices(mode, Draws, drawcount);
+	free(Draws);
+}
+
+void glDrawArraysIndirect(GLenum mode, const void* indirect)
+{
+	glMultiDrawArraysIndirect(mode, indirect, 1, 0);
 }
 
-void glDrawArrays(GLenum mode, GLint first, GLsizei count)
+void glMultiDrawArraysIndirect(GLenum mode, const void* indirect, GLsizei drawcount, GLsizei stride)
 {
-	if (!ActiveVertexArray) return;
-	if (!ActiveProgram) return;
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_MULTI_DRAW_ARRAYS_INDIRECT);
+		Command->Enums[0] = mode;
+		Command->Ints[0] = drawcount;
+		Command->Ints[1] = stride;
+		Command->Pointer = (void*)indirect; // An offset into the bound draw indirect buffer
+		return;
+	}
+
+	Buffer* IndirectBuffer = CurrentContext->DrawIndirectBuffer;
+
+	if (!IndirectBuffer || !IndirectBuffer->data || !drawcount) return;
 
-	glslVariable* glPositionVar = 0;
+	if (!stride) stride = sizeof(DrawArraysIndirectCommand);
+	if ((size_t)indirect + (size_t)(drawcount - 1) * stride + sizeof(DrawArraysIndirectCommand) > (size_t)IndirectBuffer->size) return;
 
-	for (int i = 0; i < ActiveProgram->VertexShader.GlobalVars.Size; i++)
+	DrawCall* Draws = (DrawCall*)malloc(sizeof(DrawCall) * drawcount);
+	const uint8_t* Record = (const uint8_t*)IndirectBuffer->data + (size_t)indirect;
+
+	for (GLsizei i = 0; i < drawcount; i++, Record += stride)
 	{
-		glslVariable* Var;
+		DrawArraysIndirectCommand Indirect;
+		memcpy(&Indirect, Record, sizeof(Indirect));
 
-		swglVectorRead(&ActiveProgram->VertexShader.GlobalVars, &Var, i);
+		DrawCall Draw = { Indirect.first, Indirect.count, Indirect.instanceCount, 0, 0 };
+		Draws[i] = Draw;
+	}
 
-		if (swglStringEquals(Var->Name, "gl_Position"))
-		{
-			glPositionVar = Var;
-		}
+	DrawVertices(mode, Draws, drawcount);
+	free(Draws);
+}
+
+void glBeginTransformFeedback(GLenum primitiveMode)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_BEGIN_TRANSFORM_FEEDBACK);
+		Command->Enums[0] = primitiveMode;
+		return;
 	}
 
-	VerifyVar(glPositionVar);
+	if (CurrentContext->TransformFeedbackActive) return;
+	if (primitiveMode != GL_POINTS && primitiveMode != GL_LINES && primitiveMode != GL_TRIANGLES) return;
+	if (!CurrentContext->ActiveProgram || !CurrentContext->ActiveProgram->FeedbackFloats) return;
+	if (!CurrentContext->TransformFeedbackBuffer) return;
+
+	CurrentContext->TransformFeedbackActive = 1;
+	CurrentContext->TransformFeedbackPrimitiveVerts = PrimitiveVertices(primitiveMode);
+	CurrentContext->TransformFeedbackOffset = 0;
+	CurrentContext->TransformFeedbackVertices = 0;
+}
 
-	if (mode == GL_POINTS)
+void glEndTransformFeedback()
+{
+	if (IsRecording())
 	{
-		for (int i = first; i < first + count; i++)
-		{
-			for (int j = 0; j < ActiveVertexArray->Attribs.Size; j++)
-			{
-				VertexArrayAttrib Attrib;
+		RecordCommand(SWGL_CMD_END_TRANSFORM_FEEDBACK);
+		return;
+	}
 
-				swglVectorRead(&ActiveVertexArray->Attribs, &Attrib, j);
+	CurrentContext->TransformFeedbackActive = 0;
+}
 
-				if (Attrib.type == GL_FLOAT)
-				{
-					float* AttribData = (float*)((uint8_t*)ActiveVertexArray->VertexBuffer->data + i * Attrib.stride + Attrib.offset);
+GLsizei swglGetTransformFeedbackVertices()
+{
+	FinishRecordedCommands();
 
-					for (int k = 0; k < ActiveProgram->Layouts.Size; k++)
-					{
-						glslVariable* Var;
-
-						swglVectorRead(&ActiveProgram->Layouts, &Var, k);
-
-						if (Var->Layout->Location == Attrib.index)
-						{
-							if (Var->Value.Alloc != 1)
-							{
-								Var->Value.Alloc = 1;
-								Var->Value.Data = malloc(Attrib.size * sizeof(float));
-							}
-							memcpy(Var->Value.Data, AttribData, Attrib.size * sizeof(float));
-						}
-					}
-				}
-			}
+	return CurrentContext->TransformFeedbackVertices;
+}
 
-			ExecuteGLSL(ActiveProgram->VertexShader);
+Framebuffer* NewFramebuffer(GLsizei Width, GLsizei Height)
+{
+	Framebuffer* Target = (Framebuffer*)malloc(sizeof(Framebuffer));
+	Target->Width = Width;
+	Target->Height = Height;
 
-			int OutPosX = ((float*)glPositionVar->Value.Data)[0] / ((float*)glPositionVar->Value.Data)[3] * (ViewportHeight / 2) + (ViewportWidth / 2) + ViewportX;
-			int OutPosY = ((float*)glPositionVar->Value.Data)[1] / ((float*)glPositionVar->Value.Data)[3] * (ViewportHeight / 2) + (ViewportHeight / 2) + ViewportY;
+	Target->DepthFormat = GL_FLOAT;
+	Target->DepthAttachment = malloc(sizeof(float) * Width * Height);
 
-			if (OutPosX < 0 || OutPosX >= GlobalFramebuffer->Width) continue;
-			if (OutPosY < 0 || OutPosY >= GlobalFramebuffer->Height) continue;
+	Target->ColorFormat = GL_RGBA;
+	Target->ColorAttachment = (uint32_t*)malloc(4 * Width * Height);
 
-			for (int j = 0; j < ActiveProgram->VertexFragInOut.Size; j++)
-			{
-				_VarPair InOut;
+	Target->Samples = 1;
+	Target->SampleColor = Target->ColorAttachment;
+	Target->SampleDepth = Target->DepthAttachment;
 
-				swglVectorRead(&ActiveProgram->VertexFragInOut, &InOut, j);
+	return Target;
+}
 
-				if (InOut.first->Type != InOut.second->Type)
-				{
-					continue;
-				}
+void FreeFramebuffer(Framebuffer* Target)
+{
+	if (Target->Samples > 1)
+	{
+		free(Target->SampleColor);
+		free(Target->SampleDepth);
+	}
+	free(Target->ColorAttachment);
+	free(Target->DepthAttachment);
+	free(Target);
+}
 
-				if (InOut.first->Type == GLSL_FLOAT) memcpy(InOut.first->Value.Data, InOut.second->Value.Data, sizeof(float));
-				if (InOut.first->Type == GLSL_VEC2) memcpy(InOut.first->Value.Data, InOut.second->Value.Data, sizeof(float) * 2);
-				if (InOut.first->Type == GLSL_VEC3) memcpy(InOut.first->Value.Data, InOut.second->Value.Data, sizeof(float) * 3);
-				if (InOut.first->Type == GLSL_VEC4) memcpy(InOut.first->Value.Data, InOut.second->Value.Data, sizeof(float) * 4);
-				if (InOut.first->Type == GLSL_INT) memcpy(InOut.first->Value.Data, InOut.second->Value.Data, sizeof(int));
-			}
+swglContext* swglCreateContext(GLsizei width, GLsizei height)
+{
+	swglContext* Context = (swglContext*)malloc(sizeof(swglContext));
+	memset(Context, 0, sizeof(swglContext));
+
+	Context->SwapChain[0] = NewFramebuffer(width, height);
+	Context->SwapBufferCount = 1;
+	Context->BackBuffer = 0;
+	Context->Framebuffer = Context->SwapChain[0];
+	Context->MultisampleEnabled = 1;
+
+	Context->Buffers = swglNewVector(sizeof(Buffer*));
+	Context->BufferPool.Slabs = swglNewVector(sizeof(void*));
+	Context->FreeBufferNames = swglNewVector(sizeof(GLuint));
+	Context->Programs = swglNewVector(sizeof(Program*));
+	Context->VertexArrays = swglNewVector(sizeof(VertexArray*));
+	Context->Shaders = swglNewVector(sizeof(RawShader*));
+	Context->Textures = swglNewVector(sizeof(Texture2D*));
+
+	Context->CullFaceEnabled = 0;
+	Context->CullFaceMode = GL_BACK;
+	Context->FrontFaceMode = GL_CCW;
+	Context->LineWidth = 1.0f;
+
+#ifdef SWGL_THREADS
+	pthread_mutex_init(&Context->CommandLock, 0);
+	pthread_mutex_init(&Context->RasterLock, 0);
+	pthread_cond_init(&Context->CommandsSubmitted, 0);
+	pthread_cond_init(&Context->CommandsExecuted, 0);
+#endif
+
+	return Context;
+}
 
-			ExecuteGLSL(ActiveProgram->FragmentShader);
+void swglMakeCurrent(swglContext* context)
+{
+	CurrentContext = context;
+}
 
-			float OutR, OutG, OutB, OutA;
+swglContext* swglGetCurrentContext()
+{
+	return CurrentContext;
+}
 
-			for (int j = 0; j < ActiveProgram->FragmentShader.GlobalVars.Size; j++)
-			{
-				glslVariable* Var;
-				swglVectorRead(&ActiveProgram->FragmentShader.GlobalVars, &Var, j);
-				if (Var->isOut)
-				{
-					OutR = ((float*)Var->Value.Data)[0];
-					OutG = ((float*)Var->Value.Data)[1];
-					OutB = ((float*)Var->Value.Data)[2];
-					OutA = ((float*)Var->Value.Data)[3];
-					break;
-				}
-			}
+void swglDestroyContext(swglContext* context)
+{
+	if (!context) return;
 
-			OutR = MIN(MAX(OutR, 0.0f), 1.0f);
-			OutG = MIN(MAX(OutG, 0.0f), 1.0f);
-			OutB = MIN(MAX(OutB, 0.0f), 1.0f);
-			OutA = MIN(MAX(OutA, 0.0f), 1.0f);
+	// Stopping the render thread goes through the current context
+	swglContext* PreviousContext = CurrentContext;
+	CurrentContext = context;
+	swglSetAsync(GL_FALSE);
+	FinishRasterBatches();
+	CurrentContext = PreviousContext == context ? 0 : PreviousContext;
 
-			if (GlobalFramebuffer->DepthAttachment)
-			{
-				if (GlobalFramebuffer->DepthFormat == GL_FLOAT)
-				{
-					float OutPosZ = ((float*)glPositionVar->Value.Data)[2];
-					((float*)GlobalFramebuffer->DepthAttachment)[OutPosX + OutPosY * GlobalFramebuffer->Width] = OutPosZ;
-				}
-			}
+	FreeRasterCells(context);
 
-			if (GlobalFramebuffer->ColorAttachment)
-			{
-				if (GlobalFramebuffer->ColorFormat == GL_RGB)
-				{
-					uint32_t Color = 0xFF;
-					Color |= (int)(OutR * 255) << 24;
-					Color |= (int)(OutG * 255) << 16;
-					Color |= (int)(OutB * 255) << 8;
-					GlobalFramebuffer->ColorAttachment[OutPosX + OutPosY * GlobalFramebuffer->Width] = Color;
-				}
-				else if (GlobalFramebuffer->ColorFormat == GL_RGBA)
-				{
-					uint32_t Color = 0;
-					Color |= (int)(OutR * 255) << 24;
-					Color |= (int)(OutG * 255) << 16;
-					Color |= (int)(OutB * 255) << 8;
-					Color |= (int)(OutA * 255);
-					GlobalFramebuffer->ColorAttachment[OutPosX + OutPosY * GlobalFramebuffer->Width] = Color;
-				}
-			}
-		}
+	for (int i = 0; i < context->SwapBufferCount; i++) FreeFramebuffer(context->SwapChain[i]);
+
+	for (int i = 0; i < context->Textures.Size; i++)
+	{
+		Texture2D* Texture = ((Texture2D**)context->Textures.Data)[i];
+		for (int j = 0; j < Texture->MipMaps.Size; j++) free(((MipMap2D*)Texture->MipMaps.Data)[j].Data);
+		swglVectorFree(&Texture->MipMaps);
+		if (Texture->Data) free(Texture->Data);
+		free(Texture);
 	}
-	else if (mode == GL_TRIANGLES)
+
+	// Pooled storage and the Buffer structs go with the slabs, only larger storage is freed on its own
+	for (int i = 0; i < context->Buffers.Size; i++)
 	{
-		for (int i = first; i < first + count; i += 3)
-		{
-			glslVec4 TriangleCoords[3];
+		Buffer* MyBuffer = ((Buffer**)context->Buffers.Data)[i];
+		if (MyBuffer && !MyBuffer->external && BufferSizeClass(MyBuffer->size) < 0) FreeBufferBlock(&context->BufferPool, MyBuffer->data, MyBuffer->size);
+	}
 
-			// ORIGINALLY DEFINED AS std::vector<std::pair<glslExValue, glslVariable*>> TriangleVertexData[3];
-			_SwglVector TriangleVertexData[3];
+	for (int i = 0; i < context->BufferPool.Slabs.Size; i++) free(((void**)context->BufferPool.Slabs.Data)[i]);
 
-			for (int j = 0; j < 3; j++)
-			{
-				for (int k = 0; k < ActiveVertexArray->Attribs.Size; k++)
-				{
-					VertexArrayAttrib Attrib;
-					swglVectorRead(&ActiveVertexArray->Attribs, &Attrib, k);
-					if (Attrib.type == GL_FLOAT)
-					{
-						float* AttribData = (float*)((uint8_t*)ActiveVertexArray->VertexBuffer->data + (i + j) * Attrib.stride + Attrib.offset);
-
-						for (int k = 0; k < ActiveProgram->Layouts.Size; k++)
-						{
-							glslVariable* Var;
-							swglVectorRead(&ActiveProgram->Layouts, &Var, k);
-							VerifyVar(Var);
-							if (Var->Layout->Location == Attrib.index)
-							{
-								memcpy(Var->Value.Data, AttribData, Attrib.size * sizeof(float));
-							}
-						}
-					}
-				}
+	free(context->VertexCache);
+
+	// The vertex array's buffers are owned by Buffers
+	for (int i = 0; i < context->VertexArrays.Size; i++)
+	{
+		VertexArray* VertArray = ((VertexArray**)context->VertexArrays.Data)[i];
+		swglVectorFree(&VertArray->Attribs);
+		swglVectorFree(&VertArray->Plan.Fetches);
+		free(VertArray);
+	}
 
-				ExecuteGLSL(ActiveProgram->VertexShader);
+	for (int i = 0; i < context->Programs.Size; i++)
+	{
+		Program* MyProgram = ((Program**)context->Programs.Data)[i];
+		swglVectorFree(&MyProgram->VertexFragInOut);
+		for (int j = 0; j < MyProgram->FeedbackNames.Size; j++)
+		{
+			_SwglString* Name = ((_SwglString**)MyProgram->FeedbackNames.Data)[j];
+			free(Name->Data);
+			free(Name);
+		}
+		swglVectorFree(&MyProgram->FeedbackNames);
+		swglVectorFree(&MyProgram->FeedbackVars);
+		if (MyProgram->Linked)
+		{
+			swglVectorFree(&MyProgram->Uniforms);
+			swglVectorFree(&MyProgram->Layouts);
+			free(MyProgram->UniformBlock);
+		}
+		free(MyProgram);
+	}
 
-				TriangleCoords[j].x = ((float*)glPositionVar->Value.Data)[0];
-				TriangleCoords[j].y = ((float*)glPositionVar->Value.Data)[1];
-				TriangleCoords[j].z = ((float*)glPositionVar->Value.Data)[2];
-				TriangleCoords[j].w = ((float*)glPositionVar->Value.Data)[3];
+	// Compiled shaders stay allocated, the same as after glDeleteShader
+	for (int i = 0; i < context->Shaders.Size; i++) free(((RawShader**)context->Shaders.Data)[i]);
 
-				TriangleVertexData[j] = swglNewVector(sizeof(_ExVarPair));
+	swglVectorFree(&context->Textures);
+	swglVectorFree(&context->Buffers);
+	swglVectorFree(&context->BufferPool.Slabs);
+	swglVectorFree(&context->FreeBufferNames);
+	swglVectorFree(&context->VertexArrays);
+	swglVectorFree(&context->Programs);
+	swglVectorFree(&context->Shaders);
 
-				for (int k = 0; k < ActiveProgram->VertexFragInOut.Size; k++)
-				{
-					_VarPair InOut;
+#ifdef SWGL_THREADS
+	pthread_mutex_destroy(&context->CommandLock);
+	pthread_mutex_destroy(&context->RasterLock);
+	pthread_cond_destroy(&context->CommandsSubmitted);
+	pthread_cond_destroy(&context->CommandsExecuted);
+#endif
 
-					swglVectorRead(&ActiveProgram->VertexFragInOut, &InOut, k);
+	free(context);
+}
 
-					if (InOut.first->Type != InOut.second->Type)
-					{
-						continue;
-					}
+void glInit(GLsizei width, GLsizei height)
+{
+	swglMakeCurrent(swglCreateContext(width, height));
+}
 
-					glslExValue OutExValue = VarToExVal(InOut.second);
+uint32_t* glGetFramePtr()
+{
+	FinishRecordedCommands();
+	FinishRasterBatches();
 
-					_ExVarPair OutPair = { OutExValue, InOut.first };
+	if (CurrentContext->Framebuffer->Samples > 1) ResolveFramebuffer();
+	return CurrentContext->Framebuffer->ColorAttachment;
+}
 
-					swglVectorPushBack(&TriangleVertexData[j], &OutPair);
-				}
-			}
+void swglSetSwapBufferCount(GLsizei count)
+{
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_SET_SWAP_BUFFER_COUNT);
+		Command->Ints[0] = count;
+		return;
+	}
 
-			Triangle MyTri;
-			MyTri.Verts[0] = TriangleCoords[0];
-			MyTri.Verts[1] = TriangleCoords[1];
-			MyTri.Verts[2] = TriangleCoords[2];
-			MyTri.TriangleVertexData[0] = TriangleVertexData[0];
-			MyTri.TriangleVertexData[1] = TriangleVertexData[1];
-			MyTri.TriangleVertexData[2] = TriangleVertexData[2];
+	if (count < 1 || count > SWGL_MAX_SWAP_BUFFERS) return;
 
+	FinishRasterBatches();
 
-			Triangle Triangles[2];
-			int nTri = ClipTriangleAgainstNearPlane(&MyTri, Triangles);
-			for (int k = 0; k < nTri; k++)
-			{
-				Triangle Tri = Triangles[k];
-				for (int j = 0; j < 3; j++)
-				{
-					int OutPosX = Tri.Verts[j].x / Tri.Verts[j].w * (ViewportWidth / 2) + (ViewportWidth / 2) + ViewportX;
-					int OutPosY = Tri.Verts[j].y / Tri.Verts[j].w * (ViewportHeight / 2) + (ViewportHeight / 2) + ViewportY;
+	Framebuffer* Back = CurrentContext->Framebuffer;
 
-					TriangleCoords[j].x = OutPosX;
-					TriangleCoords[j].y = OutPosY;
-					TriangleCoords[j].z = Tri.Verts[j].z;
-					TriangleCoords[j].w = Tri.Verts[j].w;
-				}
-				DrawTriangle(TriangleCoords, Tri.TriangleVertexData);
-			}
-			free(TriangleVertexData[0].Data);
-			free(TriangleVertexData[1].Data);
-			free(TriangleVertexData[2].Data);
-			for (int k = 0; k < nTri; k++)
-			{
-				Triangle Tri = Triangles[k];
-				for (int _i = 0; _i < 3; _i++)
-				{
-					if (Tri.TriangleVertexData[_i].Data != TriangleVertexData[0].Data &&
-						Tri.TriangleVertexData[_i].Data != TriangleVertexData[1].Data &&
-						Tri.TriangleVertexData[_i].Data != TriangleVertexData[2].Data)
-						swglVectorFree(&Tri.TriangleVertexData[_i]);
-				}
-			}
-		}
+	// The back buffer is kept as the first buffer of the new chain
+	for (int i = 0; i < CurrentContext->SwapBufferCount; i++)
+	{
+		if (CurrentContext->SwapChain[i] != Back) FreeFramebuffer(CurrentContext->SwapChain[i]);
+	}
+
+	CurrentContext->SwapChain[0] = Back;
+
+	for (int i = 1; i < count; i++)
+	{
+		CurrentContext->SwapChain[i] = NewFramebuffer(Back->Width, Back->Height);
+		SetFramebufferSamples(CurrentContext->SwapChain[i], Back->Samples);
 	}
+
+	CurrentContext->SwapBufferCount = count;
+	CurrentContext->BackBuffer = 0;
 }
 
-void glInit(GLsizei width, GLsizei height)
+uint32_t* swglSwapBuffers()
 {
-	GlobalFramebuffer = (Framebuffer*)malloc(sizeof(Framebuffer));
-	GlobalFramebuffer->Width = width;
-	GlobalFramebuffer->Height = height;
-
-	GlobalFramebuffer->DepthFormat = GL_FLOAT;
-	GlobalFramebuffer->DepthAttachment = malloc(sizeof(float) * width * height);
+	FinishRecordedCommands();
+	FinishRasterBatches();
 
-	GlobalFramebuffer->ColorFormat = GL_RGBA;
-	GlobalFramebuffer->ColorAttachment = (uint32_t*)malloc(4 * width * height);
+	Framebuffer* Front = CurrentContext->Framebuffer;
 
-	GlobalArrayBuffer = 0;
-	GlobalBuffers = swglNewVector(sizeof(Buffer*));
-	GlobalPrograms = swglNewVector(sizeof(Program*));
-	GlobalVertexArrays = swglNewVector(sizeof(VertexArray*));
-	GlobalShaders = swglNewVector(sizeof(RawShader*));
-	GlobalTextures = swglNewVector(sizeof(Texture2D*));
+	if (Front->Samples > 1) ResolveFramebuffer();
 
-	ActiveProgram = 0;
-	ActiveVertexArray = 0;
-	ActiveTexture2D = 0;
-	ActiveTextureUnit = 0;
-}
+	CurrentContext->BackBuffer = (CurrentContext->BackBuffer + 1) % CurrentContext->SwapBufferCount;
+	CurrentContext->Framebuffer = CurrentContext->SwapChain[CurrentContext->BackBuffer];
 
-uint32_t* glGetFramePtr()
-{
-	return GlobalFramebuffer->ColorAttachment;
+	return Front->ColorAttachment;
 }
 
 GLint glGetUniformLocation(GLuint program, const GLchar* name)
 {
+	FinishRecordedCommands();
+
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, program - 1);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, program - 1);
 
 	for (int i = 0; i < MyProgram->Uniforms.Size; i++)
 	{
@@ -3763,168 +7785,515 @@ GLint glGetUniformLocation(GLuint program, const GLchar* name)
 
 void glUniform1f(GLint location, GLfloat v0)
 {
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNIFORM_F);
+		Command->Ints[0] = location;
+		Command->Ints[1] = 1;
+		Command->Floats[0] = v0;
+		return;
+	}
+
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, location >> 16);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, location >> 16);
 
 	glslExValue SetVal = { GLSL_FLOAT, v0 };
 
 	glslVariable* MyUniform;
 	swglVectorRead(&MyProgram->Uniforms, &MyUniform, location & 0xFFFF);
 
-	VerifyVar(MyUniform);
-
-	AssignToExVal(MyUniform, SetVal);
+	StoreExVal(ProgramUniformData(MyProgram, location & 0xFFFF), MyUniform->Type, SetVal);
 }
 
 void glUniform2f(GLint location, GLfloat v0, GLfloat v1)
 {
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNIFORM_F);
+		Command->Ints[0] = location;
+		Command->Ints[1] = 2;
+		Command->Floats[0] = v0;
+		Command->Floats[1] = v1;
+		return;
+	}
+
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, location >> 16);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, location >> 16);
 
 	glslExValue SetVal = { GLSL_VEC2, v0, v1 };
 
 	glslVariable* MyUniform;
 	swglVectorRead(&MyProgram->Uniforms, &MyUniform, location & 0xFFFF);
 
-	VerifyVar(MyUniform);
-
-	AssignToExVal(MyUniform, SetVal);
+	StoreExVal(ProgramUniformData(MyProgram, location & 0xFFFF), MyUniform->Type, SetVal);
 }
 
 void glUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
 {
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNIFORM_F);
+		Command->Ints[0] = location;
+		Command->Ints[1] = 3;
+		Command->Floats[0] = v0;
+		Command->Floats[1] = v1;
+		Command->Floats[2] = v2;
+		return;
+	}
+
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, location >> 16);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, location >> 16);
 
 	glslExValue SetVal = { GLSL_VEC3, v0, v1, v2 };
 
 	glslVariable* MyUniform;
 	swglVectorRead(&MyProgram->Uniforms, &MyUniform, location & 0xFFFF);
 
-	VerifyVar(MyUniform);
-
-	AssignToExVal(MyUniform, SetVal);
+	StoreExVal(ProgramUniformData(MyProgram, location & 0xFFFF), MyUniform->Type, SetVal);
 }
 
 void glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
 {
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNIFORM_F);
+		Command->Ints[0] = location;
+		Command->Ints[1] = 4;
+		Command->Floats[0] = v0;
+		Command->Floats[1] = v1;
+		Command->Floats[2] = v2;
+		Command->Floats[3] = v3;
+		return;
+	}
+
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, location >> 16);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, location >> 16);
 
 	glslExValue SetVal = { GLSL_VEC4, v0, v1, v2, v3 };
 
 	glslVariable* MyUniform;
 	swglVectorRead(&MyProgram->Uniforms, &MyUniform, location & 0xFFFF);
 
-	VerifyVar(MyUniform);
-
-	AssignToExVal(MyUniform, SetVal);
+	StoreExVal(ProgramUniformData(MyProgram, location & 0xFFFF), MyUniform->Type, SetVal);
 }
 
 void glUniform1i(GLint location, GLint v0)
 {
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNIFORM_1I);
+		Command->Ints[0] = location;
+		Command->Ints[1] = v0;
+		return;
+	}
+
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, location >> 16);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, location >> 16);
 
 	glslExValue SetVal = { GLSL_INT, 0.0f, 0.0f, 0.0f, 0.0f, v0 };
 
 	glslVariable* MyUniform;
 	swglVectorRead(&MyProgram->Uniforms, &MyUniform, location & 0xFFFF);
 
-	VerifyVar(MyUniform);
-
-	AssignToExVal(MyUniform, SetVal);
+	StoreExVal(ProgramUniformData(MyProgram, location & 0xFFFF), MyUniform->Type, SetVal);
 }
 
 void glUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
 {
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNIFORM_MATRIX);
+		Command->Ints[0] = location;
+		Command->Ints[1] = count;
+		Command->Ints[2] = transpose;
+		Command->Ints[3] = 2;
+		Command->Data = CopyCommandData(value, sizeof(GLfloat) * 4 * count);
+		return;
+	}
+
 	transpose = !transpose;
 
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, location >> 16);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, location >> 16);
 
 	glslVariable* MyUniform;
 	swglVectorRead(&MyProgram->Uniforms, &MyUniform, location & 0xFFFF);
 
-	VerifyVar(MyUniform);
+	if (MyUniform->Type != GLSL_MAT2) return;
+
+	float* Data = (float*)ProgramUniformData(MyProgram, location & 0xFFFF);
 
-	if (!transpose) memcpy(MyUniform->Value.Data, value, sizeof(float) * 4);
+	if (!transpose) memcpy(Data, value, sizeof(float) * 4);
 	else
 	{
-		((float*)MyUniform->Value.Data)[0] = value[0];
-		((float*)MyUniform->Value.Data)[1] = value[2];
-		((float*)MyUniform->Value.Data)[2] = value[1];
-		((float*)MyUniform->Value.Data)[3] = value[3];
+		Data[0] = value[0];
+		Data[1] = value[2];
+		Data[2] = value[1];
+		Data[3] = value[3];
 	}
 }
 
 void glUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
 {
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNIFORM_MATRIX);
+		Command->Ints[0] = location;
+		Command->Ints[1] = count;
+		Command->Ints[2] = transpose;
+		Command->Ints[3] = 3;
+		Command->Data = CopyCommandData(value, sizeof(GLfloat) * 9 * count);
+		return;
+	}
+
 	transpose = !transpose;
 
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, location >> 16);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, location >> 16);
 
 	glslVariable* MyUniform;
 	swglVectorRead(&MyProgram->Uniforms, &MyUniform, location & 0xFFFF);
 
-	VerifyVar(MyUniform);
+	if (MyUniform->Type != GLSL_MAT3) return;
 
-	if (!transpose) memcpy(MyUniform->Value.Data, value, sizeof(float) * 9);
+	float* Data = (float*)ProgramUniformData(MyProgram, location & 0xFFFF);
+
+	if (!transpose) memcpy(Data, value, sizeof(float) * 9);
 	else
 	{
-		((float*)MyUniform->Value.Data)[0] = value[0];
-		((float*)MyUniform->Value.Data)[1] = value[3];
-		((float*)MyUniform->Value.Data)[2] = value[6];
-		((float*)MyUniform->Value.Data)[3] = value[1];
-		((float*)MyUniform->Value.Data)[4] = value[4];
-		((float*)MyUniform->Value.Data)[5] = value[7];
-		((float*)MyUniform->Value.Data)[6] = value[2];
-		((float*)MyUniform->Value.Data)[7] = value[5];
-		((float*)MyUniform->Value.Data)[8] = value[8];
+		Data[0] = value[0];
+		Data[1] = value[3];
+		Data[2] = value[6];
+		Data[3] = value[1];
+		Data[4] = value[4];
+		Data[5] = value[7];
+		Data[6] = value[2];
+		Data[7] = value[5];
+		Data[8] = value[8];
 	}
 }
 
 void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
 {
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_UNIFORM_MATRIX);
+		Command->Ints[0] = location;
+		Command->Ints[1] = count;
+		Command->Ints[2] = transpose;
+		Command->Ints[3] = 4;
+		Command->Data = CopyCommandData(value, sizeof(GLfloat) * 16 * count);
+		return;
+	}
+
 	transpose = !transpose;
 
 	Program* MyProgram;
 
-	swglVectorRead(&GlobalPrograms, &MyProgram, location >> 16);
+	swglVectorRead(&CurrentContext->Programs, &MyProgram, location >> 16);
 
 	glslVariable* MyUniform;
 	swglVectorRead(&MyProgram->Uniforms, &MyUniform, location & 0xFFFF);
 
-	VerifyVar(MyUniform);
+	if (MyUniform->Type != GLSL_MAT4) return;
+
+	float* Data = (float*)ProgramUniformData(MyProgram, location & 0xFFFF);
 
-	if (!transpose) memcpy(MyUniform->Value.Data, value, sizeof(float) * 16);
+	if (!transpose) memcpy(Data, value, sizeof(float) * 16);
 	else
 	{
-		((float*)MyUniform->Value.Data)[0] = value[0];
-		((float*)MyUniform->Value.Data)[1] = value[4];
-		((float*)MyUniform->Value.Data)[2] = value[8];
-		((float*)MyUniform->Value.Data)[3] = value[12];
-		((float*)MyUniform->Value.Data)[4] = value[1];
-		((float*)MyUniform->Value.Data)[5] = value[5];
-		((float*)MyUniform->Value.Data)[6] = value[9];
-		((float*)MyUniform->Value.Data)[7] = value[13];
-		((float*)MyUniform->Value.Data)[8] = value[2];
-		((float*)MyUniform->Value.Data)[9] = value[6];
-		((float*)MyUniform->Value.Data)[10] = value[10];
-		((float*)MyUniform->Value.Data)[11] = value[14];
-		((float*)MyUniform->Value.Data)[12] = value[3];
-		((float*)MyUniform->Value.Data)[13] = value[7];
-		((float*)MyUniform->Value.Data)[14] = value[11];
-		((float*)MyUniform->Value.Data)[15] = value[15];
+		Data[0] = value[0];
+		Data[1] = value[4];
+		Data[2] = value[8];
+		Data[3] = value[12];
+		Data[4] = value[1];
+		Data[5] = value[5];
+		Data[6] = value[9];
+		Data[7] = value[13];
+		Data[8] = value[2];
+		Data[9] = value[6];
+		Data[10] = value[10];
+		Data[11] = value[14];
+		Data[12] = value[3];
+		Data[13] = value[7];
+		Data[14] = value[11];
+		Data[15] = value[15];
+	}
+}
+
+/*
+* ASYNC EXECUTION
+*/
+
+struct swglSync
+{
+	uint8_t Signaled;
+	uint8_t Deleted; // Deleted before the render thread reached it, which frees it instead
+};
+
+void SignalFence(GLsync Sync)
+{
+	FinishRasterBatches();
+
+#ifdef SWGL_THREADS
+	swglContext* Context = CurrentContext;
+
+	pthread_mutex_lock(&Context->CommandLock);
+	if (Sync->Deleted) free(Sync);
+	else Sync->Signaled = 1;
+	pthread_cond_broadcast(&Context->CommandsExecuted);
+	pthread_mutex_unlock(&Context->CommandLock);
+#endif
+}
+
+void ExecuteCommand(RecordedCommand* Command)
+{
+	GLint* Ints = Command->Ints;
+	GLsizeiptr* Sizes = Command->Sizes;
+	GLenum* Enums = Command->Enums;
+	GLfloat* Floats = Command->Floats;
+
+	if (Command->Op == SWGL_CMD_SHADER_SOURCE) glShaderSource(Ints[0], (const GLchar*)Command->Data);
+	else if (Command->Op == SWGL_CMD_COMPILE_SHADER) glCompileShader(Ints[0]);
+	else if (Command->Op == SWGL_CMD_ATTACH_SHADER) glAttachShader(Ints[0], Ints[1]);
+	else if (Command->Op == SWGL_CMD_LINK_PROGRAM) glLinkProgram(Ints[0]);
+	else if (Command->Op == SWGL_CMD_USE_PROGRAM) glUseProgram(Ints[0]);
+	else if (Command->Op == SWGL_CMD_BIND_VERTEX_ARRAY) glBindVertexArray(Ints[0]);
+	else if (Command->Op == SWGL_CMD_VERTEX_ATTRIB_POINTER) glVertexAttribPointer(Ints[0], Ints[1], Enums[0], (GLboolean)Ints[2], Ints[3], Command->Pointer);
+	else if (Command->Op == SWGL_CMD_VERTEX_ATTRIB_DIVISOR) glVertexAttribDivisor(Ints[0], Ints[1]);
+	else if (Command->Op == SWGL_CMD_BIND_BUFFER) glBindBuffer(Enums[0], Ints[0]);
+	else if (Command->Op == SWGL_CMD_BIND_BUFFER_BASE) glBindBufferBase(Enums[0], Ints[0], Ints[1]);
+	else if (Command->Op == SWGL_CMD_DELETE_BUFFERS) glDeleteBuffers(Ints[0], (const GLuint*)Command->Data);
+	else if (Command->Op == SWGL_CMD_BUFFER_DATA) glBufferData(Enums[0], Sizes[0], Command->Data, Enums[1]);
+	else if (Command->Op == SWGL_CMD_BUFFER_STORAGE_EXTERNAL) swglBufferStorageExternal(Enums[0], Sizes[0], Command->Pointer);
+	else if (Command->Op == SWGL_CMD_BUFFER_SUB_DATA) glBufferSubData(Enums[0], Sizes[0], Sizes[1], Command->Data);
+	else if (Command->Op == SWGL_CMD_UNMAP_BUFFER) glUnmapBuffer(Enums[0]);
+	else if (Command->Op == SWGL_CMD_CLEAR_COLOR) glClearColor(Floats[0], Floats[1], Floats[2], Floats[3]);
+	else if (Command->Op == SWGL_CMD_CLEAR) glClear(Ints[0]);
+	else if (Command->Op == SWGL_CMD_VIEWPORT) glViewport(Ints[0], Ints[1], Ints[2], Ints[3]);
+	else if (Command->Op == SWGL_CMD_ENABLE) glEnable(Enums[0]);
+	else if (Command->Op == SWGL_CMD_DISABLE) glDisable(Enums[0]);
+	else if (Command->Op == SWGL_CMD_CULL_FACE) glCullFace(Enums[0]);
+	else if (Command->Op == SWGL_CMD_FRONT_FACE) glFrontFace(Enums[0]);
+	else if (Command->Op == SWGL_CMD_LINE_WIDTH) glLineWidth(Floats[0]);
+	else if (Command->Op == SWGL_CMD_DRAW_ARRAYS) glDrawArraysInstanced(Enums[0], Ints[0], Ints[1], Ints[2]);
+	else if (Command->Op == SWGL_CMD_DRAW_ELEMENTS) glDrawElementsInstanced(Enums[0], Ints[0], Enums[1], Command->Pointer, Ints[1]);
+	else if (Command->Op == SWGL_CMD_MULTI_DRAW_ARRAYS) glMultiDrawArrays(Enums[0], (GLint*)Command->Data, (GLsizei*)Command->Data + Ints[0], Ints[0]);
+	else if (Command->Op == SWGL_CMD_MULTI_DRAW_ELEMENTS) glMultiDrawElements(Enums[0], (GLsizei*)((void**)Command->Data + Ints[0]), Enums[1], (const void* const*)Command->Data, Ints[0]);
+	else if (Command->Op == SWGL_CMD_MULTI_DRAW_ARRAYS_INDIRECT) glMultiDrawArraysIndirect(Enums[0], Command->Pointer, Ints[0], Ints[1]);
+	else if (Command->Op == SWGL_CMD_BEGIN_TRANSFORM_FEEDBACK) glBeginTransformFeedback(Enums[0]);
+	else if (Command->Op == SWGL_CMD_END_TRANSFORM_FEEDBACK) glEndTransformFeedback();
+	else if (Command->Op == SWGL_CMD_ACTIVE_TEXTURE) glActiveTexture(Enums[0]);
+	else if (Command->Op == SWGL_CMD_BIND_TEXTURE) glBindTexture(Enums[0], Ints[0]);
+	else if (Command->Op == SWGL_CMD_TEX_PARAMETERI) glTexParameteri(Enums[0], Enums[1], Enums[2]);
+	else if (Command->Op == SWGL_CMD_TEX_IMAGE_2D) glTexImage2D(Enums[0], Ints[0], Ints[1], Ints[2], Ints[3], Ints[4], Enums[1], Enums[2], Command->Data);
+	else if (Command->Op == SWGL_CMD_GENERATE_MIPMAP) glGenerateMipmap(Enums[0]);
+	else if (Command->Op == SWGL_CMD_UNIFORM_F)
+	{
+		if (Ints[1] == 1) glUniform1f(Ints[0], Floats[0]);
+		else if (Ints[1] == 2) glUniform2f(Ints[0], Floats[0], Floats[1]);
+		else if (Ints[1] == 3) glUniform3f(Ints[0], Floats[0], Floats[1], Floats[2]);
+		else glUniform4f(Ints[0], Floats[0], Floats[1], Floats[2], Floats[3]);
+	}
+	else if (Command->Op == SWGL_CMD_UNIFORM_1I) glUniform1i(Ints[0], Ints[1]);
+	else if (Command->Op == SWGL_CMD_UNIFORM_MATRIX)
+	{
+		if (Ints[3] == 2) glUniformMatrix2fv(Ints[0], Ints[1], (GLboolean)Ints[2], (const GLfloat*)Command->Data);
+		else if (Ints[3] == 3) glUniformMatrix3fv(Ints[0], Ints[1], (GLboolean)Ints[2], (const GLfloat*)Command->Data);
+		else glUniformMatrix4fv(Ints[0], Ints[1], (GLboolean)Ints[2], (const GLfloat*)Command->Data);
+	}
+	else if (Command->Op == SWGL_CMD_RESET_TRIANGLE_STATS) swglResetTriangleStats();
+	else if (Command->Op == SWGL_CMD_RESET_VERTEX_STATS) swglResetVertexStats();
+	else if (Command->Op == SWGL_CMD_SET_SAMPLE_COUNT) swglSetSampleCount(Ints[0]);
+	else if (Command->Op == SWGL_CMD_SET_SWAP_BUFFER_COUNT) swglSetSwapBufferCount(Ints[0]);
+	else if (Command->Op == SWGL_CMD_FENCE) SignalFence((GLsync)Command->Pointer);
+
+	if (Command->Data) free(Command->Data);
+}
+
+#ifdef SWGL_THREADS
+void* RenderThreadMain(void* Arg)
+{
+	// Executes with the context current, like the thread that recorded the calls
+	swglContext* Context = (swglContext*)Arg;
+	CurrentContext = Context;
+
+	_SwglVector Executing = swglNewVector(sizeof(RecordedCommand));
+
+	pthread_mutex_lock(&Context->CommandLock);
+
+	while (1)
+	{
+		while (!Context->SubmittedCommands.Size && !Context->StopRenderThread) pthread_cond_wait(&Context->CommandsSubmitted, &Context->CommandLock);
+		if (!Context->SubmittedCommands.Size) break;
+
+		// Swapped out so the application can keep submitting while this batch runs
+		_SwglVector Batch = Context->SubmittedCommands;
+		Context->SubmittedCommands = Executing;
+		Executing = Batch;
+
+		pthread_mutex_unlock(&Context->CommandLock);
+
+		for (int i = 0; i < Executing.Size; i++) ExecuteCommand((RecordedCommand*)Executing.Data + i);
+
+		pthread_mutex_lock(&Context->CommandLock);
+		Context->ExecutedCount += Executing.Size;
+		Executing.Size = 0;
+		pthread_cond_broadcast(&Context->CommandsExecuted);
+	}
+
+	pthread_mutex_unlock(&Context->CommandLock);
+	swglVectorFree(&Executing);
+
+	return 0;
+}
+#endif
+
+void swglSetAsync(GLboolean enabled)
+{
+#ifdef SWGL_THREADS
+	swglContext* Context = CurrentContext;
+
+	if (enabled && !Context->AsyncEnabled)
+	{
+		Context->RecordingCommands = swglNewVector(sizeof(RecordedCommand));
+		Context->SubmittedCommands = swglNewVector(sizeof(RecordedCommand));
+		Context->SubmittedCount = 0;
+		Context->ExecutedCount = 0;
+		Context->StopRenderThread = 0;
+
+		pthread_create(&Context->RenderThread, 0, RenderThreadMain, Context);
+		Context->AsyncEnabled = 1;
+	}
+	else if (!enabled && Context->AsyncEnabled)
+	{
+		glFinish();
+
+		pthread_mutex_lock(&Context->CommandLock);
+		Context->StopRenderThread = 1;
+		pthread_cond_signal(&Context->CommandsSubmitted);
+		pthread_mutex_unlock(&Context->CommandLock);
+
+		pthread_join(Context->RenderThread, 0);
+		Context->AsyncEnabled = 0;
+
+		swglVectorFree(&Context->RecordingCommands);
+		swglVectorFree(&Context->SubmittedCommands);
+	}
+#endif
+}
+
+void glFlush()
+{
+#ifdef SWGL_THREADS
+	swglContext* Context = CurrentContext;
+
+	if (!IsRecording()) return;
+	if (!Context->RecordingCommands.Size) return;
+
+	pthread_mutex_lock(&Context->CommandLock);
+	for (int i = 0; i < Context->RecordingCommands.Size; i++) swglVectorPushBack(&Context->SubmittedCommands, (RecordedCommand*)Context->RecordingCommands.Data + i);
+	Context->SubmittedCount += Context->RecordingCommands.Size;
+	pthread_cond_signal(&Context->CommandsSubmitted);
+	pthread_mutex_unlock(&Context->CommandLock);
+
+	Context->RecordingCommands.Size = 0;
+#endif
+}
+
+void glFinish()
+{
+	FinishRecordedCommands();
+
+	// The render thread is idle, the batches it left in flight can be retired from here
+	FinishRasterBatches();
+}
+
+GLsync glFenceSync(GLenum condition, GLbitfield flags)
+{
+	if (condition != GL_SYNC_GPU_COMMANDS_COMPLETE) return 0;
+	if (flags != 0) return 0; // By specification, must always be 0
+
+	GLsync Sync = (GLsync)malloc(sizeof(struct swglSync));
+	Sync->Signaled = 0;
+	Sync->Deleted = 0;
+
+	if (IsRecording())
+	{
+		RecordedCommand* Command = RecordCommand(SWGL_CMD_FENCE);
+		Command->Pointer = Sync;
+		return Sync;
+	}
+
+	// Every earlier call executed synchronously, apart from rasterization
+	FinishRasterBatches();
+	Sync->Signaled = 1;
+	return Sync;
+}
+
+GLenum glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+{
+	if (!sync) return GL_WAIT_FAILED;
+
+#ifdef SWGL_THREADS
+	swglContext* Context = CurrentContext;
+
+	pthread_mutex_lock(&Context->CommandLock);
+	uint8_t Signaled = sync->Signaled;
+	pthread_mutex_unlock(&Context->CommandLock);
+
+	if (Signaled) return GL_ALREADY_SIGNALED;
+
+	// Without the flush bit a fence still being recorded can only time out
+	if (flags & GL_SYNC_FLUSH_COMMANDS_BIT) glFlush();
+
+	struct timespec Deadline;
+	clock_gettime(CLOCK_REALTIME, &Deadline);
+	Deadline.tv_sec += timeout / 1000000000;
+	Deadline.tv_nsec += timeout % 1000000000;
+	if (Deadline.tv_nsec >= 1000000000)
+	{
+		Deadline.tv_sec++;
+		Deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&Context->CommandLock);
+	while (!sync->Signaled && timeout)
+	{
+		if (pthread_cond_timedwait(&Context->CommandsExecuted, &Context->CommandLock, &Deadline) == ETIMEDOUT) break;
 	}
+	Signaled = sync->Signaled;
+	pthread_mutex_unlock(&Context->CommandLock);
+
+	return Signaled ? GL_CONDITION_SATISFIED : GL_TIMEOUT_EXPIRED;
+#else
+	return GL_ALREADY_SIGNALED;
+#endif
+}
+
+void glDeleteSync(GLsync sync)
+{
+	if (!sync) return;
+
+#ifdef SWGL_THREADS
+	swglContext* Context = CurrentContext;
+
+	pthread_mutex_lock(&Context->CommandLock);
+	uint8_t Pending = !sync->Signaled;
+	sync->Deleted = Pending;
+	pthread_mutex_unlock(&Context->CommandLock);
+
+	if (Pending) return;
+#endif
+
+	free(sync);
 }
 
 /*
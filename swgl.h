@@ -19,6 +19,17 @@ extern "C" {
 	const uint32_t GL_COLOR_BUFFER_BIT = 0b01;
 	const uint32_t GL_DEPTH_BUFFER_BIT = 0b10;
 
+	const uint32_t GL_SYNC_FLUSH_COMMANDS_BIT = 0b01;
+
+	const uint32_t GL_MAP_READ_BIT = 0b000001;
+	const uint32_t GL_MAP_WRITE_BIT = 0b000010;
+	const uint32_t GL_MAP_INVALIDATE_RANGE_BIT = 0b000100;
+	const uint32_t GL_MAP_INVALIDATE_BUFFER_BIT = 0b001000;
+	const uint32_t GL_MAP_FLUSH_EXPLICIT_BIT = 0b010000;
+	const uint32_t GL_MAP_UNSYNCHRONIZED_BIT = 0b100000;
+
+#define GL_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
+
 #define GL_TRUE 1
 #define GL_FALSE 0
 
@@ -32,6 +43,55 @@ extern "C" {
 	typedef char GLchar;
 	typedef uint8_t GLboolean;
 	typedef float GLfloat;
+	typedef uint32_t GLbitfield;
+	typedef uint64_t GLuint64;
+	typedef intptr_t GLintptr;
+	typedef intptr_t GLsizeiptr;
+	typedef struct swglSync* GLsync;
+
+	typedef struct swglContext swglContext;
+	typedef struct swglThreadPool swglThreadPool;
+
+	// Per-path triangle counts since the last swglResetTriangleStats.
+	// Polygons produced by clipping are counted again in the rasterization paths.
+	typedef struct
+	{
+		uint64_t Submitted;
+		uint64_t Rejected; // Entirely outside one frustum plane
+		uint64_t Culled; // Face culling
+		uint64_t Degenerate; // Zero area, in clip space or after snapping to pixels
+		uint64_t NoCoverage; // Nonzero area but no sample inside
+		uint64_t Clipped; // Needed geometric clipping against near, far or the guard band
+		uint64_t Small; // Drawn through the small triangle path
+		uint64_t Scanline; // Drawn through the full scanline path
+		uint64_t Multisample; // Drawn through the per-sample edge function path
+	} swglTriangleStats;
+
+	// Work-stealing scheduler counts since the last swglResetSchedulerStats, kept per thread pool
+	typedef struct
+	{
+		uint64_t Jobs; // Tiles, vertex ranges and mipmap row bands run
+		uint64_t Steals; // Jobs a thread took from another thread's deque
+		uint64_t IdleNanoseconds; // Summed over worker threads asleep with nothing queued
+		uint64_t MaxQueueDepth; // Most jobs waiting in one deque
+	} swglSchedulerStats;
+
+	// Vertex shader runs and post-transform cache lookups since the last swglResetVertexStats
+	typedef struct
+	{
+		uint64_t Shaded;
+		uint64_t CacheHits; // Indices whose vertex was already shaded for the same batch of indices
+		uint64_t CacheMisses; // Indices whose vertex was shaded for them
+	} swglVertexStats;
+
+	// One draw of glDrawArraysIndirect and glMultiDrawArraysIndirect, read from the GL_DRAW_INDIRECT_BUFFER
+	typedef struct
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint reservedMustBeZero; // Base instances are not supported
+	} DrawArraysIndirectCommand;
 
 	/*
 	* ENUMS
@@ -44,6 +104,9 @@ extern "C" {
 		GL_COMPILE_STATUS,
 		GL_LINK_STATUS,
 		GL_ARRAY_BUFFER,
+		GL_ELEMENT_ARRAY_BUFFER,
+		GL_DRAW_INDIRECT_BUFFER,
+		GL_TRANSFORM_FEEDBACK_BUFFER,
 
 		GL_STATIC_DRAW,
 		GL_STREAM_DRAW,
@@ -52,6 +115,13 @@ extern "C" {
 		GL_FLOAT,
 		GL_INT,
 		GL_UNSIGNED_BYTE,
+		GL_UNSIGNED_SHORT,
+		GL_UNSIGNED_INT,
+		GL_BYTE,
+		GL_SHORT,
+		GL_HALF_FLOAT,
+		GL_INT_2_10_10_10_REV,
+		GL_UNSIGNED_INT_2_10_10_10_REV,
 
 		GL_DEPTH_COMPONENT,
 		GL_DEPTH_STENCIL,
@@ -61,8 +131,12 @@ extern "C" {
 		GL_RGBA,
 
 		GL_TRIANGLES,
+		GL_TRIANGLE_STRIP,
+		GL_TRIANGLE_FAN,
 		GL_POINTS,
 		GL_LINES,
+		GL_LINE_STRIP,
+		GL_LINE_LOOP,
 		GL_REPEAT,
 		GL_CLAMP,
 
@@ -78,15 +152,85 @@ extern "C" {
 		GL_TEXTURE5,
 		GL_TEXTURE6,
 		GL_TEXTURE7,
+
+		GL_CULL_FACE,
+		GL_FRONT,
+		GL_BACK,
+		GL_FRONT_AND_BACK,
+		GL_CW,
+		GL_CCW,
+
+		GL_MULTISAMPLE,
+		GL_RASTERIZER_DISCARD,
+
+		GL_INTERLEAVED_ATTRIBS,
+		GL_SEPARATE_ATTRIBS,
+
+		GL_SYNC_GPU_COMMANDS_COMPLETE,
+		GL_ALREADY_SIGNALED,
+		GL_TIMEOUT_EXPIRED,
+		GL_CONDITION_SATISFIED,
+		GL_WAIT_FAILED,
 	} GLenum;
 
 	/*
 	* NON-OPENGL HELPER FUNCTION DECLS
 	*/
 
+	// Creates a context and makes it current on the calling thread
 	void glInit(GLsizei width, GLsizei height);
 	uint32_t* glGetFramePtr();
 
+	// Every GL call acts on the calling thread's current context. Threads rendering with different contexts
+	// run fully in parallel, a context must only be current on one thread at a time
+	swglContext* swglCreateContext(GLsizei width, GLsizei height);
+	void swglMakeCurrent(swglContext* context);
+	swglContext* swglGetCurrentContext();
+	void swglDestroyContext(swglContext* context);
+
+	void swglGetTriangleStats(swglTriangleStats* stats);
+	void swglResetTriangleStats();
+
+	void swglGetVertexStats(swglVertexStats* stats);
+	void swglResetVertexStats();
+
+	// Stats of the current context's thread pool
+	void swglGetSchedulerStats(swglSchedulerStats* stats);
+	void swglResetSchedulerStats();
+
+	// Contexts render on a default pool of SWGL_THREAD_COUNT threads, counting the thread waiting on it,
+	// unless given their own pool. Pools need SWGL_THREADS, without it every pool is a single thread
+	swglThreadPool* swglCreateThreadPool(GLsizei threads);
+	void swglDestroyThreadPool(swglThreadPool* pool); // No context may still use it, the default pool is never destroyed
+	void swglSetThreadPool(swglThreadPool* pool); // 0 for the default pool
+
+	// These change the current context's pool and restart its workers, every context sharing the pool must be idle
+	void swglSetThreadCount(GLsizei threads);
+	GLsizei swglGetThreadCount();
+	// Worker i, counting from 0 and not counting the thread waiting on the pool, runs on cpus[i % count],
+	// 0 lets them run anywhere. Linux only
+	void swglSetThreadAffinity(const GLint* cpus, GLsizei count);
+	// Workers run on the CPUs of a NUMA node, -1 lets them run anywhere. Linux only
+	void swglSetThreadNumaNode(GLint node);
+	// Time a thread out of work keeps looking for jobs before it sleeps, 0 by default
+	void swglSetThreadSpin(GLuint64 nanoseconds);
+
+	// 1, 4 or 8 samples per pixel, reallocates the sample buffers so clear them afterwards.
+	// Multisampled rendering is resolved by glGetFramePtr and can be paused with glDisable(GL_MULTISAMPLE)
+	void swglSetSampleCount(GLsizei samples);
+	GLsizei swglGetSampleCount();
+
+	// Records GL calls into a command buffer executed in order on a render thread, needs SWGL_THREADS.
+	// Calls that return something wait for the render thread to finish first. Disabling waits for it as well
+	void swglSetAsync(GLboolean enabled);
+
+	// 1 to 3 color and depth buffers rendered to in turn, 1 by default. The current back buffer is kept,
+	// the others are reallocated with its size and sample count, so clear them before drawing
+	void swglSetSwapBufferCount(GLsizei count);
+	// Finishes the frame in the back buffer and returns its color, which is left untouched until the chain
+	// comes back around to it. Rendering continues in the next buffer, glGetFramePtr returns the new back buffer
+	uint32_t* swglSwapBuffers();
+
 	/*
 	* SHADER FUNCTION DECLS
 	*/
@@ -99,7 +243,12 @@ extern "C" {
 	GLuint glCreateProgram();
 	void glAttachShader(GLuint program, GLuint shader);
 	void glLinkProgram(GLuint program);
-	void glUseProgram(GLuint program);
+	void glUseProgram(GLuint program); // Ignored while transform feedback is active
+
+	// Outputs of the vertex shader, gl_Position included, that transform feedback captures once the program
+	// is linked again. Only GL_INTERLEAVED_ATTRIBS, they are written one after another for each vertex.
+	// The link captures nothing if one of them is not an output
+	void glTransformFeedbackVaryings(GLuint program, GLsizei count, const GLchar* const* varyings, GLenum bufferMode);
 
 	/*
 	* VERTEX ARRAY DECLS
@@ -107,8 +256,12 @@ extern "C" {
 
 	GLuint glGenVertexArrays(GLsizei n, GLuint* arrays); // Only supports 1 vertex array per call for now
 	void glBindVertexArray(GLuint array);
+	// GL_FLOAT, GL_HALF_FLOAT, GL_INT, GL_BYTE, GL_SHORT, their unsigned types and, with a size of 4,
+	// GL_INT_2_10_10_10_REV and GL_UNSIGNED_INT_2_10_10_10_REV. Integers are normalized to [0, 1] or [-1, 1] if asked.
+	// A stride of 0 means tightly packed elements
 	void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
 	void glEnableVertexAttribArray(GLuint index); // Doesn't do anything, here for backwards compatibility
+	void glVertexAttribDivisor(GLuint index, GLuint divisor);
 
 	/*
 	* BUFFER FUNCTION DECLS
@@ -116,8 +269,24 @@ extern "C" {
 
 	// Only supports 1 buffer per call for now
 	GLuint glGenBuffers(GLsizei n, GLuint* buffers);
+	// Unbinds the buffers from the context and every vertex array, their names are given out again
+	void glDeleteBuffers(GLsizei n, const GLuint* buffers);
 	void glBindBuffer(GLenum type, GLuint buffer);
-	void glBufferData(GLenum target, GLsizei size, const void* data, GLenum usage);
+	// Only GL_TRANSFORM_FEEDBACK_BUFFER, at index 0
+	void glBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	// Storage is pooled in power of two size classes and aligned to 64 bytes. Respecifying a buffer with a size
+	// of the same class reuses its storage, data may be 0 to leave it uninitialized
+	void glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+	void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+	// Makes the application's memory the bound buffer's storage, without copying it. Draws read it while they run,
+	// which in async mode is after they were recorded, so wait on a fence made after the last draw using it before
+	// changing or freeing it. It stays the buffer's storage until glBufferData, or a map invalidating the whole
+	// buffer, gives the buffer its own again
+	void swglBufferStorageExternal(GLenum target, GLsizeiptr size, void* data);
+	// Maps the buffer's own storage in place, never waiting for rendering. In async mode it waits for recorded calls,
+	// unsynchronized maps too, except write only maps that invalidate, which get fresh storage copied in when unmapped
+	void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	GLboolean glUnmapBuffer(GLenum target);
 
 	/*
 	* DRAW FUNCTION DECLS
@@ -127,7 +296,47 @@ extern "C" {
 	void glClear(GLuint flags);
 	void glViewport(GLint x, GLint y, GLsizei width, GLsizei height);
 
+	void glEnable(GLenum cap);
+	void glDisable(GLenum cap);
+	void glCullFace(GLenum mode);
+	void glFrontFace(GLenum mode);
+	// Lines wider than 1 pixel repeat each pixel across their minor axis, rounded to a whole pixel count
+	void glLineWidth(GLfloat width);
+
 	void glDrawArrays(GLenum mode, GLint first, GLsizei count);
+	// indices is an offset into the vertex array's GL_ELEMENT_ARRAY_BUFFER, of GL_UNSIGNED_BYTE, SHORT or INT
+	void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+	void glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices);
+	// Vertex shaders read the instance through gl_InstanceID
+	void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+	void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount);
+	// The draws share their setup and batches, like the instances of one draw
+	void glMultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawcount);
+	void glMultiDrawElements(GLenum mode, const GLsizei* count, GLenum type, const void* const* indices, GLsizei drawcount);
+	// indirect is an offset into the GL_DRAW_INDIRECT_BUFFER, read when the draw executes.
+	// A stride of 0 means tightly packed DrawArraysIndirectCommands
+	void glDrawArraysIndirect(GLenum mode, const void* indirect);
+	void glMultiDrawArraysIndirect(GLenum mode, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+	// Draws write the captured outputs of every vertex of their primitives to the GL_TRANSFORM_FEEDBACK_BUFFER,
+	// from its start, before clipping and culling. primitiveMode is GL_POINTS, GL_LINES or GL_TRIANGLES and draws
+	// must use a mode of the same kind, strips, fans and loops are written as separate primitives. Primitives that
+	// no longer fit in the buffer are not written. With GL_RASTERIZER_DISCARD enabled draws only shade and capture
+	void glBeginTransformFeedback(GLenum primitiveMode);
+	void glEndTransformFeedback();
+	// Vertices written since the last glBeginTransformFeedback
+	GLsizei swglGetTransformFeedbackVertices();
+
+	/*
+	* SYNC FUNCTION DECLS
+	*/
+
+	void glFlush();
+	void glFinish();
+
+	GLsync glFenceSync(GLenum condition, GLbitfield flags);
+	GLenum glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+	void glDeleteSync(GLsync sync);
 
 	/*
 	* TEXTURE FUNCTION DECLS